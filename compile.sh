@@ -28,3 +28,23 @@ build/src/test/async-queue-test
 build/src/test/quat-test
 build/src/test/slerp-test
 build/src/test/graph-test
+build/src/test/correlator-kernel-test
+build/src/test/thread-pool-test
+build/src/test/pyramid-cache-test
+build/src/test/pairwise-batch-test
+build/src/test/flow-blender-test
+build/src/test/buffer-pool-test
+build/src/test/ring-geometry-cache-test
+build/src/test/stereo-stitcher-test
+build/src/test/ring-blender-test
+build/src/test/ring-adjustment-test
+build/src/test/dynamic-seamer-test
+build/src/test/mapped-image-test
+build/src/test/write-behind-queue-test
+build/src/test/checkpoint-store-test
+build/src/test/image-test
+build/src/test/tile-pyramid-writer-test
+build/src/test/caching-checkpoint-store-test
+build/src/test/phase-correlation-aligner-test
+build/src/test/multiring-stitcher-test
+build/src/test/ring-stitcher-test
@@ -0,0 +1,523 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <opencv2/core/ocl.hpp>
+#include <opencv2/stitching/detail/blenders.hpp>
+
+#include "common/intrinsics.hpp"
+#include "common/assert.hpp"
+#include "common/image.hpp"
+#include "imgproc/planarCorrelator.hpp"
+#include "recorder/recorderGraphGenerator.hpp"
+#include "recorder/imageSelector.hpp"
+#include "stereo/monoStitcher.hpp"
+#include "stitcher/flowBlender.hpp"
+#include "stitcher/flowEngine.hpp"
+#include "stitcher/dynamicSeamer.hpp"
+#include "stitcher/ringStitcher.hpp"
+#include "stitcher/ringGeometryCache.hpp"
+#include "stitcher/ringBlender.hpp"
+#include "math/projection.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Microbenchmark suite for the performance critical kernels.
+ * Works on synthetic images of the production sizes.
+ *
+ * Usage: benchmark [--reps n] [--warmup n] [--filter substring] [--json file]
+ */
+
+/*
+ * Statistics of a single benchmark, in milliseconds.
+ */
+struct BenchmarkResult {
+    string name;
+    string size;
+    size_t repetitions;
+    double median;
+    double p95;
+    double min;
+    double mean;
+    // Additional, benchmark specific values, e.g. quality metrics.
+    map<string, double> metrics;
+};
+
+/*
+ * Benchmark settings, parsed from the command line.
+ */
+struct BenchmarkOptions {
+    int warmup;
+    int repetitions;
+    string filter;
+    string jsonPath;
+
+    BenchmarkOptions() : warmup(2), repetitions(10) { }
+};
+
+class BenchmarkRunner {
+    private:
+    const BenchmarkOptions &options;
+    vector<BenchmarkResult> results;
+
+    static string SizeToString(const cv::Size &size) {
+        return ToString(size.width) + "x" + ToString(size.height);
+    }
+
+    public:
+    BenchmarkRunner(const BenchmarkOptions &options) : options(options) { }
+
+    /*
+     * Runs a benchmark, if it matches the filter.
+     *
+     * @param name The name of the benchmark.
+     * @param size The image size the benchmark works on.
+     * @param body The measured function.
+     * @param setup Function that is called before each call of body. Not measured.
+     *
+     * @returns True if the benchmark was run.
+     */
+    bool Run(const string &name, const cv::Size &size, function<void()> body,
+            function<void()> setup = [] () { }) {
+
+        const string fullName = name + " @ " + SizeToString(size);
+
+        if(!options.filter.empty() && fullName.find(options.filter) == string::npos) {
+            return false;
+        }
+
+        for(int i = 0; i < options.warmup; i++) {
+            setup();
+            body();
+        }
+
+        vector<double> times;
+
+        for(int i = 0; i < options.repetitions; i++) {
+            setup();
+            auto start = chrono::steady_clock::now();
+            body();
+            auto end = chrono::steady_clock::now();
+            times.push_back(chrono::duration<double, milli>(end - start).count());
+        }
+
+        sort(times.begin(), times.end());
+
+        BenchmarkResult res;
+        res.name = name;
+        res.size = SizeToString(size);
+        res.repetitions = times.size();
+        res.median = times.size() % 2 == 1 ? times[times.size() / 2] :
+            (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+        res.p95 = times[max(0, (int)ceil(0.95 * times.size()) - 1)];
+        res.min = times.front();
+        res.mean = 0;
+        for(double t : times) {
+            res.mean += t;
+        }
+        res.mean /= times.size();
+
+        cerr << "[bench] " << fullName << ": median " << res.median <<
+            " ms, p95 " << res.p95 << " ms" << endl;
+
+        results.push_back(res);
+
+        return true;
+    }
+
+    /*
+     * Attaches an additional value to the last benchmark result.
+     */
+    void AddMetric(const string &key, double value) {
+        AssertGT(results.size(), (size_t)0);
+        results.back().metrics[key] = value;
+    }
+
+    /*
+     * Writes all results as JSON.
+     */
+    void WriteJson(ostream &out) const {
+        out << "{" << endl << "  \"benchmarks\": [" << endl;
+        for(size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult &r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", " <<
+                "\"size\": \"" << r.size << "\", " <<
+                "\"repetitions\": " << r.repetitions << ", " <<
+                "\"median_ms\": " << r.median << ", " <<
+                "\"p95_ms\": " << r.p95 << ", " <<
+                "\"min_ms\": " << r.min << ", " <<
+                "\"mean_ms\": " << r.mean;
+
+            if(!r.metrics.empty()) {
+                out << ", \"metrics\": {";
+                for(auto it = r.metrics.begin(); it != r.metrics.end(); ++it) {
+                    out << (it == r.metrics.begin() ? "" : ", ") <<
+                        "\"" << it->first << "\": " << it->second;
+                }
+                out << "}";
+            }
+
+            out << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "  ]" << endl << "}" << endl;
+    }
+
+    /*
+     * Writes all results as human readable table.
+     */
+    void WriteTable(ostream &out) const {
+        for(auto &r : results) {
+            out << r.name << " @ " << r.size <<
+                "\tmedian: " << r.median << " ms" <<
+                "\tp95: " << r.p95 << " ms" <<
+                "\tmin: " << r.min << " ms";
+            for(auto &m : r.metrics) {
+                out << "\t" << m.first << ": " << m.second;
+            }
+            out << endl;
+        }
+    }
+};
+
+/*
+ * Creates a smooth random texture, so that correlation and flow
+ * have a unique solution.
+ */
+Mat CreateTexture(const cv::Size &size, int seed) {
+    Mat noise(size, CV_8UC3), texture;
+    RNG rng(seed);
+    rng.fill(noise, RNG::UNIFORM, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(noise, texture, cv::Size(7, 7), 2);
+    return texture;
+}
+
+/*
+ * Benchmarks the brute force and pyramid aligners for the given metric.
+ */
+template <typename ErrorMetric>
+void BenchmarkAligner(BenchmarkRunner &runner, const string &metric, const Mat &a, const Mat &b) {
+    typedef NormedCorrelator<ErrorMetric> Correlator;
+
+    runner.Run("BruteForcePlanarAligner<" + metric + ">", a.size(), [&a, &b] () {
+                Mat corr;
+                BruteForcePlanarAligner<Correlator>::Align(a, b, corr, 8, 8, 0, 0);
+            });
+
+    runner.Run("PyramidPlanarAligner<" + metric + ">", a.size(), [&a, &b] () {
+                Mat corr;
+                PyramidPlanarAligner<Correlator>::Align(a, b, corr, 0.25, 0.25);
+            });
+}
+
+/*
+ * Benchmarks all aligners with all error metrics. Gain and SumA are
+ * only used for gain estimation, so they are not benchmarked.
+ */
+void BenchmarkAligners(BenchmarkRunner &runner, const Mat &scene, const cv::Size &size) {
+    Mat a = scene(cv::Rect(0, 0, size.width, size.height));
+    Mat b = scene(cv::Rect(size.width / 20, size.height / 30, size.width, size.height));
+
+    BenchmarkAligner<AbsoluteDifference<Vec3b>>(runner, "AbsoluteDifference<Vec3b>", a, b);
+    BenchmarkAligner<LeastSquares<Vec3b>>(runner, "LeastSquares<Vec3b>", a, b);
+    BenchmarkAligner<GemanMcClure<Vec3b, 20>>(runner, "GemanMcClure<Vec3b>", a, b);
+    BenchmarkAligner<CrossCorrelation<Vec3b, 128>>(runner, "CrossCorrelation<Vec3b>", a, b);
+    BenchmarkAligner<AbsoluteDifferenceInt<Vec3b>>(runner, "AbsoluteDifferenceInt<Vec3b>", a, b);
+    BenchmarkAligner<LeastSquaresInt<Vec3b>>(runner, "LeastSquaresInt<Vec3b>", a, b);
+
+    Mat grayA = ToLuma(a), grayB = ToLuma(b);
+
+    BenchmarkAligner<AbsoluteDifference<uchar>>(runner, "AbsoluteDifference<uchar>", grayA, grayB);
+    BenchmarkAligner<LeastSquares<uchar>>(runner, "LeastSquares<uchar>", grayA, grayB);
+    BenchmarkAligner<AbsoluteDifferenceInt<uchar>>(runner, "AbsoluteDifferenceInt<uchar>", grayA, grayB);
+    BenchmarkAligner<LeastSquaresInt<uchar>>(runner, "LeastSquaresInt<uchar>", grayA, grayB);
+}
+
+/*
+ * Benchmarks flow calculation, flow blending and seam finding on two
+ * horizontally overlapping images.
+ */
+void BenchmarkBlending(BenchmarkRunner &runner, const Mat &scene, const cv::Size &size) {
+    const int shift = size.width / 3;
+
+    Mat a = scene(cv::Rect(0, 0, size.width, size.height));
+    Mat b = scene(cv::Rect(shift, 2, size.width, size.height));
+    cv::Point tlA(0, 0);
+    cv::Point tlB(shift, 0);
+    cv::Rect roi(0, 0, size.width * 8, size.height);
+
+    FlowBlender blender;
+    blender.Prepare(roi);
+
+    Mat flow;
+    runner.Run("FlowBlender::CalculateFlow", size, [&] () {
+                blender.CalculateFlow(a, b, tlA, tlB, flow);
+            });
+
+    if(flow.empty()) {
+        blender.CalculateFlow(a, b, tlA, tlB, flow);
+    }
+
+    runner.Run("FlowBlender::Feed", size, [&] () {
+                blender.Feed(b, flow, tlB);
+            }, [&] () {
+                blender.Prepare(roi);
+                blender.Feed(a, Mat(a.size(), CV_32FC2, Scalar::all(0)), tlA);
+            });
+
+    Mat imageA = a.clone(), imageB = b.clone();
+    Mat maskA(size, CV_8U), maskB(size, CV_8U);
+
+    runner.Run("DynamicSeamer::Find", size, [&] () {
+                DynamicSeamer::Find<false>(imageA, imageB, maskA, maskB, tlA, tlB, 0, 1, 0);
+            }, [&] () {
+                maskA.setTo(Scalar::all(255));
+                maskB.setTo(Scalar::all(255));
+            });
+
+    runner.Run("DynamicSeamer::Find<downsample=4>", size, [&] () {
+                DynamicSeamer::Find<false>(imageA, imageB, maskA, maskB, tlA, tlB, 0, 1, 0, 4);
+            }, [&] () {
+                maskA.setTo(Scalar::all(255));
+                maskB.setTo(Scalar::all(255));
+            });
+}
+
+/*
+ * Benchmarks the flow engine of the given type and records
+ * the residual photometric error of the resulting flow.
+ */
+void BenchmarkFlowEngine(BenchmarkRunner &runner, const string &name, FlowEngineType type,
+        const Mat &a, const Mat &b) {
+    FlowEngineP engine = CreateFlowEngine(type);
+    Mat flow;
+
+    bool ran = runner.Run("FlowEngine<" + name + ">", a.size(), [&] () {
+                engine->Calculate(a, b, flow);
+            });
+
+    if(ran) {
+        runner.AddMetric("residual", CalculateFlowResidual(a, b, flow));
+    }
+}
+
+/*
+ * Benchmarks all flow engines on the overlap of two shifted images.
+ */
+void BenchmarkFlowEngines(BenchmarkRunner &runner, const Mat &scene, const cv::Size &size) {
+    Mat a = ToLuma(scene(cv::Rect(0, 0, size.width, size.height)));
+    Mat b = ToLuma(scene(cv::Rect(3, 2, size.width, size.height)));
+
+    BenchmarkFlowEngine(runner, "Farneback", FlowEngineType::Farneback, a, b);
+    BenchmarkFlowEngine(runner, "HalfResolutionFarneback", FlowEngineType::HalfResolutionFarneback, a, b);
+    BenchmarkFlowEngine(runner, "QuarterResolutionFarneback", FlowEngineType::QuarterResolutionFarneback, a, b);
+#ifdef OPTONAUT_HAS_DIS_FLOW
+    BenchmarkFlowEngine(runner, "DIS", FlowEngineType::DIS, a, b);
+#endif
+}
+
+/*
+ * Creates synthetic images for all selection points of the given ring.
+ */
+vector<SelectionInfo> CreateRing(const RecorderGraph &graph, size_t ring, const cv::Size &size) {
+    vector<SelectionInfo> infos;
+    int id = 0;
+
+    for(auto &point : graph.GetRings()[ring]) {
+        SelectionInfo info;
+        info.closestPoint = point;
+        info.isValid = true;
+        info.image = make_shared<InputImage>();
+        info.image->id = id;
+        info.image->image = Image(CreateTexture(size, id));
+        info.image->intrinsics = iPhone6Intrinsics.clone();
+        info.image->originalExtrinsics = point.extrinsics.clone();
+        info.image->adjustedExtrinsics = point.extrinsics.clone();
+        infos.push_back(info);
+        id++;
+    }
+
+    return infos;
+}
+
+/*
+ * Benchmarks ring warping, ring stitching and stereo rectification on a
+ * synthetic recording. Stitching includes warping, seaming and blending.
+ */
+void BenchmarkStitching(BenchmarkRunner &runner, const cv::Size &size) {
+    RecorderGraph graph = RecorderGraphGenerator::Generate(iPhone6Intrinsics,
+            RecorderGraph::ModeCenter, RecorderGraph::DensityNormal);
+
+    auto ring = CreateRing(graph, 0, size);
+    auto images = fun::map<SelectionInfo, InputImageP>(ring,
+            [] (const SelectionInfo &x) { return x.image; });
+    auto rotations = fun::map<InputImageP, Mat>(images,
+            [] (const InputImageP &x) { return x->adjustedExtrinsics; });
+
+    // Same warp as in AsyncRingStitcher. The geometry is cached, like for
+    // the second stitcher of a ring.
+    auto geometry = RingGeometryCache::Default().Get(images[0]->intrinsics,
+            images[0]->image.size(), 1200, rotations);
+
+    runner.Run("AsyncRingStitcher warp", size, [&] () {
+                Mat warped(geometry->coreRoi.size(), CV_8UC3);
+                for(auto &image : images) {
+                    remap(image->image.data, warped, geometry->xymap, geometry->interpolationMap,
+                            INTER_LINEAR, BORDER_CONSTANT);
+                }
+            });
+
+    runner.Run("AsyncRingStitcher stitch (linear blend)", size, [&] () {
+                AsyncRingStitcher stitcher(rotations, 1200, false);
+                for(auto &image : images) {
+                    stitcher.Push(image);
+                }
+                stitcher.Finalize();
+            });
+
+    runner.Run("AsyncRingStitcher stitch (flow blend, serial)", size, [&] () {
+                AsyncRingStitcher stitcher(rotations, 1200, true, nullptr, false);
+                for(auto &image : images) {
+                    stitcher.Push(image);
+                }
+                stitcher.Finalize();
+            });
+
+    runner.Run("AsyncRingStitcher stitch (flow blend, pipelined)", size, [&] () {
+                AsyncRingStitcher stitcher(rotations, 1200, true, nullptr, true);
+                for(auto &image : images) {
+                    stitcher.Push(image);
+                }
+                stitcher.Finalize();
+            });
+
+    MonoStitcher mono;
+
+    runner.Run("MonoStitcher::CreateStereo", size, [&] () {
+                StereoImage stereo;
+                mono.CreateStereo(ring[0], ring[1], stereo);
+            });
+}
+
+/*
+ * Benchmarks compositing three overlapping rings into a panorama
+ * of the given size, with OpenCV's feather blender and our ring blender.
+ */
+void BenchmarkRingBlending(BenchmarkRunner &runner, const cv::Size &size) {
+    const int ringHeight = size.height * 3 / 7;
+    const int step = (size.height - ringHeight) / 2;
+    const cv::Rect roi(cv::Point(0, 0), size);
+
+    vector<Mat> images, masks;
+    vector<cv::Point> corners;
+
+    for(int i = 0; i < 3; i++) {
+        images.push_back(CreateTexture(cv::Size(size.width, ringHeight), i));
+        masks.push_back(Mat(images.back().size(), CV_8U, Scalar::all(255)));
+        corners.push_back(cv::Point(0, i * step));
+    }
+
+    runner.Run("cv::detail::FeatherBlender (rings)", size, [&] () {
+                Ptr<detail::Blender> blender = 
+                    detail::Blender::createDefault(detail::Blender::FEATHER, false);
+                blender->prepare(roi);
+                for(size_t i = 0; i < images.size(); i++) {
+                    Mat asShort;
+                    images[i].convertTo(asShort, CV_16S);
+                    blender->feed(asShort, masks[i], corners[i]);
+                }
+                Mat result, resultMask;
+                blender->blend(result, resultMask);
+                result.convertTo(result, CV_8U);
+            });
+
+    for(auto mode : { RingBlendMode::Feather, RingBlendMode::MultiBand }) {
+        const string name = mode == RingBlendMode::Feather ? "feather" : "multi-band";
+        RingBlender blender(mode);
+
+        bool ran = runner.Run("RingBlender (" + name + ")", size, [&] () {
+                    blender.Prepare(roi);
+                    for(size_t i = 0; i < images.size(); i++) {
+                        blender.Feed(images[i], masks[i], corners[i]);
+                    }
+                    Mat result, resultMask;
+                    blender.Blend(result, resultMask);
+                });
+
+        if(ran) {
+            runner.AddMetric("estimated_mb", blender.EstimateMemory(size) / (1024.0 * 1024.0));
+        }
+    }
+}
+
+/*
+ * Benchmarks cube face extraction from an equirectangular panorama.
+ */
+void BenchmarkCubeMap(BenchmarkRunner &runner, const cv::Size &size) {
+    Mat optograph = CreateTexture(size, 42);
+
+    runner.Run("CreateCubeMapFace", size, [&] () {
+                Mat face;
+                CreateCubeMapFace(optograph, face, 0, size.height / 2, size.height / 2);
+            });
+}
+
+int main(int argc, char** argv) {
+    cv::ocl::setUseOpenCL(false);
+
+    BenchmarkOptions options;
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if(i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return 1;
+        }
+
+        if(arg == "--reps") {
+            options.repetitions = max(1, atoi(argv[++i]));
+        } else if(arg == "--warmup") {
+            options.warmup = max(0, atoi(argv[++i]));
+        } else if(arg == "--filter") {
+            options.filter = argv[++i];
+        } else if(arg == "--json") {
+            options.jsonPath = argv[++i];
+        } else {
+            cerr << "Unknown argument: " << arg << endl;
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner(options);
+
+    const cv::Size workingSize(WorkingWidth, WorkingHeight);
+    Mat scene = CreateTexture(cv::Size(WorkingWidth * 2, WorkingHeight * 2), 0);
+
+    // Production size and the first two pyramid levels.
+    for(int level = 0; level < 3; level++) {
+        cv::Size size(workingSize.width >> level, workingSize.height >> level);
+        BenchmarkAligners(runner, scene, size);
+        BenchmarkBlending(runner, scene, size);
+        BenchmarkFlowEngines(runner, scene, size);
+    }
+
+    BenchmarkStitching(runner, cv::Size(workingSize.width / 2, workingSize.height / 2));
+    BenchmarkRingBlending(runner, cv::Size(4096, 2048));
+    BenchmarkCubeMap(runner, cv::Size(4096, 2048));
+
+    runner.WriteTable(cout);
+
+    if(!options.jsonPath.empty()) {
+        ofstream json(options.jsonPath);
+        runner.WriteJson(json);
+    }
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+#include <map>
+#include <vector>
+#include <mutex>
+#include <opencv2/core.hpp>
+
+#include "assert.hpp"
+
+#ifndef OPTONAUT_BUFFER_POOL_HEADER
+#define OPTONAUT_BUFFER_POOL_HEADER
+
+namespace optonaut {
+
+    /*
+     * Pool of scratch buffers for matrices, bucketed by byte size.
+     * Matrices created by the pool return their memory to the pool
+     * as soon as the last reference is released, so it can be re-used by the
+     * next matrix of a similar size.
+     *
+     * Matrices may outlive the pool, their memory is freed on release then.
+     *
+     * Thread safe.
+     */
+    class BufferPool {
+    private:
+
+        /*
+         * OpenCV allocator backed by the free lists of the pool. Deletes
+         * itself when the pool is gone and the last buffer was released.
+         */
+        class Allocator : public cv::MatAllocator {
+        private:
+            mutable std::map<size_t, std::vector<uchar*>> free;
+            mutable std::mutex m;
+            mutable size_t freeBytes;
+            mutable size_t outstanding;
+            mutable size_t allocations;
+            mutable size_t reuses;
+            const size_t budget;
+            bool detached;
+
+            /*
+             * Rounds the given size up to its bucket. Buckets are spaced
+             * by a quarter of the next lower power of two.
+             */
+            static size_t BucketSize(size_t bytes) {
+                const size_t minBucket = 4096;
+
+                if(bytes <= minBucket) {
+                    return minBucket;
+                }
+
+                size_t p = minBucket;
+                while(p * 2 <= bytes) {
+                    p *= 2;
+                }
+
+                const size_t step = p / 4;
+                return (bytes + step - 1) / step * step;
+            }
+
+            void FreeAll() {
+                for(auto &bucket : free) {
+                    for(uchar *data : bucket.second) {
+                        cv::fastFree(data);
+                    }
+                }
+                free.clear();
+                freeBytes = 0;
+            }
+
+        public:
+            Allocator(size_t budget) :
+                freeBytes(0), outstanding(0), allocations(0), reuses(0),
+                budget(budget), detached(false) { }
+
+            cv::UMatData* allocate(int dims, const int* sizes, int type,
+                    void* data0, size_t* step, int, cv::UMatUsageFlags) const {
+                size_t total = CV_ELEM_SIZE(type);
+                for(int i = dims - 1; i >= 0; i--) {
+                    if(step) {
+                        if(data0 && step[i] != CV_AUTOSTEP) {
+                            AssertGE(step[i], total);
+                            total = step[i];
+                        } else {
+                            step[i] = total;
+                        }
+                    }
+                    total *= sizes[i];
+                }
+
+                cv::UMatData* u = new cv::UMatData(this);
+                u->size = total;
+
+                if(data0) {
+                    // Memory is owned by the caller.
+                    u->data = u->origdata = (uchar*)data0;
+                    u->flags |= cv::UMatData::USER_ALLOCATED;
+                    return u;
+                }
+
+                const size_t bucket = BucketSize(total);
+                uchar* data = NULL;
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    auto it = free.find(bucket);
+
+                    if(it != free.end() && !it->second.empty()) {
+                        data = it->second.back();
+                        it->second.pop_back();
+                        freeBytes -= bucket;
+                        reuses++;
+                    } else {
+                        allocations++;
+                    }
+                    outstanding++;
+                }
+
+                if(data == NULL) {
+                    data = (uchar*)cv::fastMalloc(bucket);
+                }
+
+                u->data = u->origdata = data;
+                return u;
+            }
+
+            bool allocate(cv::UMatData* u, int, cv::UMatUsageFlags) const {
+                return u != NULL;
+            }
+
+            void deallocate(cv::UMatData* u) const {
+                if(u == NULL) {
+                    return;
+                }
+
+                AssertEQ(u->refcount, 0);
+
+                if(u->flags & cv::UMatData::USER_ALLOCATED) {
+                    delete u;
+                    return;
+                }
+
+                const size_t bucket = BucketSize(u->size);
+                uchar* data = u->origdata;
+                delete u;
+
+                bool release;
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    outstanding--;
+
+                    if(!detached && freeBytes + bucket <= budget) {
+                        free[bucket].push_back(data);
+                        freeBytes += bucket;
+                        data = NULL;
+                    }
+
+                    release = detached && outstanding == 0;
+                }
+
+                if(data != NULL) {
+                    cv::fastFree(data);
+                }
+
+                if(release) {
+                    delete this;
+                }
+            }
+
+            /*
+             * Called by the owning pool on destruction.
+             */
+            void Detach() {
+                bool release;
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    FreeAll();
+                    detached = true;
+                    release = outstanding == 0;
+                }
+
+                if(release) {
+                    delete this;
+                }
+            }
+
+            void Clear() {
+                std::unique_lock<std::mutex> lock(m);
+                FreeAll();
+            }
+
+            size_t GetAllocationCount() const {
+                std::unique_lock<std::mutex> lock(m);
+                return allocations;
+            }
+
+            size_t GetReuseCount() const {
+                std::unique_lock<std::mutex> lock(m);
+                return reuses;
+            }
+
+            size_t GetFreeBytes() const {
+                std::unique_lock<std::mutex> lock(m);
+                return freeBytes;
+            }
+        };
+
+        Allocator* allocator;
+
+    public:
+        /*
+         * Creates a new pool.
+         *
+         * @param budget Maximum memory kept in unused buffers, in bytes.
+         */
+        BufferPool(size_t budget = 256 * 1024 * 1024) :
+            allocator(new Allocator(budget)) { }
+
+        ~BufferPool() {
+            allocator->Detach();
+        }
+
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        /*
+         * Creates an uninitialized matrix backed by the pool.
+         * Matrices re-allocated by OpenCV functions stay in the pool.
+         */
+        cv::Mat Create(const cv::Size &size, int type) {
+            cv::Mat mat;
+            mat.allocator = allocator;
+            mat.create(size, type);
+            return mat;
+        }
+
+        /*
+         * Frees all unused buffers.
+         */
+        void Clear() {
+            allocator->Clear();
+        }
+
+        /*
+         * Returns the count of buffers that had to be allocated from the heap.
+         */
+        size_t GetAllocationCount() const {
+            return allocator->GetAllocationCount();
+        }
+
+        /*
+         * Returns the count of buffers that were served from the pool.
+         */
+        size_t GetReuseCount() const {
+            return allocator->GetReuseCount();
+        }
+
+        /*
+         * Returns the memory kept in unused buffers, in bytes.
+         */
+        size_t GetFreeBytes() const {
+            return allocator->GetFreeBytes();
+        }
+    };
+}
+
+#endif
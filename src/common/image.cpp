@@ -1,4 +1,158 @@
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "image.hpp"
+
+using namespace std;
 
 namespace optonaut {
 
+    /*
+     * Lock of the hook registries. Function-local statics, so 
+     * hooks can be registered during static initialization. 
+     */
+    static mutex &GetHookLock() {
+        static mutex m;
+        return m;
+    }
+
+    static size_t NextHookHandle() {
+        static size_t nextHandle = 0;
+        return nextHandle++;
+    }
+
+    /*
+     * Registry of hooks. Hooks are called without holding the lock, so hooks 
+     * may (un-)register hooks themselves. Removing a hook waits until all calls on 
+     * other threads returned, so the owner of the hook can be destroyed afterwards. 
+     */
+    template <typename Hook>
+    class HookRegistry {
+        private:
+        struct Registration {
+            Hook hook;
+            // Threads that currently call the hook. 
+            vector<thread::id> callers;
+        };
+
+        map<size_t, shared_ptr<Registration>> hooks;
+        condition_variable returned;
+
+        public:
+        size_t Add(Hook hook) {
+            unique_lock<mutex> lock(GetHookLock());
+            size_t handle = NextHookHandle();
+            hooks[handle] = make_shared<Registration>(Registration { hook, { } });
+
+            return handle;
+        }
+
+        void Remove(size_t handle) {
+            unique_lock<mutex> lock(GetHookLock());
+
+            auto it = hooks.find(handle);
+            if(it == hooks.end()) {
+                return;
+            }
+
+            shared_ptr<Registration> registration = it->second;
+            hooks.erase(it);
+
+            // A hook that removes itself does not wait for its own call. 
+            const thread::id self = this_thread::get_id();
+            returned.wait(lock, [&] {
+                for(auto &caller : registration->callers) {
+                    if(caller != self) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+
+        /*
+         * Calls all registered hooks until call returns true. 
+         */
+        template <typename Call>
+        bool CallUntil(Call call) {
+            vector<pair<size_t, shared_ptr<Registration>>> current;
+            {
+                unique_lock<mutex> lock(GetHookLock());
+                current.assign(hooks.begin(), hooks.end());
+            }
+
+            const thread::id self = this_thread::get_id();
+
+            for(auto &entry : current) {
+                Registration &registration = *entry.second;
+                {
+                    // Hooks removed by previous hooks are skipped. 
+                    unique_lock<mutex> lock(GetHookLock());
+                    if(hooks.find(entry.first) == hooks.end()) {
+                        continue;
+                    }
+                    registration.callers.push_back(self);
+                }
+
+                bool done = call(registration.hook);
+
+                {
+                    unique_lock<mutex> lock(GetHookLock());
+                    auto &callers = registration.callers;
+                    callers.erase(find(callers.begin(), callers.end(), self));
+                }
+                returned.notify_all();
+
+                if(done) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    static HookRegistry<Image::UnloadHook> &GetUnloadHooks() {
+        static HookRegistry<Image::UnloadHook> hooks;
+        return hooks;
+    }
+
+    static HookRegistry<Image::LoadHook> &GetLoadHooks() {
+        static HookRegistry<Image::LoadHook> hooks;
+        return hooks;
+    }
+
+    size_t Image::AddUnloadHook(UnloadHook hook) {
+        return GetUnloadHooks().Add(hook);
+    }
+
+    void Image::RemoveUnloadHook(size_t handle) {
+        GetUnloadHooks().Remove(handle);
+    }
+
+    void Image::NotifyUnload(const Image &image) {
+        GetUnloadHooks().CallUntil([&image] (const UnloadHook &hook) {
+            hook(image);
+            return false;
+        });
+    }
+
+    size_t Image::AddLoadHook(LoadHook hook) {
+        return GetLoadHooks().Add(hook);
+    }
+
+    void Image::RemoveLoadHook(size_t handle) {
+        GetLoadHooks().Remove(handle);
+    }
+
+    bool Image::LoadFromHooks(const string &source, int flags, cv::Mat &data) {
+        return GetLoadHooks().CallUntil([&] (const LoadHook &hook) {
+            return hook(source, flags, data);
+        });
+    }
 }
@@ -1,8 +1,11 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include "../common/assert.hpp"
+#include "mappedImage.hpp"
 
 #ifndef OPTONAUT_IMAGE_HEADER
 #define OPTONAUT_IMAGE_HEADER
@@ -87,28 +90,142 @@ namespace optonaut {
             return data.type();
         }
 
+        /*
+         * Function that is called right before an image is unloaded. 
+         */
+        typedef std::function<void(const Image&)> UnloadHook;
+
+        /*
+         * Registers a function that is called before any image is unloaded. 
+         * Used by caches that hold derived data. 
+         *
+         * @returns A handle for removing the hook. 
+         */
+        static size_t AddUnloadHook(UnloadHook hook);
+
+        /*
+         * Removes a hook registered by AddUnloadHook. Waits until calls of the
+         * hook on other threads returned. 
+         */
+        static void RemoveUnloadHook(size_t handle);
+
+        /*
+         * Function that provides the data of a source from memory. Returns 
+         * false if the source is not available. 
+         */
+        typedef std::function<bool(const std::string &source, int flags, cv::Mat &data)> LoadHook;
+
+        /*
+         * Registers a function that is asked for the data of a source before 
+         * it is decoded. Used by stores that keep images in memory. 
+         *
+         * @returns A handle for removing the hook. 
+         */
+        static size_t AddLoadHook(LoadHook hook);
+
+        /*
+         * Removes a hook registered by AddLoadHook. Waits until calls of the
+         * hook on other threads returned. 
+         */
+        static void RemoveLoadHook(size_t handle);
+
         /*
          * Unloads the underlying cv::Mat. Metadata is persisted. 
          */
         void Unload() {
+            if(IsLoaded()) {
+                NotifyUnload(*this);
+            }
             data.release();
         }
 
         /*
-         * Reloads the image from its source. 
+         * Reloads the image from its source. Mapped image containers
+         * are not decoded, the data is a view into the mapped file. 
          *
          * @param flags cv::imread loading flags. 
          */
         void Load(int flags = cv::IMREAD_COLOR) {
             AssertNEQM(source, std::string(""), "Image has source.");
 
-            cv::Mat n = cv::imread(source, flags);
+            cv::Mat n;
+            if(!LoadFromHooks(source, flags, n)) {
+                n = Decode(source, flags);
+            }
             std::swap(data, n);
             cols = data.cols;
             rows = data.rows;
 
             Assert(cols != 0 && rows != 0);
         }
+
+        /*
+         * Loads the image from its source, downsampled by 2^level, like
+         * level-fold pyrDown. Metadata is updated to the downsampled size. 
+         *
+         * JPEG sources are downsampled by the decoder in the DCT domain, up to 1/8, 
+         * which is much cheaper than decoding the full image. All other sources are 
+         * decoded at full size and downsampled using pyrDown. 
+         *
+         * @param level The count of times the size is halved. 
+         * @param flags cv::imread loading flags. 
+         */
+        void LoadScaled(int level, int flags = cv::IMREAD_COLOR) {
+            AssertGE(level, 0);
+            AssertNEQM(source, std::string(""), "Image has source.");
+
+            // Largest reduction supported by the JPEG decoder, 1/8. 
+            static const int maxDecodeLevel = 3;
+
+            cv::Mat n;
+            int decoded = 0;
+
+            if(LoadFromHooks(source, flags, n)) {
+                // Already in memory, only the pyramid is needed. 
+            } else if(level > 0 && IsJpegPath(source) && 
+                    (flags == cv::IMREAD_COLOR || flags == cv::IMREAD_GRAYSCALE)) {
+                decoded = std::min(level, maxDecodeLevel);
+                n = cv::imread(source, GetReducedLoadFlags(decoded, flags));
+            } else {
+                n = Decode(source, flags);
+            }
+
+            Assert(n.cols != 0 && n.rows != 0);
+
+            for(int i = decoded; i < level; i++) {
+                cv::pyrDown(n, n);
+            }
+
+            std::swap(data, n);
+            cols = data.cols;
+            rows = data.rows;
+        }
+
+        private:
+        static void NotifyUnload(const Image &image);
+        static bool LoadFromHooks(const std::string &source, int flags, cv::Mat &data);
+
+        static cv::Mat Decode(const std::string &source, int flags) {
+            return IsMappedImagePath(source) ? 
+                ReadMappedImage(source, flags) : cv::imread(source, flags);
+        }
+
+        static bool IsJpegPath(const std::string &source) {
+            return StringEndsWith(source, ".jpg") || StringEndsWith(source, ".jpeg") ||
+                StringEndsWith(source, ".JPG") || StringEndsWith(source, ".JPEG");
+        }
+
+        /*
+         * Returns the imread flags for decoding at 1/2^level of the size. 
+         */
+        static int GetReducedLoadFlags(int level, int flags) {
+            static const int color[] = { cv::IMREAD_COLOR, cv::IMREAD_REDUCED_COLOR_2, 
+                cv::IMREAD_REDUCED_COLOR_4, cv::IMREAD_REDUCED_COLOR_8 };
+            static const int grayscale[] = { cv::IMREAD_GRAYSCALE, cv::IMREAD_REDUCED_GRAYSCALE_2, 
+                cv::IMREAD_REDUCED_GRAYSCALE_4, cv::IMREAD_REDUCED_GRAYSCALE_8 };
+
+            return flags == cv::IMREAD_COLOR ? color[level] : grayscale[level];
+        }
 	};
 
     /*
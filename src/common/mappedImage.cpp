@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <opencv2/imgproc.hpp>
+
+#include "mappedImage.hpp"
+#include "support.hpp"
+#include "assert.hpp"
+
+using namespace std;
+using namespace cv;
+
+namespace optonaut {
+
+    const string MappedImageExtension = ".raw";
+
+    static const char magic[8] = { 'O', 'P', 'T', 'O', 'M', 'A', 'T', '\0' };
+    static const int32_t version = 1;
+
+    /*
+     * Header of a mapped image container. Pixel data follows at dataOffset,
+     * row by row without padding.
+     */
+    struct MappedImageHeader {
+        char magic[8];
+        int32_t version;
+        int32_t rows;
+        int32_t cols;
+        int32_t type;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+        uint8_t reserved[24];
+    };
+
+    // Keeps the pixel data 64 byte aligned within the mapping.
+    static_assert(sizeof(MappedImageHeader) == 64, "Mapped image header is 64 bytes");
+
+    /*
+     * OpenCV allocator for matrices that view a file mapping. It never allocates,
+     * it only unmaps the file when the last matrix referencing it is released.
+     */
+    class MappedImageAllocator : public MatAllocator {
+    public:
+        UMatData* allocate(int, const int*, int, void*, size_t*, int, UMatUsageFlags) const {
+            AssertM(false, "Mapped images can't be allocated");
+            return NULL;
+        }
+
+        bool allocate(UMatData* u, int, UMatUsageFlags) const {
+            return u != NULL;
+        }
+
+        void deallocate(UMatData* u) const {
+            if(u == NULL) {
+                return;
+            }
+
+            AssertEQ(u->refcount, 0);
+
+            munmap(u->origdata, u->size);
+            delete u;
+        }
+    };
+
+    static MappedImageAllocator &GetMappedImageAllocator() {
+        static MappedImageAllocator allocator;
+        return allocator;
+    }
+
+    bool IsMappedImagePath(const string &path) {
+        return StringEndsWith(path, MappedImageExtension);
+    }
+
+    void WriteMappedImage(const Mat &image, const string &path) {
+        MappedImageHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.rows = image.rows;
+        header.cols = image.cols;
+        header.type = image.type();
+        header.dataOffset = sizeof(header);
+        header.dataSize = (uint64_t)image.rows * image.cols * image.elemSize();
+
+        const string tempPath = path + ".tmp";
+
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        AssertM(file != NULL, "Able to write mapped image");
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        const size_t rowSize = image.cols * image.elemSize();
+
+        if(image.isContinuous()) {
+            ok = ok && fwrite(image.data, 1, header.dataSize, file) == header.dataSize;
+        } else {
+            for(int y = 0; y < image.rows && ok; y++) {
+                ok = fwrite(image.ptr(y), 1, rowSize, file) == rowSize;
+            }
+        }
+
+        ok = fclose(file) == 0 && ok;
+        AssertM(ok, "Able to write mapped image data");
+
+        // Replace atomically, existing mappings keep the old file.
+        AssertM(rename(tempPath.c_str(), path.c_str()) == 0, "Able to move mapped image in place");
+    }
+
+    Mat ReadMappedImage(const string &path, int flags) {
+        int fd = open(path.c_str(), O_RDONLY);
+        AssertM(fd >= 0, "Able to open mapped image: " + path);
+
+        struct stat info;
+        AssertM(fstat(fd, &info) == 0, "Able to stat mapped image");
+        const size_t size = info.st_size;
+        AssertGEM(size, sizeof(MappedImageHeader), "Mapped image has header");
+
+        // Private mapping, so writes to the image are copy on write.
+        void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        AssertM(base != MAP_FAILED, "Able to map image: " + path);
+
+        const MappedImageHeader &header = *(const MappedImageHeader*)base;
+        const bool valid = memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+            header.version == version &&
+            header.dataOffset + header.dataSize <= size &&
+            header.dataSize == (uint64_t)header.rows * header.cols * CV_ELEM_SIZE(header.type);
+
+        if(!valid) {
+            munmap(base, size);
+            AssertM(false, "Mapped image is valid: " + path);
+        }
+
+        UMatData* u = new UMatData(&GetMappedImageAllocator());
+        u->data = u->origdata = (uchar*)base;
+        u->size = size;
+
+        Mat image(header.rows, header.cols, header.type, (uchar*)base + header.dataOffset);
+        // The matrix takes the only reference to the mapping.
+        image.u = u;
+        u->refcount = 1;
+
+        return ConvertToLoadFlags(image, flags);
+    }
+
+    Mat ConvertToLoadFlags(const Mat &image, int flags) {
+        if(flags < 0) {
+            return image;
+        }
+
+        const bool color = (flags & IMREAD_COLOR) != 0;
+
+        if(color && image.channels() == 1) {
+            Mat converted;
+            cvtColor(image, converted, COLOR_GRAY2BGR);
+            return converted;
+        }
+
+        if(!color && image.channels() == 3) {
+            Mat converted;
+            cvtColor(image, converted, COLOR_BGR2GRAY);
+            return converted;
+        }
+
+        return image;
+    }
+}
@@ -0,0 +1,51 @@
+#include <string>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#ifndef OPTONAUT_MAPPED_IMAGE_HEADER
+#define OPTONAUT_MAPPED_IMAGE_HEADER
+
+namespace optonaut {
+
+    /*
+     * File extension of mapped image containers.
+     */
+    extern const std::string MappedImageExtension;
+
+    /*
+     * Returns true if the given path refers to a mapped image container.
+     */
+    bool IsMappedImagePath(const std::string &path);
+
+    /*
+     * Writes an image to an uncompressed container that can be memory mapped.
+     *
+     * The file is written to a temporary location first and then moved in place,
+     * so images that are currently mapped from the same path stay valid.
+     *
+     * @param image The image to write. Any type is supported.
+     * @param path The destination path. The directory has to exist.
+     */
+    void WriteMappedImage(const cv::Mat &image, const std::string &path);
+
+    /*
+     * Maps an image container into memory.
+     *
+     * The returned matrix is a view into the mapping, no pixel data is copied.
+     * The mapping is private, so writing to the matrix does not change the file,
+     * and it is released with the last reference to the matrix.
+     *
+     * @param path The path of the container.
+     * @param flags cv::imread loading flags. If the flags request a different count
+     *              of channels than stored, the image is converted, which copies it.
+     */
+    cv::Mat ReadMappedImage(const std::string &path, int flags = cv::IMREAD_UNCHANGED);
+
+    /*
+     * Converts an image to the count of channels requested by cv::imread flags.
+     * Returns the image itself, without copying, if no conversion is necessary.
+     */
+    cv::Mat ConvertToLoadFlags(const cv::Mat &image, int flags);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+
+#include "assert.hpp"
+
+#ifndef OPTONAUT_MEMORY_BUDGET_HEADER
+#define OPTONAUT_MEMORY_BUDGET_HEADER
+
+namespace optonaut {
+
+    /*
+     * Limits the memory used by concurrent tasks. Tasks reserve their
+     * estimated memory before they start and block until enough of the
+     * budget is available.
+     *
+     * A reservation larger than the whole budget is granted as soon as
+     * no other reservation is active, so oversized tasks run alone instead
+     * of blocking forever.
+     *
+     * Thread safe.
+     */
+    class MemoryBudget {
+    private:
+        const size_t limit;
+        size_t used;
+        size_t active;
+        std::mutex m;
+        std::condition_variable sem;
+
+    public:
+        /*
+         * Reservation of a part of the budget. The memory is
+         * returned to the budget on destruction.
+         */
+        class Reservation {
+        private:
+            MemoryBudget &budget;
+            const size_t bytes;
+        public:
+            Reservation(MemoryBudget &budget, size_t bytes) :
+                budget(budget), bytes(bytes) {
+                budget.Acquire(bytes);
+            }
+
+            ~Reservation() {
+                budget.Release(bytes);
+            }
+
+            Reservation(const Reservation&) = delete;
+            Reservation& operator=(const Reservation&) = delete;
+        };
+
+        /*
+         * Creates a new budget.
+         *
+         * @param limit The memory available to all tasks, in bytes.
+         */
+        MemoryBudget(size_t limit) : limit(limit), used(0), active(0) {
+            AssertGT(limit, (size_t)0);
+        }
+
+        MemoryBudget(const MemoryBudget&) = delete;
+        MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+        /*
+         * Reserves the given amount of memory, blocks until it is available.
+         */
+        void Acquire(size_t bytes) {
+            std::unique_lock<std::mutex> lock(m);
+            while(active > 0 && used + bytes > limit)
+                sem.wait(lock);
+
+            used += bytes;
+            active++;
+        }
+
+        /*
+         * Returns memory reserved by Acquire.
+         */
+        void Release(size_t bytes) {
+            std::unique_lock<std::mutex> lock(m);
+            AssertGE(used, bytes);
+            AssertGT(active, (size_t)0);
+            used -= bytes;
+            active--;
+            sem.notify_all();
+        }
+
+        /*
+         * Returns the currently reserved memory, in bytes.
+         */
+        size_t GetUsedBytes() {
+            std::unique_lock<std::mutex> lock(m);
+            return used;
+        }
+
+        /*
+         * Returns the memory available to all tasks, in bytes.
+         */
+        size_t GetLimit() const {
+            return limit;
+        }
+    };
+
+    typedef std::shared_ptr<MemoryBudget> MemoryBudgetP;
+}
+
+#endif
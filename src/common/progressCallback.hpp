@@ -1,5 +1,6 @@
 #include <functional>
 #include <vector>
+#include <mutex>
 // Note: We need to stick with cassert here
 // since this code might be included from app side
 // and that does not work well with the Assert header.
@@ -54,19 +55,25 @@ namespace optonaut {
    
     /*
      * A progress callback that accumuates multiple child progress callbacks. 
+     * Child callbacks may be called from different threads. 
      */ 
     class ProgressCallbackAccumulator {
     private:
         size_t count;
         ProgressCallback &parent;
         std::vector<float> weights;
+        std::vector<float> values;
         std::vector<ProgressCallback> callbacks;
+        std::mutex m;
         
-        bool updateAndCall() {
+        bool updateAndCall(size_t id, float value) {
+            std::unique_lock<std::mutex> lock(m);
             float progress = 0;
+
+            values[id] = value;
             
             for (size_t i = 0; i < count; i++) {
-                progress += weights[i] * callbacks[i].GetLastProgress();
+                progress += weights[i] * values[i];
             }
             
             return parent(progress);
@@ -78,15 +85,18 @@ namespace optonaut {
          * @param parent The parent progress callback to call. 
          * @param weights The weights for each child progress callback. For each weight passed, a child callback is created.  
          */
-        ProgressCallbackAccumulator(ProgressCallback &parent, std::vector<float> weights) : count (weights.size()), parent(parent), weights(weights), callbacks() {
+        ProgressCallbackAccumulator(ProgressCallback &parent, std::vector<float> weights) : count (weights.size()), parent(parent), weights(weights), values(weights.size(), 0), callbacks() {
             callbacks.reserve(count);
             for (size_t i = 0; i < count; i++) {
-                callbacks.emplace_back([&](float) -> bool {
-                    return updateAndCall();
+                callbacks.emplace_back([this, i](float value) -> bool {
+                    return updateAndCall(i, value);
                 });
             }
         }
 
+        ProgressCallbackAccumulator(const ProgressCallbackAccumulator&) = delete;
+        ProgressCallbackAccumulator& operator=(const ProgressCallbackAccumulator&) = delete;
+
         /*
          * Gets the child progress callback at the given index. 
          */
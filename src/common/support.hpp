@@ -30,6 +30,22 @@ namespace optonaut {
         else
             return dir.substr(0, last);
     }
+
+    /*
+     * Gets the file name from a path. 
+     *
+     * @param path The path to get the file name for. 
+     *
+     * @returns the path without the directory name. 
+     */
+    inline std::string GetFileName(const std::string &path) {
+        size_t last = path.find_last_of("/"); 
+
+        if(last == std::string::npos)
+            return path;
+        else
+            return path.substr(last + 1);
+    }
    
     /*
      * Parses an object or struct with the given type from the given char array using
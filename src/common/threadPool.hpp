@@ -0,0 +1,194 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <memory>
+
+#include "assert.hpp"
+
+using namespace std;
+
+#ifndef OPTONAUT_THREAD_POOL_HEADER
+#define OPTONAUT_THREAD_POOL_HEADER
+
+namespace optonaut {
+    /*
+     * Fixed-size pool of worker threads that executes tasks
+     * in FIFO order.
+     */
+    class ThreadPool {
+    private:
+        vector<thread> workers;
+        deque<function<void()>> tasks;
+        bool running;
+
+        mutex m;
+        condition_variable sem;
+
+        void WorkerLoop() {
+            while(true) {
+                function<void()> task;
+                {
+                    unique_lock<mutex> lock(m);
+                    while(running && tasks.size() == 0)
+                        sem.wait(lock);
+
+                    if(!running && tasks.size() == 0)
+                        break;
+
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+
+        /*
+         * Shared state of a parallel for loop. Kept alive by
+         * all helper tasks, since they might be started after
+         * the loop already finished.
+         */
+        struct ParallelForState {
+            function<void(int)> body;
+            int end;
+            atomic<int> next;
+            atomic<int> done;
+            mutex m;
+            condition_variable sem;
+
+            ParallelForState(function<void(int)> body, int begin, int end) :
+                body(body), end(end), next(begin), done(0) { }
+
+            /*
+             * Takes indices until none are left.
+             */
+            void Run() {
+                int count = 0;
+                for(int i = next++; i < end; i = next++) {
+                    body(i);
+                    count++;
+                }
+
+                if(count > 0) {
+                    unique_lock<mutex> lock(m);
+                    done += count;
+                    sem.notify_all();
+                }
+            }
+        };
+
+    public:
+        /*
+         * Creates a new thread pool.
+         *
+         * @param threads The count of worker threads.
+         */
+        ThreadPool(size_t threads = DefaultThreadCount()) : running(true) {
+            AssertGT(threads, (size_t)0);
+
+            for(size_t i = 0; i < threads; i++) {
+                workers.emplace_back(&ThreadPool::WorkerLoop, this);
+            }
+        }
+
+        /*
+         * Finishes all queued tasks, then joins all workers.
+         */
+        ~ThreadPool() {
+            {
+                unique_lock<mutex> lock(m);
+                running = false;
+                sem.notify_all();
+            }
+
+            for(auto &worker : workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /*
+         * Queues a task for execution.
+         *
+         * @returns A future for the result of the task.
+         */
+        template <typename F>
+        future<typename result_of<F()>::type> Push(F f) {
+            typedef typename result_of<F()>::type R;
+
+            auto task = make_shared<packaged_task<R()>>(std::move(f));
+            future<R> result = task->get_future();
+            {
+                unique_lock<mutex> lock(m);
+                AssertM(running, "Thread pool is running");
+                tasks.push_back([task] () { (*task)(); });
+                sem.notify_one();
+            }
+
+            return result;
+        }
+
+        /*
+         * Calls body for each index in [begin, end) and blocks until all
+         * calls returned. The calling thread takes part in the work, so
+         * this is safe to call from inside a pool task.
+         *
+         * The order in which indices are processed is undefined.
+         */
+        void ParallelFor(int begin, int end, function<void(int)> body) {
+            if(end <= begin) {
+                return;
+            }
+
+            const int count = end - begin;
+            auto state = make_shared<ParallelForState>(body, begin, end);
+            const int helpers = std::min((int)workers.size(), count - 1);
+
+            {
+                unique_lock<mutex> lock(m);
+                for(int i = 0; i < helpers; i++) {
+                    tasks.push_back([state] () { state->Run(); });
+                }
+                sem.notify_all();
+            }
+
+            state->Run();
+
+            unique_lock<mutex> lock(state->m);
+            while(state->done < count)
+                state->sem.wait(lock);
+        }
+
+        /*
+         * Returns the count of worker threads.
+         */
+        size_t Size() const {
+            return workers.size();
+        }
+
+        /*
+         * Returns the count of hardware threads, or one if unknown.
+         */
+        static size_t DefaultThreadCount() {
+            size_t n = thread::hardware_concurrency();
+            return n == 0 ? 1 : n;
+        }
+
+        /*
+         * Returns the process-wide default pool.
+         */
+        static ThreadPool &Default() {
+            static ThreadPool pool;
+            return pool;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include <vector>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <memory>
+
+#include "assert.hpp"
+#include "memoryBudget.hpp"
+#include "threadPool.hpp"
+
+#ifndef OPTONAUT_WRITE_BEHIND_QUEUE_HEADER
+#define OPTONAUT_WRITE_BEHIND_QUEUE_HEADER
+
+namespace optonaut {
+
+    /*
+     * Runs write operations in the background, so producers don't wait
+     * for encoding and disk latency.
+     *
+     * The bytes held by queued writes are limited. Push blocks while the
+     * limit is exceeded, so a slow disk applies back pressure instead of
+     * piling up images in memory.
+     *
+     * Thread safe.
+     */
+    class WriteBehindQueue {
+    private:
+        // Declared before the pool, so it outlives all running writes.
+        MemoryBudget budget;
+        ThreadPool pool;
+
+        std::mutex m;
+        std::vector<std::future<void>> pending;
+
+        /*
+         * Removes finished writes. Errors of finished writes are re-thrown.
+         */
+        void CollectFinished() {
+            std::vector<std::future<void>> finished;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                auto it = pending.begin();
+                while(it != pending.end()) {
+                    if(it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                        finished.push_back(std::move(*it));
+                        it = pending.erase(it);
+                    } else {
+                        it++;
+                    }
+                }
+            }
+
+            for(auto &write : finished) {
+                write.get();
+            }
+        }
+
+    public:
+        /*
+         * Creates a new queue.
+         *
+         * @param writers The count of writes that run in parallel.
+         * @param maxBytes The bytes that may be held by queued writes.
+         */
+        WriteBehindQueue(size_t writers, size_t maxBytes) :
+            budget(maxBytes), pool(writers) { }
+
+        WriteBehindQueue(const WriteBehindQueue&) = delete;
+        WriteBehindQueue& operator=(const WriteBehindQueue&) = delete;
+
+        /*
+         * Queues a write.
+         *
+         * @param bytes The memory held by the write until it is done.
+         * @param write The write operation. It must own all data it writes.
+         */
+        void Push(size_t bytes, std::function<void()> write) {
+            CollectFinished();
+
+            budget.Acquire(bytes);
+
+            MemoryBudget &budget = this->budget;
+            auto task = [&budget, bytes, write] () {
+                // Returns the memory even if the write fails.
+                struct Release {
+                    MemoryBudget &budget;
+                    const size_t bytes;
+                    ~Release() { budget.Release(bytes); }
+                } release { budget, bytes };
+
+                write();
+            };
+
+            std::unique_lock<std::mutex> lock(m);
+            pending.push_back(pool.Push(task));
+        }
+
+        /*
+         * Blocks until all queued writes are done. Re-throws the
+         * first error that occurred during writing.
+         */
+        void Flush() {
+            std::vector<std::future<void>> writes;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                std::swap(writes, pending);
+            }
+
+            for(auto &write : writes) {
+                write.wait();
+            }
+
+            for(auto &write : writes) {
+                write.get();
+            }
+        }
+
+        /*
+         * Returns the bytes held by queued writes.
+         */
+        size_t GetQueuedBytes() {
+            return budget.GetUsedBytes();
+        }
+    };
+
+    typedef std::shared_ptr<WriteBehindQueue> WriteBehindQueueP;
+}
+
+#endif
@@ -0,0 +1,466 @@
+/*
+ * Row kernels for the planar correlator error metrics.
+ *
+ * All kernels work on a contiguous span of 8-bit BGR or grayscale pixels 
+ * and only consider every CorrelatorSampleStep-th pixel, which is the sampling 
+ * pattern of BaseCorrelator. The SIMD paths are selected at compile time
+ * (AVX2, then SSE4.1), otherwise a scalar fallback is used. x86 builds
+ * enable SSE4.1 by default (BUILD_SSE41), AVX2 needs BUILD_NATIVE_SIMD.
+ * There is no NEON path, so ARM builds use the scalar fallback.
+ *
+ * The integer kernels (*Int, *Gray) are exact. They accumulate in 32 bit, 
+ * which holds for rows of up to 11000 samples. 
+ */
+
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+#ifndef OPTONAUT_CORRELATOR_KERNELS_HEADER
+#define OPTONAUT_CORRELATOR_KERNELS_HEADER
+
+namespace optonaut {
+
+    /*
+     * Distance between two sampled pixels of a correlated row, in pixels.
+     */
+    const int CorrelatorSampleStep = 3;
+
+namespace kernels {
+
+    /*
+     * Distance between two sampled BGR pixels, in bytes.
+     */
+    const int BGRSampleStride = CorrelatorSampleStep * 3;
+
+    /*
+     * Distance between two sampled grayscale pixels, in bytes.
+     */
+    const int GraySampleStride = CorrelatorSampleStep;
+
+    /*
+     * Scalar implementations. Also used for the remainder of each row
+     * by the SIMD implementations.
+     */
+    namespace scalar {
+        inline float SquaredDifferenceBGR(const uint8_t *a, const uint8_t *b, int n) {
+            float sum = 0;
+            for(int i = 0; i < n; i++, a += BGRSampleStride, b += BGRSampleStride) {
+                float d0 = (float)a[0] - (float)b[0];
+                float d1 = (float)a[1] - (float)b[1];
+                float d2 = (float)a[2] - (float)b[2];
+                sum += d0 * d0 + d1 * d1 + d2 * d2;
+            }
+            return sum;
+        }
+
+        inline float AbsoluteDifferenceBGR(const uint8_t *a, const uint8_t *b, int n) {
+            float sum = 0;
+            for(int i = 0; i < n; i++, a += BGRSampleStride, b += BGRSampleStride) {
+                sum += std::abs((float)a[0] - (float)b[0]) +
+                       std::abs((float)a[1] - (float)b[1]) +
+                       std::abs((float)a[2] - (float)b[2]);
+            }
+            return sum;
+        }
+
+        inline int32_t DifferenceBGR(const uint8_t *a, const uint8_t *b, int n) {
+            int32_t sum = 0;
+            for(int i = 0; i < n; i++, a += BGRSampleStride, b += BGRSampleStride) {
+                sum += ((int32_t)a[0] + a[1] + a[2]) - ((int32_t)b[0] + b[1] + b[2]);
+            }
+            return sum;
+        }
+
+        inline int32_t SumBGR(const uint8_t *a, int n) {
+            int32_t sum = 0;
+            for(int i = 0; i < n; i++, a += BGRSampleStride) {
+                sum += (int32_t)a[0] + a[1] + a[2];
+            }
+            return sum;
+        }
+
+        inline int32_t SquaredDifferenceBGRInt(const uint8_t *a, const uint8_t *b, int n) {
+            int32_t sum = 0;
+            for(int i = 0; i < n; i++, a += BGRSampleStride, b += BGRSampleStride) {
+                int32_t d0 = (int32_t)a[0] - b[0];
+                int32_t d1 = (int32_t)a[1] - b[1];
+                int32_t d2 = (int32_t)a[2] - b[2];
+                sum += d0 * d0 + d1 * d1 + d2 * d2;
+            }
+            return sum;
+        }
+
+        inline int32_t AbsoluteDifferenceBGRInt(const uint8_t *a, const uint8_t *b, int n) {
+            int32_t sum = 0;
+            for(int i = 0; i < n; i++, a += BGRSampleStride, b += BGRSampleStride) {
+                sum += std::abs((int32_t)a[0] - b[0]) +
+                       std::abs((int32_t)a[1] - b[1]) +
+                       std::abs((int32_t)a[2] - b[2]);
+            }
+            return sum;
+        }
+
+        inline int32_t SquaredDifferenceGray(const uint8_t *a, const uint8_t *b, int n) {
+            int32_t sum = 0;
+            for(int i = 0; i < n; i++, a += GraySampleStride, b += GraySampleStride) {
+                int32_t d = (int32_t)a[0] - b[0];
+                sum += d * d;
+            }
+            return sum;
+        }
+
+        inline int32_t AbsoluteDifferenceGray(const uint8_t *a, const uint8_t *b, int n) {
+            int32_t sum = 0;
+            for(int i = 0; i < n; i++, a += GraySampleStride, b += GraySampleStride) {
+                sum += std::abs((int32_t)a[0] - b[0]);
+            }
+            return sum;
+        }
+    }
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+    /*
+     * Gathers four sampled BGR pixels, starting at p, into one register.
+     * Each pixel is placed in a 4 byte slot, padded with zero (BGR0).
+     *
+     * Reads 34 bytes starting at p.
+     */
+    static inline __m128i GatherBGR4(const uint8_t *p) {
+        const __m128i lo = _mm_setr_epi8(0, 1, 2, -1, 9, 10, 11, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                0, 1, 2, -1, 9, 10, 11, -1);
+        __m128i x0 = _mm_loadu_si128((const __m128i*)p);
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 2 * BGRSampleStride));
+        return _mm_or_si128(_mm_shuffle_epi8(x0, lo), _mm_shuffle_epi8(x1, hi));
+    }
+
+    /*
+     * Horizontal sum of all four lanes.
+     */
+    static inline float HorizontalSum(__m128 v) {
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+        return _mm_cvtss_f32(v);
+    }
+
+    static inline int32_t HorizontalSum(__m128i v) {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(v);
+    }
+
+    /*
+     * Gathers twelve sampled grayscale pixels, starting at p, into one register. 
+     * The samples are placed in bytes 0-5 and 8-13, all other bytes are zero.
+     *
+     * Reads 34 bytes starting at p.
+     */
+    static inline __m128i GatherGray12(const uint8_t *p) {
+        const __m128i lo = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                0, 3, 6, 9, 12, 15, -1, -1);
+        __m128i x0 = _mm_loadu_si128((const __m128i*)p);
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 6 * GraySampleStride));
+        return _mm_or_si128(_mm_shuffle_epi8(x0, lo), _mm_shuffle_epi8(x1, hi));
+    }
+
+    /*
+     * Sum of the two 64-bit lanes, as produced by psadbw. 
+     */
+    static inline int32_t SumSAD(__m128i v) {
+        return _mm_cvtsi128_si32(v) + _mm_extract_epi32(v, 2);
+    }
+
+    // Number of samples that have to be left in the row so that
+    // a block of twelve grayscale samples can be read safely.
+    const int GrayBlockSafeSamples = 12;
+#endif
+
+#if defined(__AVX2__)
+    /*
+     * Gathers eight sampled BGR pixels, as BGR0 16-bit values.
+     * Reads 70 bytes starting at p.
+     */
+    static inline void GatherBGR8(const uint8_t *p, __m256i &lo, __m256i &hi) {
+        lo = _mm256_cvtepu8_epi16(GatherBGR4(p));
+        hi = _mm256_cvtepu8_epi16(GatherBGR4(p + 4 * BGRSampleStride));
+    }
+
+    static inline float HorizontalSum(__m256 v) {
+        return HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(v),
+                    _mm256_extractf128_ps(v, 1)));
+    }
+
+    static inline int32_t HorizontalSum(__m256i v) {
+        return HorizontalSum(_mm_add_epi32(_mm256_castsi256_si128(v),
+                    _mm256_extracti128_si256(v, 1)));
+    }
+
+    /*
+     * Converts 16 signed 16-bit values to two vectors of floats.
+     */
+    static inline void ToFloat(__m256i v, __m256 &lo, __m256 &hi) {
+        lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+    }
+
+    // Number of samples that have to be left in the row so that
+    // a block of eight can be read safely.
+    const int BlockSafeSamples = 9;
+#elif defined(__SSE4_1__)
+    /*
+     * Converts 8 signed 16-bit values to two vectors of floats.
+     */
+    static inline void ToFloat(__m128i v, __m128 &lo, __m128 &hi) {
+        lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(v));
+        hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8)));
+    }
+
+    // Number of samples that have to be left in the row so that
+    // a block of four can be read safely.
+    const int BlockSafeSamples = 5;
+#endif
+
+    /*
+     * Sum of squared channel differences of n sampled BGR pixels.
+     */
+    inline float SquaredDifferenceBGR(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        float sum = 0;
+#if defined(__AVX2__)
+        __m256 acc = _mm256_setzero_ps();
+        for(; i + BlockSafeSamples <= n; i += 8) {
+            __m256i a0, a1, b0, b1;
+            __m256 f0, f1, f2, f3;
+            GatherBGR8(a + i * BGRSampleStride, a0, a1);
+            GatherBGR8(b + i * BGRSampleStride, b0, b1);
+            ToFloat(_mm256_sub_epi16(a0, b0), f0, f1);
+            ToFloat(_mm256_sub_epi16(a1, b1), f2, f3);
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(f0, f0));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(f1, f1));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(f2, f2));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(f3, f3));
+        }
+        sum = HorizontalSum(acc);
+#elif defined(__SSE4_1__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128 acc = _mm_setzero_ps();
+        for(; i + BlockSafeSamples <= n; i += 4) {
+            __m128i ga = GatherBGR4(a + i * BGRSampleStride);
+            __m128i gb = GatherBGR4(b + i * BGRSampleStride);
+            __m128 f0, f1, f2, f3;
+            ToFloat(_mm_sub_epi16(_mm_cvtepu8_epi16(ga), _mm_cvtepu8_epi16(gb)), f0, f1);
+            ToFloat(_mm_sub_epi16(_mm_unpackhi_epi8(ga, zero), _mm_unpackhi_epi8(gb, zero)), f2, f3);
+            acc = _mm_add_ps(acc, _mm_mul_ps(f0, f0));
+            acc = _mm_add_ps(acc, _mm_mul_ps(f1, f1));
+            acc = _mm_add_ps(acc, _mm_mul_ps(f2, f2));
+            acc = _mm_add_ps(acc, _mm_mul_ps(f3, f3));
+        }
+        sum = HorizontalSum(acc);
+#endif
+        return sum + scalar::SquaredDifferenceBGR(a + i * BGRSampleStride,
+                b + i * BGRSampleStride, n - i);
+    }
+
+    /*
+     * Sum of absolute channel differences of n sampled BGR pixels.
+     */
+    inline float AbsoluteDifferenceBGR(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        float sum = 0;
+#if defined(__AVX2__)
+        __m256 acc = _mm256_setzero_ps();
+        for(; i + BlockSafeSamples <= n; i += 8) {
+            __m256i a0, a1, b0, b1;
+            __m256 f0, f1, f2, f3;
+            GatherBGR8(a + i * BGRSampleStride, a0, a1);
+            GatherBGR8(b + i * BGRSampleStride, b0, b1);
+            ToFloat(_mm256_abs_epi16(_mm256_sub_epi16(a0, b0)), f0, f1);
+            ToFloat(_mm256_abs_epi16(_mm256_sub_epi16(a1, b1)), f2, f3);
+            acc = _mm256_add_ps(acc, _mm256_add_ps(f0, f1));
+            acc = _mm256_add_ps(acc, _mm256_add_ps(f2, f3));
+        }
+        sum = HorizontalSum(acc);
+#elif defined(__SSE4_1__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128 acc = _mm_setzero_ps();
+        for(; i + BlockSafeSamples <= n; i += 4) {
+            __m128i ga = GatherBGR4(a + i * BGRSampleStride);
+            __m128i gb = GatherBGR4(b + i * BGRSampleStride);
+            __m128 f0, f1, f2, f3;
+            ToFloat(_mm_abs_epi16(_mm_sub_epi16(
+                            _mm_cvtepu8_epi16(ga), _mm_cvtepu8_epi16(gb))), f0, f1);
+            ToFloat(_mm_abs_epi16(_mm_sub_epi16(
+                            _mm_unpackhi_epi8(ga, zero), _mm_unpackhi_epi8(gb, zero))), f2, f3);
+            acc = _mm_add_ps(acc, _mm_add_ps(f0, f1));
+            acc = _mm_add_ps(acc, _mm_add_ps(f2, f3));
+        }
+        sum = HorizontalSum(acc);
+#endif
+        return sum + scalar::AbsoluteDifferenceBGR(a + i * BGRSampleStride,
+                b + i * BGRSampleStride, n - i);
+    }
+
+    /*
+     * Signed difference of the channel sums of n sampled BGR pixels.
+     */
+    inline int32_t DifferenceBGR(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        int32_t sum = 0;
+#if defined(__AVX2__)
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i acc = _mm256_setzero_si256();
+        for(; i + BlockSafeSamples <= n; i += 8) {
+            __m256i a0, a1, b0, b1;
+            GatherBGR8(a + i * BGRSampleStride, a0, a1);
+            GatherBGR8(b + i * BGRSampleStride, b0, b1);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_sub_epi16(a0, b0), ones));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_sub_epi16(a1, b1), ones));
+        }
+        sum = HorizontalSum(acc);
+#elif defined(__SSE4_1__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i acc = _mm_setzero_si128();
+        for(; i + BlockSafeSamples <= n; i += 4) {
+            __m128i ga = GatherBGR4(a + i * BGRSampleStride);
+            __m128i gb = GatherBGR4(b + i * BGRSampleStride);
+            __m128i d0 = _mm_sub_epi16(_mm_cvtepu8_epi16(ga), _mm_cvtepu8_epi16(gb));
+            __m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(ga, zero), _mm_unpackhi_epi8(gb, zero));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d0, ones));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d1, ones));
+        }
+        sum = HorizontalSum(acc);
+#endif
+        return sum + scalar::DifferenceBGR(a + i * BGRSampleStride,
+                b + i * BGRSampleStride, n - i);
+    }
+
+    /*
+     * Sum of all channels of n sampled BGR pixels.
+     */
+    inline int32_t SumBGR(const uint8_t *a, int n) {
+        int i = 0;
+        int32_t sum = 0;
+#if defined(__SSE4_1__) || defined(__AVX2__)
+        // The gathered block is summed with psadbw against zero, which
+        // is faster than widening and works for both instruction sets.
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for(; i + 5 <= n; i += 4) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(GatherBGR4(a + i * BGRSampleStride), zero));
+        }
+        sum = SumSAD(acc);
+#endif
+        return sum + scalar::SumBGR(a + i * BGRSampleStride, n - i);
+    }
+
+    /*
+     * Sum of squared channel differences of n sampled BGR pixels, 
+     * accumulated in integers. 
+     */
+    inline int32_t SquaredDifferenceBGRInt(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        int32_t sum = 0;
+#if defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for(; i + BlockSafeSamples <= n; i += 8) {
+            __m256i a0, a1, b0, b1;
+            GatherBGR8(a + i * BGRSampleStride, a0, a1);
+            GatherBGR8(b + i * BGRSampleStride, b0, b1);
+            __m256i d0 = _mm256_sub_epi16(a0, b0);
+            __m256i d1 = _mm256_sub_epi16(a1, b1);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d0, d0));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d1, d1));
+        }
+        sum = HorizontalSum(acc);
+#elif defined(__SSE4_1__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for(; i + BlockSafeSamples <= n; i += 4) {
+            __m128i ga = GatherBGR4(a + i * BGRSampleStride);
+            __m128i gb = GatherBGR4(b + i * BGRSampleStride);
+            __m128i d0 = _mm_sub_epi16(_mm_cvtepu8_epi16(ga), _mm_cvtepu8_epi16(gb));
+            __m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(ga, zero), _mm_unpackhi_epi8(gb, zero));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d0, d0));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d1, d1));
+        }
+        sum = HorizontalSum(acc);
+#endif
+        return sum + scalar::SquaredDifferenceBGRInt(a + i * BGRSampleStride,
+                b + i * BGRSampleStride, n - i);
+    }
+
+    /*
+     * Sum of absolute channel differences of n sampled BGR pixels, 
+     * accumulated in integers. 
+     */
+    inline int32_t AbsoluteDifferenceBGRInt(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        int32_t sum = 0;
+#if defined(__SSE4_1__) || defined(__AVX2__)
+        // The padding bytes of both gathered blocks are zero, so 
+        // psadbw directly yields the sum of absolute differences.
+        __m128i acc = _mm_setzero_si128();
+        for(; i + 5 <= n; i += 4) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(GatherBGR4(a + i * BGRSampleStride), 
+                        GatherBGR4(b + i * BGRSampleStride)));
+        }
+        sum = SumSAD(acc);
+#endif
+        return sum + scalar::AbsoluteDifferenceBGRInt(a + i * BGRSampleStride,
+                b + i * BGRSampleStride, n - i);
+    }
+
+    /*
+     * Sum of squared differences of n sampled grayscale pixels.
+     */
+    inline int32_t SquaredDifferenceGray(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        int32_t sum = 0;
+#if defined(__SSE4_1__) || defined(__AVX2__)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for(; i + GrayBlockSafeSamples <= n; i += 12) {
+            __m128i ga = GatherGray12(a + i * GraySampleStride);
+            __m128i gb = GatherGray12(b + i * GraySampleStride);
+            __m128i d0 = _mm_sub_epi16(_mm_cvtepu8_epi16(ga), _mm_cvtepu8_epi16(gb));
+            __m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(ga, zero), _mm_unpackhi_epi8(gb, zero));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d0, d0));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d1, d1));
+        }
+        sum = HorizontalSum(acc);
+#endif
+        return sum + scalar::SquaredDifferenceGray(a + i * GraySampleStride,
+                b + i * GraySampleStride, n - i);
+    }
+
+    /*
+     * Sum of absolute differences of n sampled grayscale pixels.
+     */
+    inline int32_t AbsoluteDifferenceGray(const uint8_t *a, const uint8_t *b, int n) {
+        int i = 0;
+        int32_t sum = 0;
+#if defined(__SSE4_1__) || defined(__AVX2__)
+        __m128i acc = _mm_setzero_si128();
+        for(; i + GrayBlockSafeSamples <= n; i += 12) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(GatherGray12(a + i * GraySampleStride),
+                        GatherGray12(b + i * GraySampleStride)));
+        }
+        sum = SumSAD(acc);
+#endif
+        return sum + scalar::AbsoluteDifferenceGray(a + i * GraySampleStride,
+                b + i * GraySampleStride, n - i);
+    }
+}
+}
+
+#endif
@@ -0,0 +1,317 @@
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+#include "../common/image.hpp"
+#include "../common/assert.hpp"
+#include "../io/inputImage.hpp"
+
+#ifndef OPTONAUT_IMAGE_PYRAMID_HEADER
+#define OPTONAUT_IMAGE_PYRAMID_HEADER
+
+namespace optonaut {
+
+/*
+ * Converts a color image to a grayscale (luma) image. 
+ * Single channel images are returned as they are. 
+ */
+inline cv::Mat ToLuma(const cv::Mat &image) {
+    if(image.channels() == 1) {
+        return image;
+    }
+
+    cv::Mat gray;
+    cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+/*
+ * Gaussian image pyramid. Levels are created on demand,
+ * by repeatedly applying pyrDown to the base image.
+ *
+ * Thread safe.
+ */
+class ImagePyramid {
+    private:
+    // Deque, so references to existing levels stay valid when adding levels.
+    std::deque<cv::Mat> levels;
+    // Copies of the base properties, so they can be read without locking.
+    const cv::Mat base;
+    const size_t byteSize;
+    mutable std::mutex m;
+
+    public:
+    /*
+     * Creates a new pyramid. The base image is not copied.
+     *
+     * @param ownsBase True if the base image was created for this pyramid
+     *                 only, so it is counted by GetByteSize. 
+     */
+    ImagePyramid(const cv::Mat &base, bool ownsBase = false) : base(base),
+        byteSize(base.total() * base.elemSize() / 3 + (ownsBase ? base.total() * base.elemSize() : 0)) {
+        levels.push_back(base);
+    }
+
+    /*
+     * Returns the given pyramid level, 0 being the base image.
+     */
+    const cv::Mat &GetLevel(size_t level) {
+        std::unique_lock<std::mutex> lock(m);
+
+        while(levels.size() <= level) {
+            cv::Mat next;
+            pyrDown(levels.back(), next);
+            levels.push_back(next);
+        }
+
+        return levels[level];
+    }
+
+    /*
+     * Returns the base image.
+     */
+    const cv::Mat &GetBase() const {
+        return base;
+    }
+
+    /*
+     * Returns the size of the base image.
+     */
+    cv::Size GetSize() const {
+        return base.size();
+    }
+
+    /*
+     * Returns the estimated memory used by all levels, in bytes. The base
+     * is only counted if it is owned, otherwise it is shared with the source image.
+     */
+    size_t GetByteSize() const {
+        return byteSize;
+    }
+};
+
+typedef std::shared_ptr<ImagePyramid> ImagePyramidP;
+
+/*
+ * View into a region of an image pyramid. 
+ *
+ * Views of the whole image use all levels of the shared pyramid. Views of 
+ * sub-regions share the base level only. Their coarser levels are created from 
+ * the crop, since cropping a coarser shared level would include pixels outside 
+ * of the region. So views of cropped regions give the same levels as pyramids 
+ * of the crop.
+ */
+class PyramidView {
+    private:
+    ImagePyramidP pyramid;
+    // Pyramid of the cropped region, or null for views of the whole image.
+    ImagePyramidP crop;
+
+    public:
+    /*
+     * Creates a view of the whole pyramid.
+     */
+    explicit PyramidView(ImagePyramidP pyramid) : pyramid(pyramid) { }
+
+    /*
+     * Creates a view of the given region of the pyramid.
+     */
+    PyramidView(ImagePyramidP pyramid, const cv::Rect &roi) : pyramid(pyramid) {
+        AssertM((roi & cv::Rect(cv::Point(0, 0), pyramid->GetSize())) == roi,
+                "View is inside pyramid");
+
+        if(roi.size() != pyramid->GetSize()) {
+            crop = std::make_shared<ImagePyramid>(pyramid->GetBase()(roi));
+        }
+    }
+
+    /*
+     * Creates a view of an uncached pyramid of the given image.
+     */
+    explicit PyramidView(const cv::Mat &image) :
+        pyramid(std::make_shared<ImagePyramid>(image)) { }
+
+    /*
+     * Returns the region on the given pyramid level. 
+     */
+    cv::Mat GetLevel(size_t level) const {
+        return crop == nullptr ? pyramid->GetLevel(level) : crop->GetLevel(level);
+    }
+};
+
+/*
+ * Cache for image pyramids of input images, keyed by image id. Color and 
+ * luma pyramids of the same image are cached separately. 
+ * Evicts least recently used pyramids when exceeding the byte budget, and
+ * drops pyramids as soon as their source image is unloaded.
+ *
+ * Thread safe.
+ */
+class PyramidCache {
+    private:
+    // Image id and luma flag. 
+    typedef std::pair<int, bool> Key;
+
+    struct Entry {
+        ImagePyramidP pyramid;
+        // Data pointer of the source image, for validation.
+        const uchar *source;
+        std::list<Key>::iterator lruPosition;
+    };
+
+    std::map<Key, Entry> entries;
+    // Most recently used at the front.
+    std::list<Key> lru;
+    size_t budget;
+    size_t used;
+    size_t unloadHook;
+    mutable std::mutex m;
+
+    void Remove(std::map<Key, Entry>::iterator it) {
+        used -= it->second.pyramid->GetByteSize();
+        lru.erase(it->second.lruPosition);
+        entries.erase(it);
+    }
+
+    void OnUnload(const Image &image) {
+        std::unique_lock<std::mutex> lock(m);
+
+        for(auto it = entries.begin(); it != entries.end();) {
+            auto current = it++;
+            if(current->second.source == image.data.data) {
+                Remove(current);
+            }
+        }
+    }
+
+    public:
+    /*
+     * Creates a new cache.
+     *
+     * @param budget Maximum memory used by all cached pyramid levels, in bytes.
+     */
+    PyramidCache(size_t budget = 64 * 1024 * 1024) : budget(budget), used(0) {
+        unloadHook = Image::AddUnloadHook([this] (const Image &image) {
+                    OnUnload(image);
+                });
+    }
+
+    ~PyramidCache() {
+        Image::RemoveUnloadHook(unloadHook);
+    }
+
+    PyramidCache(const PyramidCache&) = delete;
+    PyramidCache& operator=(const PyramidCache&) = delete;
+
+    /*
+     * Returns the pyramid of the given image, creating it if necessary.
+     * A cached pyramid is only re-used when it was created from
+     * the currently loaded image data.
+     *
+     * @param luma If true, the pyramid of the grayscale image is returned. 
+     *             The conversion is done once per image. 
+     */
+    ImagePyramidP Get(const InputImageP &image, bool luma = false) {
+        const cv::Mat &data = image->image.data;
+        AssertM(image->image.IsLoaded(), "Image is loaded");
+
+        const Key key(image->id, luma);
+
+        {
+            std::unique_lock<std::mutex> lock(m);
+
+            auto it = entries.find(key);
+
+            if(it != entries.end()) {
+                if(it->second.source == data.data &&
+                        it->second.pyramid->GetSize() == data.size()) {
+                    lru.splice(lru.begin(), lru, it->second.lruPosition);
+                    return it->second.pyramid;
+                }
+
+                // Image was re-loaded, pyramid is stale.
+                Remove(it);
+            }
+        }
+
+        // Convert outside of the lock, so other images are not blocked. 
+        auto pyramid = luma ? 
+            std::make_shared<ImagePyramid>(ToLuma(data), data.channels() != 1) : 
+            std::make_shared<ImagePyramid>(data);
+        size_t bytes = pyramid->GetByteSize();
+
+        std::unique_lock<std::mutex> lock(m);
+
+        auto it = entries.find(key);
+
+        if(it != entries.end()) {
+            // Another thread was faster. 
+            if(it->second.source == data.data) {
+                lru.splice(lru.begin(), lru, it->second.lruPosition);
+                return it->second.pyramid;
+            }
+            Remove(it);
+        }
+
+        while(used + bytes > budget && !lru.empty()) {
+            Remove(entries.find(lru.back()));
+        }
+
+        lru.push_front(key);
+        entries[key] = { pyramid, data.data, lru.begin() };
+        used += bytes;
+
+        return pyramid;
+    }
+
+    /*
+     * Returns a pyramid view for the given region. If the region is
+     * a sub-matrix of the image, the view is backed by the cached pyramid
+     * of the whole image, which shares the luma conversion and, for the whole 
+     * image, all levels. Otherwise (e.g. for warped regions) an uncached
+     * pyramid is created.
+     *
+     * @param luma If true, the view is backed by a grayscale pyramid. 
+     */
+    PyramidView GetView(const InputImageP &image, const cv::Mat &region, bool luma = false) {
+        const cv::Mat &data = image->image.data;
+
+        if(region.datastart != data.datastart || region.type() != data.type()) {
+            return PyramidView(luma ? ToLuma(region) : region);
+        }
+
+        cv::Size wholeSize;
+        cv::Point offset;
+        region.locateROI(wholeSize, offset);
+
+        if(wholeSize != data.size()) {
+            return PyramidView(luma ? ToLuma(region) : region);
+        }
+
+        return PyramidView(Get(image, luma), cv::Rect(offset, region.size()));
+    }
+
+    /*
+     * Removes all pyramids from the cache.
+     */
+    void Clear() {
+        std::unique_lock<std::mutex> lock(m);
+        entries.clear();
+        lru.clear();
+        used = 0;
+    }
+
+    /*
+     * Returns the memory used by cached pyramids, in bytes.
+     */
+    size_t GetUsedBytes() const {
+        std::unique_lock<std::mutex> lock(m);
+        return used;
+    }
+};
+}
+
+#endif
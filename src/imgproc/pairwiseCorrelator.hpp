@@ -4,7 +4,9 @@
 #include "../common/image.hpp"
 #include "../common/static_timer.hpp"
 #include "../common/drawing.hpp"
+#include "../common/threadPool.hpp"
 #include "../imgproc/planarCorrelator.hpp"
+#include "../imgproc/phaseCorrelationAligner.hpp"
 #include "../math/support.hpp"
 #include "../math/projection.hpp"
 #include "../math/stat.hpp"
@@ -71,6 +73,40 @@ public:
         correlationCoefficient(0) { }
 };
 
+/*
+ * Options for matching an image pair, see PairwiseCorrelator::Match. 
+ */
+struct MatchOptions {
+    /*
+     * Minimal width of the overlapping region. 
+     */
+    int minWidth;
+    /*
+     * Minimal height of the overlapping region. 
+     */
+    int minHeight;
+    /*
+     * If true, forces usage of the whole image, even if the overlapping area is smaller.
+     */
+    bool forceWholeImage;
+    /*
+     * Correlation window size, relative to the size of the image. 
+     */
+    float w;
+    /*
+     * Additional tolerance to apply when checking for out-of-window correlations. 
+     */
+    float wTolerance;
+
+    MatchOptions(int minWidth = 0, int minHeight = 0, bool forceWholeImage = false, 
+            float w = 0.5, float wTolerance = 1) : 
+        minWidth(minWidth), 
+        minHeight(minHeight), 
+        forceWholeImage(forceWholeImage), 
+        w(w), 
+        wTolerance(wTolerance) { }
+};
+
 /*
  * Class capable of correlating image pairs. 
  * Takes perspective into account. 
@@ -80,11 +116,81 @@ class PairwiseCorrelator {
 private:
     static const bool debug = false;
     /*
-     * Definition of the underlying planar aligner to use. 
+     * Definition of the underlying correlators to use. The integer metrics
+     * compute the same values as their float counterparts, but exactly and faster. 
      */
-    typedef PyramidPlanarAligner<NormedCorrelator<LeastSquares<Vec3b>>> Aligner;
+    typedef NormedCorrelator<LeastSquaresInt<Vec3b>> Correlator;
+    /*
+     * Correlator for luma (grayscale) images. 
+     */
+    typedef NormedCorrelator<LeastSquaresInt<uchar>> LumaCorrelator;
+
+    /*
+     * Aligns the given pyramids, using phase correlation if the SearchPhase flag is set. 
+     * Otherwise, the pyramid aligner is used, with the brute force aligner selected by the 
+     * SearchParallel and SearchBounded flags on each level. 
+     */
+    template <typename PixelCorrelator>
+    PlanarCorrelationResult Align(const PyramidView &pa, const PyramidView &pb, Mat &corr, double w) const {
+        if(flags & SearchPhase) {
+            return PhaseCorrelationPlanarAligner<PixelCorrelator>::Align(pa, pb, corr, w, w, 0);
+        } else if((flags & SearchParallel) && (flags & SearchBounded)) {
+            return PyramidPlanarAligner<PixelCorrelator, ParallelBruteForcePlanarAligner<PixelCorrelator, true>>::
+                Align(pa, pb, corr, w, w, 0);
+        } else if(flags & SearchParallel) {
+            return PyramidPlanarAligner<PixelCorrelator, ParallelBruteForcePlanarAligner<PixelCorrelator>>::
+                Align(pa, pb, corr, w, w, 0);
+        } else if(flags & SearchBounded) {
+            return PyramidPlanarAligner<PixelCorrelator, BoundedBruteForcePlanarAligner<PixelCorrelator>>::
+                Align(pa, pb, corr, w, w, 0);
+        } else {
+            return PyramidPlanarAligner<PixelCorrelator>::Align(pa, pb, corr, w, w, 0);
+        }
+    }
+
+    /*
+     * Combination of the Search* flags below. 
+     */
+    int flags;
+
+    /*
+     * Optional cache for image pyramids, shared between matches. 
+     */
+    std::shared_ptr<PyramidCache> pyramids;
 public:
-    PairwiseCorrelator() {
+    /*
+     * Search the offset window in parallel. Pays off for large windows. 
+     */
+    static const int SearchParallel = 1;
+    /*
+     * Stop evaluating an offset as soon as it can't beat the best one found so far. 
+     * The found offset is the same, but the variance estimate is slightly less exact. 
+     * Since the deviation of the top result is used for rejection, results
+     * can be rejected differently. Off by default. 
+     */
+    static const int SearchBounded = 2;
+    /*
+     * Correlate the luma (grayscale) channel only. The overlapping regions are 
+     * converted once, before building the pyramids. About three times less work 
+     * per offset, for a small loss of accuracy on colorful, low-contrast images. 
+     */
+    static const int SearchLuma = 4;
+    /*
+     * Find the offset using phase correlation instead of the pyramid aligner. 
+     * Runs in O(n log n) of the overlap size, independent of the window, so
+     * it pays off for large windows. SearchParallel and SearchBounded are ignored. 
+     */
+    static const int SearchPhase = 8;
+
+    /*
+     * Creates a new instance of this class. 
+     *
+     * @param flags Combination of the Search* flags. 
+     * @param pyramids Cache for image pyramids. If given, the pyramids of 
+     *                 whole images and cropped overlapping regions are re-used. 
+     */
+    PairwiseCorrelator(int flags = 0, std::shared_ptr<PyramidCache> pyramids = nullptr) : 
+        flags(flags), pyramids(pyramids) {
         AssertFalseInProduction(debug);
     }
 
@@ -174,7 +280,18 @@ public:
 
         Mat corr; //Debug image used to print the correlation result.  
 
-        PlanarCorrelationResult res = Aligner::Align(wa, wb, corr, w, w, 0);
+        const bool luma = (flags & SearchLuma) != 0;
+
+        PyramidView pa = pyramids != nullptr ? 
+            pyramids->GetView(a, wa, luma) : PyramidView(luma ? ToLuma(wa) : wa);
+        PyramidView pb = pyramids != nullptr ? 
+            pyramids->GetView(b, wb, luma) : PyramidView(luma ? ToLuma(wb) : wb);
+
+        cTimer.Tick("Getting pyramids");
+
+        PlanarCorrelationResult res = luma ? 
+            Align<LumaCorrelator>(pa, pb, corr, w) : 
+            Align<Correlator>(pa, pb, corr, w);
 
         cTimer.Tick("Finding Correlation");
 
@@ -220,6 +337,45 @@ public:
         return result;
     }
 
+    /*
+     * Matches two images, see above. 
+     */
+    CorrelationDiff Match(const InputImageP a, const InputImageP b, const MatchOptions &options) {
+        return Match(a, b, options.minWidth, options.minHeight, options.forceWholeImage, 
+                options.w, options.wTolerance);
+    }
+
+    /*
+     * Matches all given image pairs concurrently, using the default thread pool. 
+     * The overlapping regions are views into the images, so all pairs 
+     * containing the same image share its pyramid. If this correlator has no
+     * pyramid cache, a cache is created for the duration of the batch. 
+     *
+     * @param pairs The image pairs to match. 
+     * @param options The options used for all pairs. 
+     *
+     * @returns The correlation results, in the order of the given pairs. 
+     */
+    std::vector<CorrelationDiff> MatchBatch(const std::vector<std::pair<InputImageP, InputImageP>> &pairs, 
+            const MatchOptions &options = MatchOptions()) {
+        std::vector<CorrelationDiff> results(pairs.size());
+
+        if(pairs.size() == 1) {
+            results[0] = Match(pairs[0].first, pairs[0].second, options);
+            return results;
+        }
+
+        PairwiseCorrelator batch(flags, pyramids != nullptr ? 
+                pyramids : std::make_shared<PyramidCache>());
+
+        ThreadPool::Default().ParallelFor(0, (int)pairs.size(), 
+                [&batch, &pairs, &results, &options] (int i) {
+                    results[i] = batch.Match(pairs[i].first, pairs[i].second, options);
+                });
+
+        return results;
+    }
+
     static inline cv::Point2d GetAngularOffset(const InputImageP &a, const Point2d &pixelOffset) {
         // Get hFov and vFov in radians. 
         // Calculate pixel per radian (linar vs. asin/atan)
@@ -0,0 +1,229 @@
+#include <map>
+
+#include "../common/support.hpp"
+#include "../common/static_timer.hpp"
+#include "../common/assert.hpp"
+#include "planarCorrelator.hpp"
+
+#ifndef OPTONAUT_PHASE_CORRELATION_ALIGNER_HEADER
+#define OPTONAUT_PHASE_CORRELATION_ALIGNER_HEADER
+
+using namespace cv;
+using namespace std;
+
+namespace optonaut {
+
+/*
+ * Finds a position with maximum correlation by using phase
+ * correlation in the frequency domain. The peak of the phase correlation
+ * is refined with BruteForcePlanarAligner in a 3x3 window, until the best
+ * offset is in the center of the window. Cost and variance are the ones of this
+ * final window, like for the refinement steps of PyramidPlanarAligner.
+ *
+ * Runs in O(n log n) of the image size instead of O(window² * overlap).
+ *
+ * @tparam Correlator The correlator function to use for refinement.
+ */
+template <typename Correlator>
+class PhaseCorrelationPlanarAligner {
+    private:
+
+    /*
+     * Count of windows to keep per thread before the window cache is flushed.
+     */
+    static const size_t maxCachedWindows = 16;
+
+    /*
+     * Maximal count of brute force windows evaluated for refinement.
+     */
+    static const int maxRefinementSteps = 4;
+
+    /*
+     * Per-thread buffers, re-used as long as the DFT size does not change.
+     */
+    struct Workspace {
+        Mat gray;
+        Mat a;
+        Mat b;
+        Mat fa;
+        Mat fb;
+        Mat spectrum;
+        Mat response;
+    };
+
+    static inline Workspace &GetWorkspace() {
+        static thread_local Workspace workspace;
+        return workspace;
+    }
+
+    /*
+     * Returns a cached hanning window for the given image size.
+     */
+    static inline const Mat &GetWindow(const cv::Size &size) {
+        static thread_local std::map<std::pair<int, int>, Mat> windows;
+
+        auto key = std::make_pair(size.width, size.height);
+        auto it = windows.find(key);
+
+        if(it != windows.end()) {
+            return it->second;
+        }
+
+        if(windows.size() >= maxCachedWindows) {
+            windows.clear();
+        }
+
+        Mat &window = windows[key];
+        createHanningWindow(window, size, CV_32F);
+
+        return window;
+    }
+
+    /*
+     * Converts the image to a zero-mean, windowed grayscale float image,
+     * padded with zeros to the given DFT size.
+     */
+    static inline void Prepare(const Mat &in, Mat &out, const cv::Size &dftSize, Mat &gray) {
+        const Mat *src = &in;
+
+        if(in.channels() == 3) {
+            cvtColor(in, gray, COLOR_BGR2GRAY);
+            src = &gray;
+        }
+
+        out.create(dftSize, CV_32F);
+        out.setTo(Scalar::all(0));
+
+        Mat roi = out(cv::Rect(0, 0, in.cols, in.rows));
+        src->convertTo(roi, CV_32F);
+
+        roi -= mean(roi);
+        multiply(roi, GetWindow(in.size()), roi);
+    }
+
+    /*
+     * Normalizes the cross power spectrum to unit magnitude.
+     */
+    static inline void NormalizeSpectrum(Mat &spectrum) {
+        for(int y = 0; y < spectrum.rows; y++) {
+            Vec2f *row = spectrum.ptr<Vec2f>(y);
+            for(int x = 0; x < spectrum.cols; x++) {
+                float mag = sqrt(row[x][0] * row[x][0] + row[x][1] * row[x][1]);
+                if(mag > std::numeric_limits<float>::epsilon()) {
+                    row[x] /= mag;
+                } else {
+                    row[x] = Vec2f(0, 0);
+                }
+            }
+        }
+    }
+
+    public:
+
+    /*
+     * Alignes to given images.
+     *
+     * @param a The first image.
+     * @param b The second image.
+     * @param corr The correlation result, just for debugging purposes.
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction.
+     * @param dskip Ignored, for compatibility with PyramidPlanarAligner.
+     */
+    static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, double wx = 0.5, double wy = 0.5, int = 0) {
+        STimer cTimer(false);
+        AssertFalseInProduction(debugCorrelator);
+
+        Workspace &ws = GetWorkspace();
+
+        cv::Size dftSize(getOptimalDFTSize(max(a.cols, b.cols)),
+                getOptimalDFTSize(max(a.rows, b.rows)));
+
+        // Clamp the window, so that each offset maps to exactly one
+        // position in the (cyclic) phase correlation response.
+        int wxPx = min((int)(max(a.cols, b.cols) * wx), (dftSize.width - 1) / 2);
+        int wyPx = min((int)(max(a.rows, b.rows) * wy), (dftSize.height - 1) / 2);
+
+        Prepare(a, ws.a, dftSize, ws.gray);
+        Prepare(b, ws.b, dftSize, ws.gray);
+
+        dft(ws.a, ws.fa, DFT_COMPLEX_OUTPUT);
+        dft(ws.b, ws.fb, DFT_COMPLEX_OUTPUT);
+
+        // Cross power spectrum. The peak of the response is located at the
+        // offset of b relative to a.
+        mulSpectrums(ws.fb, ws.fa, ws.spectrum, 0, true);
+        NormalizeSpectrum(ws.spectrum);
+        idft(ws.spectrum, ws.response, DFT_REAL_OUTPUT | DFT_SCALE);
+
+        cTimer.Tick("Phase correlation");
+
+        if(debugCorrelator) {
+            corr = Mat(wyPx * 2 + 1, wxPx * 2 + 1, CV_32F);
+        }
+
+        // Find the peak inside our correlation window.
+        cv::Point peak(0, 0);
+        float maxResponse = -std::numeric_limits<float>::max();
+
+        for(int dy = -wyPx; dy <= wyPx; dy++) {
+            const float *row = ws.response.template ptr<float>((dy + dftSize.height) % dftSize.height);
+            for(int dx = -wxPx; dx <= wxPx; dx++) {
+                float res = row[(dx + dftSize.width) % dftSize.width];
+
+                if(debugCorrelator) {
+                    corr.at<float>(dy + wyPx, dx + wxPx) = -res;
+                }
+
+                if(res > maxResponse) {
+                    maxResponse = res;
+                    peak = cv::Point(dx, dy);
+                }
+            }
+        }
+
+        // Refine the peak. If the best offset is at the border of the window,
+        // the window is moved, so the result describes the chosen offset.
+        Mat corrBf;
+        cv::Point center = peak;
+        PlanarCorrelationResult res = BruteForcePlanarAligner<Correlator>::Align(
+                a, b, corrBf, 1, 1, center.x, center.y);
+
+        for(int i = 1; i < maxRefinementSteps && res.offset != center; i++) {
+            center = res.offset;
+            res = BruteForcePlanarAligner<Correlator>::Align(
+                    a, b, corrBf, 1, 1, center.x, center.y);
+        }
+
+        cTimer.Tick("Phase correlation refinement");
+
+        if(a.type() == CV_8UC3) {
+            res.gainA = NormedCorrelator<SumA<Vec3b>>::Calculate(a, b, res.offset.x, res.offset.y);
+            res.gainB = NormedCorrelator<SumA<Vec3b>>::Calculate(b, a, -res.offset.x, -res.offset.y);
+        } else {
+            res.gainA = NormedCorrelator<SumA<uchar>>::Calculate(a, b, res.offset.x, res.offset.y);
+            res.gainB = NormedCorrelator<SumA<uchar>>::Calculate(b, a, -res.offset.x, -res.offset.y);
+        }
+
+        res.topDeviation = sqrt(res.variance) / res.n;
+
+        return res;
+    }
+
+    /*
+     * Alignes to given images, for compatibility with PyramidPlanarAligner.
+     * Only the base level of the pyramids is used.
+     *
+     * @param pa The pyramid of the first image.
+     * @param pb The pyramid of the second image.
+     * @param corr The correlation result, just for debugging purposes.
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction.
+     * @param dskip Ignored.
+     */
+    static inline PlanarCorrelationResult Align(const PyramidView &pa, const PyramidView &pb, Mat &corr, double wx = 0.5, double wy = 0.5, int dskip = 0) {
+        return Align(pa.GetLevel(0), pb.GetLevel(0), corr, wx, wy, dskip);
+    }
+};
+}
+#endif
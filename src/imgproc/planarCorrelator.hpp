@@ -1,11 +1,16 @@
 #include <memory>
+#include <atomic>
+#include <type_traits>
 
 #include "../common/support.hpp"
 #include "../common/static_timer.hpp"
 #include "../common/drawing.hpp"
 #include "../math/stat.hpp"
 #include "../common/assert.hpp"
+#include "../common/threadPool.hpp"
 #include "../stitcher/simplePlaneStitcher.hpp"
+#include "correlatorKernels.hpp"
+#include "imagePyramid.hpp"
 
 #ifndef OPTONAUT_PLANAR_CORRELATOR_HEADER
 #define OPTONAUT_PLANAR_CORRELATOR_HEADER
@@ -16,6 +21,122 @@ using namespace std;
 
 namespace optonaut {
 
+/*
+ * Trait that marks error metrics which provide a whole-row
+ * implementation (CalculateRow) on top of the per-pixel one. 
+ */
+template <typename ErrorMetric>
+struct HasRowKernel {
+    static const bool value = false;
+};
+
+/*
+ * Sums up the error metric over the overlapping area, pixel by pixel. 
+ */
+template <typename ErrorMetric, bool rowKernel>
+struct CorrelationSum {
+    static inline float Calculate(const Mat &a, const Mat &b, int dx, int dy, int sx, int ex, int sy, int ey) {
+        float corr = 0;
+
+        // Lop over overlapping area and calculate correlation value. 
+        for(int y = sy; y < ey; y += CorrelatorSampleStep) {
+            for(int x = sx; x < ex; x += CorrelatorSampleStep) {
+                 corr += ErrorMetric::Calculate(a, b, x, y, x + dx, y + dy);
+            }
+        }
+
+        return corr;
+    }
+
+    /*
+     * Like Calculate, but stops after the first row for which the 
+     * sum exceeds the given bound. 
+     *
+     * @param rows Set to the count of rows that were summed up. 
+     */
+    static inline float CalculateBounded(const Mat &a, const Mat &b, int dx, int dy, int sx, int ex, int sy, int ey, float bound, int &rows) {
+        float corr = 0;
+        rows = 0;
+
+        for(int y = sy; y < ey && corr <= bound; y += CorrelatorSampleStep, rows++) {
+            for(int x = sx; x < ex; x += CorrelatorSampleStep) {
+                 corr += ErrorMetric::Calculate(a, b, x, y, x + dx, y + dy);
+            }
+        }
+
+        return corr;
+    }
+};
+
+/*
+ * Sums up the error metric over the overlapping area, row by row. 
+ * Each row span is handed to the vectorized row kernel of the metric. 
+ * Row kernels returning integers are accumulated exactly, in 64 bit. 
+ */
+template <typename ErrorMetric>
+struct CorrelationSum<ErrorMetric, true> {
+    typedef decltype(ErrorMetric::CalculateRow(nullptr, nullptr, 0)) RowValue;
+    typedef typename std::conditional<std::is_integral<RowValue>::value, 
+            int64_t, float>::type Accumulator;
+
+    static inline float Calculate(const Mat &a, const Mat &b, int dx, int dy, int sx, int ex, int sy, int ey) {
+        Accumulator corr = 0;
+
+        if(ex <= sx) {
+            return corr;
+        }
+
+        // Count of sampled pixels per row. 
+        const int n = (ex - sx + CorrelatorSampleStep - 1) / CorrelatorSampleStep;
+        const size_t pixelSize = a.elemSize();
+
+        for(int y = sy; y < ey; y += CorrelatorSampleStep) {
+            const uchar *ra = a.ptr<uchar>(y) + sx * pixelSize;
+            const uchar *rb = b.ptr<uchar>(y + dy) + (sx + dx) * pixelSize;
+            corr += ErrorMetric::CalculateRow(ra, rb, n);
+        }
+
+        return (float)corr;
+    }
+
+    /*
+     * Like Calculate, but stops after the first row for which the 
+     * sum exceeds the given bound. 
+     *
+     * @param rows Set to the count of rows that were summed up. 
+     */
+    static inline float CalculateBounded(const Mat &a, const Mat &b, int dx, int dy, int sx, int ex, int sy, int ey, float bound, int &rows) {
+        Accumulator corr = 0;
+        rows = 0;
+
+        if(ex <= sx) {
+            return (float)corr;
+        }
+
+        const int n = (ex - sx + CorrelatorSampleStep - 1) / CorrelatorSampleStep;
+        const size_t pixelSize = a.elemSize();
+
+        for(int y = sy; y < ey && corr <= bound; y += CorrelatorSampleStep, rows++) {
+            const uchar *ra = a.ptr<uchar>(y) + sx * pixelSize;
+            const uchar *rb = b.ptr<uchar>(y + dy) + (sx + dx) * pixelSize;
+            corr += ErrorMetric::CalculateRow(ra, rb, n);
+        }
+
+        return (float)corr;
+    }
+};
+
+/*
+ * Trait that marks error metrics that never return negative values
+ * and have a positive sign. For those metrics, the partial sum of a 
+ * correlation is a lower bound for the full sum, which allows
+ * early termination (branch and bound). 
+ */
+template <typename ErrorMetric>
+struct IsMonotoneMetric {
+    static const bool value = false;
+};
+
 /*
  * Base correlator. Just sums up the pixel-wise errors
  * for each overlapping region. 
@@ -41,13 +162,48 @@ class BaseCorrelator {
         int sy = max(0, -dy);
         int ey = min(a.rows, b.rows - dy);
 
-        float corr = 0;
+        float corr = CorrelationSum<ErrorMetric, HasRowKernel<ErrorMetric>::value>::
+            Calculate(a, b, dx, dy, sx, ex, sy, ey);
 
-        // Lop over overlapping area and calculate correlation value. 
-        for(int y = sy; y < ey; y += 3) {
-            for(int x = sx; x < ex; x += 3) {
-                 corr += ErrorMetric::Calculate(a, b, x, y, x + dx, y + dy);
-            }
+        return corr * ErrorMetric::Sign();
+    }
+
+    /*
+     * Calculates the correlation value, but abandons the calculation
+     * as soon as the partial value exceeds the given bound. If the calculation
+     * is abandoned, the partial value is extrapolated to the whole overlapping area, 
+     * which gives an estimate that is still larger than the bound. 
+     *
+     * Only available for monotone metrics. If not abandoned, the 
+     * result is equal to the result of Calculate. 
+     * 
+     * @param a The first image.
+     * @param b The second image.
+     * @param dx Offset in x direction.
+     * @param dy Offset in y direction. 
+     * @param bound The bound. 
+     * @param abandoned Set to true if the calculation was abandoned. 
+     */
+    static inline float CalculateBounded(const Mat &a, const Mat &b, int dx, int dy, float bound, bool &abandoned) {
+        static_assert(IsMonotoneMetric<ErrorMetric>::value, 
+                "Bounded correlation requires a monotone error metric");
+
+        int sx = max(0, -dx);
+        int ex = min(a.cols, b.cols - dx);
+        
+        int sy = max(0, -dy);
+        int ey = min(a.rows, b.rows - dy);
+
+        int rows = 0;
+        const int totalRows = max(0, (ey - sy + CorrelatorSampleStep - 1) / CorrelatorSampleStep);
+
+        float corr = CorrelationSum<ErrorMetric, HasRowKernel<ErrorMetric>::value>::
+            CalculateBounded(a, b, dx, dy, sx, ex, sy, ey, bound / ErrorMetric::Sign(), rows);
+
+        abandoned = rows < totalRows;
+
+        if(abandoned) {
+            corr = rows > 0 ? corr * totalRows / rows : std::numeric_limits<float>::max();
         }
 
         return corr * ErrorMetric::Sign();
@@ -81,6 +237,28 @@ class NormedCorrelator {
         // Divide by area. 
         return corr / ((ex - sx) * (ey - sy));
     }
+
+    /*
+     * Calculates the correlation value with early termination,
+     * see BaseCorrelator::CalculateBounded. 
+     */
+    static inline float CalculateBounded(const Mat &a, const Mat &b, int dx, int dy, float bound, bool &abandoned) {
+        float sx = max(0, -dx);
+        float ex = min(a.cols, b.cols - dx);
+        
+        float sy = max(0, -dy);
+        float ey = min(a.rows, b.rows - dy);
+
+        float area = (ex - sx) * (ey - sy);
+        const float boundMargin = 1e-5f;
+
+        // Scale the bound to the un-normed value. The small margin makes sure 
+        // rounding never abandons an offset whose normed value is within the bound. 
+        float corr = BaseCorrelator<ErrorMetric>::CalculateBounded(a, b, dx, dy, 
+                bound * area * (1 + boundMargin), abandoned);
+
+        return corr / area;
+    }
     static inline float Sign() {
         return 1;
     }
@@ -109,10 +287,8 @@ template <>
 class AbsoluteDifference<Vec3b> {
     public:
     static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
-        uchar *va = a.data + (ya * a.cols + xa) * 3;
-        uchar *vb = b.data + (yb * b.cols + xb) * 3;
-       // auto va = a.at<cv::Vec3b>(ya, xa);
-       // auto vb = b.at<cv::Vec3b>(yb, xb);
+        const uchar *va = a.ptr<uchar>(ya) + xa * 3;
+        const uchar *vb = b.ptr<uchar>(yb) + xb * 3;
 
         float db = (float)va[0] - (float)vb[0];
         float dr = (float)va[1] - (float)vb[1];
@@ -120,11 +296,19 @@ class AbsoluteDifference<Vec3b> {
                 
         return (std::abs(db) + std::abs(dr) + std::abs(dg)) / 3;
     }
+    static inline float CalculateRow(const uchar *a, const uchar *b, int n) {
+        return kernels::AbsoluteDifferenceBGR(a, b, n) / 3;
+    }
     static inline float Sign() {
         return 1;
     }
 };
 
+template <>
+struct HasRowKernel<AbsoluteDifference<Vec3b>> {
+    static const bool value = true;
+};
+
 /*
  * "Error" metric - signed gain. Used to calc gain on lowest level. 
  */
@@ -147,19 +331,27 @@ template <>
 class Gain<Vec3b> {
     public:
     static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
-        uchar *va = a.data + (ya * a.cols + xa) * 3;
-        uchar *vb = b.data + (yb * b.cols + xb) * 3;
+        const uchar *va = a.ptr<uchar>(ya) + xa * 3;
+        const uchar *vb = b.ptr<uchar>(yb) + xb * 3;
 
         float sa = va[0] + va[1] + va[2];
         float sb = vb[0] + vb[1] + vb[2];
                 
         return sa - sb;
     }
+    static inline float CalculateRow(const uchar *a, const uchar *b, int n) {
+        return (float)kernels::DifferenceBGR(a, b, n);
+    }
     static inline float Sign() {
         return 1.0f / 3.0f;
     }
 };
 
+template <>
+struct HasRowKernel<Gain<Vec3b>> {
+    static const bool value = true;
+};
+
 /*
  * "Error" metric - sum of a image pixels.  
  */
@@ -182,17 +374,25 @@ template <>
 class SumA<Vec3b> {
     public:
     static inline float Calculate(const Mat &a, const Mat&, int xa, int ya, int, int) {
-        uchar *va = a.data + (ya * a.cols + xa) * 3;
+        const uchar *va = a.ptr<uchar>(ya) + xa * 3;
 
         float sa = va[0] + va[1] + va[2];
                 
         return sa;
     }
+    static inline float CalculateRow(const uchar *a, const uchar*, int n) {
+        return (float)kernels::SumBGR(a, n);
+    }
     static inline float Sign() {
         return 1.0f / 3.0f;
     }
 };
 
+template <>
+struct HasRowKernel<SumA<Vec3b>> {
+    static const bool value = true;
+};
+
 /*
  * Error metric - squared difference of pixel values. 
  */
@@ -226,11 +426,165 @@ class LeastSquares<Vec3b> {
                 
         return (db * db + dr * dr + dg * dg) / (3 * 3);
     }
+    static inline float CalculateRow(const uchar *a, const uchar *b, int n) {
+        return kernels::SquaredDifferenceBGR(a, b, n) / (3 * 3);
+    }
+    static inline float Sign() {
+        return 1;
+    }
+};
+
+template <>
+struct HasRowKernel<LeastSquares<Vec3b>> {
+    static const bool value = true;
+};
+
+/*
+ * Error metric - absolute difference of pixel values, accumulated
+ * in integers. Only for 8-bit images. 
+ */
+template <typename T>
+class AbsoluteDifferenceInt {
+    public:
+    static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
+        return std::abs((int)a.at<T>(ya, xa) - (int)b.at<T>(yb, xb));
+    }
     static inline float Sign() {
         return 1;
     }
 };
 
+/*
+ * Error metric - absolute difference of pixel values, accumulated
+ * in integers. Implementation for grayscale images. 
+ */
+template <>
+class AbsoluteDifferenceInt<uchar> {
+    public:
+    static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
+        return std::abs((int)a.ptr<uchar>(ya)[xa] - (int)b.ptr<uchar>(yb)[xb]);
+    }
+    static inline int32_t CalculateRow(const uchar *a, const uchar *b, int n) {
+        return kernels::AbsoluteDifferenceGray(a, b, n);
+    }
+    static inline float Sign() {
+        return 1;
+    }
+};
+
+template <>
+struct HasRowKernel<AbsoluteDifferenceInt<uchar>> {
+    static const bool value = true;
+};
+
+/*
+ * Error metric - absolute difference of pixel values, accumulated
+ * in integers. Implementation for color images, scaled like AbsoluteDifference. 
+ */
+template <>
+class AbsoluteDifferenceInt<Vec3b> {
+    public:
+    static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
+        return kernels::scalar::AbsoluteDifferenceBGRInt(
+                a.ptr<uchar>(ya) + xa * 3, b.ptr<uchar>(yb) + xb * 3, 1);
+    }
+    static inline int32_t CalculateRow(const uchar *a, const uchar *b, int n) {
+        return kernels::AbsoluteDifferenceBGRInt(a, b, n);
+    }
+    static inline float Sign() {
+        return 1.0f / 3.0f;
+    }
+};
+
+template <>
+struct HasRowKernel<AbsoluteDifferenceInt<Vec3b>> {
+    static const bool value = true;
+};
+
+/*
+ * Error metric - squared difference of pixel values, accumulated
+ * in integers. Only for 8-bit images. 
+ */
+template <typename T>
+class LeastSquaresInt {
+    public:
+    static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
+        int diff = (int)a.at<T>(ya, xa) - (int)b.at<T>(yb, xb);
+        return diff * diff;
+    }
+    static inline float Sign() {
+        return 1;
+    }
+};
+
+/*
+ * Error metric - squared difference of pixel values, accumulated
+ * in integers. Implementation for grayscale images. 
+ */
+template <>
+class LeastSquaresInt<uchar> {
+    public:
+    static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
+        int diff = (int)a.ptr<uchar>(ya)[xa] - (int)b.ptr<uchar>(yb)[xb];
+        return diff * diff;
+    }
+    static inline int32_t CalculateRow(const uchar *a, const uchar *b, int n) {
+        return kernels::SquaredDifferenceGray(a, b, n);
+    }
+    static inline float Sign() {
+        return 1;
+    }
+};
+
+template <>
+struct HasRowKernel<LeastSquaresInt<uchar>> {
+    static const bool value = true;
+};
+
+/*
+ * Error metric - squared difference of pixel values, accumulated
+ * in integers. Implementation for color images, scaled like LeastSquares. 
+ */
+template <>
+class LeastSquaresInt<Vec3b> {
+    public:
+    static inline float Calculate(const Mat &a, const Mat &b, int xa, int ya, int xb, int yb) {
+        return kernels::scalar::SquaredDifferenceBGRInt(
+                a.ptr<uchar>(ya) + xa * 3, b.ptr<uchar>(yb) + xb * 3, 1);
+    }
+    static inline int32_t CalculateRow(const uchar *a, const uchar *b, int n) {
+        return kernels::SquaredDifferenceBGRInt(a, b, n);
+    }
+    static inline float Sign() {
+        return 1.0f / (3 * 3);
+    }
+};
+
+template <>
+struct HasRowKernel<LeastSquaresInt<Vec3b>> {
+    static const bool value = true;
+};
+
+template <typename T>
+struct IsMonotoneMetric<AbsoluteDifference<T>> {
+    static const bool value = true;
+};
+
+template <typename T>
+struct IsMonotoneMetric<LeastSquares<T>> {
+    static const bool value = true;
+};
+
+template <typename T>
+struct IsMonotoneMetric<AbsoluteDifferenceInt<T>> {
+    static const bool value = true;
+};
+
+template <typename T>
+struct IsMonotoneMetric<LeastSquaresInt<T>> {
+    static const bool value = true;
+};
+
 /*
  * Error metric - GemanMcClure metric. 
  */
@@ -323,6 +677,28 @@ struct PlanarCorrelationResult {
     double topDeviation;
 };
 
+/*
+ * Calls f(dx, dy) for all offsets in the given window, ordered 
+ * by distance from the center (rings of increasing size). 
+ */
+template <typename F>
+static inline void ForEachInSpiral(int wx, int wy, F f) {
+    for(int r = 0; r <= max(wx, wy); r++) {
+        for(int dx = max(-r, -wx); dx <= min(r, wx); dx++) {
+            if(abs(dx) == r) {
+                // Left or right edge of the ring, visit the whole column. 
+                for(int dy = max(-r, -wy); dy <= min(r, wy); dy++) {
+                    f(dx, dy);
+                }
+            } else if(r <= wy) {
+                // Top and bottom edge of the ring. 
+                f(dx, -r);
+                f(dx, r);
+            }
+        }
+    }
+}
+
 /*
  * Finds a position with maximum correlation 
  * by trying all the possible positions. 
@@ -358,6 +734,64 @@ class BruteForcePlanarAligner {
      * @param oy The predefined offset in y direction. 
      */
     static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, int wx, int wy, int ox, int oy) {
+        return Search(corr, wx, wy, ox, oy, [&a, &b, ox, oy] (int dx, int dy) {
+                    return Correlator::Calculate(a, b, dx + ox, dy + oy);
+                });
+    }
+
+    /*
+     * Alignes to given images, using early termination (branch and bound). 
+     * Offsets are evaluated in a spiral order around (ox, oy), and each correlation
+     * is abandoned as soon as it exceeds the best value found so far. 
+     *
+     * The resulting offset is equal to the one found by Align. For abandoned
+     * offsets, an extrapolated value is used to calculate cost and variance. 
+     *
+     * Only available for correlators using a monotone error metric. 
+     *
+     * @param a The first image.
+     * @param b The second image. 
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction. 
+     * @param ox The predefined offset in x direction.
+     * @param oy The predefined offset in y direction. 
+     */
+    static inline PlanarCorrelationResult AlignBounded(const Mat &a, const Mat &b, Mat &corr, int wx, int wy, int ox, int oy) {
+        const int rows = wy * 2 + 1;
+        vector<float> results((wx * 2 + 1) * rows);
+        float bound = std::numeric_limits<float>::max();
+
+        ForEachInSpiral(wx, wy, [&] (int dx, int dy) {
+                    bool abandoned;
+                    float res = Correlator::CalculateBounded(a, b, dx + ox, dy + oy, bound, abandoned);
+
+                    if(!abandoned && res < bound) {
+                        bound = res;
+                    }
+
+                    results[(dx + wx) * rows + dy + wy] = res;
+                });
+
+        // Reduce in the order of Align, so ties are resolved the same way. 
+        return Search(corr, wx, wy, ox, oy, [&results, wx, wy, rows] (int dx, int dy) {
+                    return results[(dx + wx) * rows + dy + wy];
+                });
+    }
+
+    /*
+     * Tries all offsets in the given window and reduces the results. 
+     *
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction. 
+     * @param ox The predefined offset in x direction.
+     * @param oy The predefined offset in y direction. 
+     * @param cost Function that returns the correlation value for an offset
+     *             relative to (ox, oy).
+     */
+    template <typename CostFunction>
+    static inline PlanarCorrelationResult Search(Mat &corr, int wx, int wy, int ox, int oy, CostFunction cost) {
         STimer cTimer(false);
 
         int mx = 0;
@@ -382,7 +816,7 @@ class BruteForcePlanarAligner {
             for(int dy = -wy; dy <= wy; dy++) {
                 
                 // Run correlation for each position. 
-                float res = Correlator::Calculate(a, b, dx + ox, dy + oy);
+                float res = cost(dx, dy);
 
                 // Collect results (add them to variance and cost caluclations) 
                 var.Push(res);
@@ -411,39 +845,206 @@ class BruteForcePlanarAligner {
     }
 };
 
+/*
+ * Brute force aligner that uses early termination, 
+ * see BruteForcePlanarAligner::AlignBounded. 
+ *
+ * @tparam Correlator The correlator function to use, 
+ */ 
+template <typename Correlator>
+class BoundedBruteForcePlanarAligner {
+    public:
+
+    /*
+     * Alignes to given images. 
+     *
+     * @param a The first image.
+     * @param b The second image. 
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction. 
+     */
+    static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, double wx = 0.5, double wy = 0.5) {
+        return Align(a, b, corr, max(a.cols, b.cols) * wx, max(a.rows, b.rows) * wy, 0, 0);
+    }
+    
+    /*
+     * Alignes to given images. 
+     *
+     * @param a The first image.
+     * @param b The second image. 
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction. 
+     * @param ox The predefined offset in x direction.
+     * @param oy The predefined offset in y direction. 
+     */
+    static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, int wx, int wy, int ox, int oy) {
+        return BruteForcePlanarAligner<Correlator>::AlignBounded(a, b, corr, wx, wy, ox, oy);
+    }
+};
+
+/*
+ * Finds a position with maximum correlation 
+ * by trying all the possible positions. The offsets are distributed 
+ * over the default thread pool. The results are reduced in the same order
+ * as in BruteForcePlanarAligner, so the result is bit-identical. 
+ *
+ * @tparam Correlator The correlator function to use, 
+ * @tparam bounded If true, use early termination. The bound is shared 
+ *                 between all workers. The resulting offset is still equal to 
+ *                 the serial one, but the extrapolated values of abandoned
+ *                 offsets depend on scheduling. 
+ */ 
+template <typename Correlator, bool bounded = false>
+class ParallelBruteForcePlanarAligner {
+    public:
+
+    /*
+     * Minimal count of sampled pixels times offsets for which the
+     * search is distributed. Smaller searches are executed serially. 
+     */
+    static const size_t minParallelWork = 1 << 18;
+
+    private:
+
+    typedef std::integral_constant<bool, bounded> IsBounded;
+
+    /*
+     * Serial fallback. 
+     */
+    static inline PlanarCorrelationResult AlignSerial(const Mat &a, const Mat &b, Mat &corr, int wx, int wy, int ox, int oy, std::false_type) {
+        return BruteForcePlanarAligner<Correlator>::Align(a, b, corr, wx, wy, ox, oy);
+    }
+
+    static inline PlanarCorrelationResult AlignSerial(const Mat &a, const Mat &b, Mat &corr, int wx, int wy, int ox, int oy, std::true_type) {
+        return BruteForcePlanarAligner<Correlator>::AlignBounded(a, b, corr, wx, wy, ox, oy);
+    }
+
+    /*
+     * Evaluates the i-th column of the window. 
+     */
+    static inline void Column(const Mat &a, const Mat &b, vector<float> &results, std::atomic<float> &, int i, int wx, int wy, int ox, int oy, int rows, std::false_type) {
+        const int dx = i - wx;
+        for(int dy = -wy; dy <= wy; dy++) {
+            results[i * rows + dy + wy] = 
+                Correlator::Calculate(a, b, dx + ox, dy + oy);
+        }
+    }
+
+    /*
+     * Evaluates the i-th column of the window with early termination. 
+     * Columns and rows are visited starting in the center, so we
+     * get a tight bound early. 
+     */
+    static inline void Column(const Mat &a, const Mat &b, vector<float> &results, std::atomic<float> &bound, int i, int wx, int wy, int ox, int oy, int rows, std::true_type) {
+        const int dx = (i % 2 == 0) ? -(i / 2) : (i + 1) / 2;
+
+        for(int j = 0; j < rows; j++) {
+            const int dy = (j % 2 == 0) ? -(j / 2) : (j + 1) / 2;
+
+            bool abandoned;
+            float res = Correlator::CalculateBounded(a, b, dx + ox, dy + oy, bound.load(), abandoned);
+
+            if(!abandoned) {
+                float current = bound.load();
+                while(res < current && !bound.compare_exchange_weak(current, res));
+            }
+
+            results[(dx + wx) * rows + dy + wy] = res;
+        }
+    }
+
+    public:
+
+    /*
+     * Alignes to given images. 
+     *
+     * @param a The first image.
+     * @param b The second image. 
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction. 
+     */
+    static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, double wx = 0.5, double wy = 0.5) {
+        return Align(a, b, corr, max(a.cols, b.cols) * wx, max(a.rows, b.rows) * wy, 0, 0);
+    }
+    
+    /*
+     * Alignes to given images. 
+     *
+     * @param a The first image.
+     * @param b The second image. 
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction. 
+     * @param ox The predefined offset in x direction.
+     * @param oy The predefined offset in y direction. 
+     */
+    static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, int wx, int wy, int ox, int oy) {
+        ThreadPool &pool = ThreadPool::Default();
+
+        const int cols = wx * 2 + 1;
+        const int rows = wy * 2 + 1;
+        const size_t samples = 
+            (a.cols / CorrelatorSampleStep + 1) * (a.rows / CorrelatorSampleStep + 1);
+
+        if(pool.Size() < 2 || samples * cols * rows < minParallelWork) {
+            return AlignSerial(a, b, corr, wx, wy, ox, oy, IsBounded());
+        }
+
+        STimer cTimer(false);
+
+        // Calculate all correlation values in parallel, one column
+        // of the window per task. 
+        vector<float> results(cols * rows);
+        std::atomic<float> bound(std::numeric_limits<float>::max());
+
+        pool.ParallelFor(0, cols, [&a, &b, &results, &bound, wx, wy, ox, oy, rows] (int i) {
+                    Column(a, b, results, bound, i, wx, wy, ox, oy, rows, IsBounded());
+                });
+
+        cTimer.Tick("Parallel BF correlator step");
+
+        // Reduce serially, in the order of the serial implementation. 
+        return BruteForcePlanarAligner<Correlator>::Search(corr, wx, wy, ox, oy, 
+                [&results, wx, wy, rows] (int dx, int dy) {
+                    return results[(dx + wx) * rows + dy + wy];
+                });
+    }
+};
+
 /*
  * Finds a position with maximum correlation 
  * by using a pyramid correlation scheme. Downsampled versions
  * of the image are compared first, to constrain the window. 
  *
  * @tparam Correlator The correlator function to use, 
+ * @tparam BruteForceAligner The aligner to use on each pyramid level.
  */ 
-template <typename Correlator>
+template <typename Correlator, typename BruteForceAligner = BruteForcePlanarAligner<Correlator>>
 class PyramidPlanarAligner {
     private:
 
     /*
      * Internal alignment function. Performs a recursive alignment step. 
      */
-    static inline cv::Point AlignInternal(const Mat &a, const Mat &b, Mat &corr, int &corrXOff, int corrYOff, double wx, double wy, int dskip, int depth, VariancePool<double> &pool, double &gainA, double &gainB) {
+    static inline cv::Point AlignInternal(const PyramidView &pa, const PyramidView &pb, Mat &corr, int &corrXOff, int corrYOff, double wx, double wy, int dskip, int depth, VariancePool<double> &pool, double &gainA, double &gainB) {
         const int minSize = 4;
 
         cv::Point res;
         AssertFalseInProduction(debugCorrelator);
 
+        const Mat a = pa.GetLevel(depth);
+        const Mat b = pb.GetLevel(depth);
+
         Log << "width: " << a.cols * wx << " height: " << a.rows * wy; 
 
         if(a.cols > minSize / wx && b.cols > minSize / wx
                 && a.rows > minSize / wy && b.rows > minSize / wy) {
             // If the image is large enough, perform a further pyramid alignment step. 
-            Mat ta, tb;
-
-            STimer cPyrDownTimer(false);
-            pyrDown(a, ta);
-            pyrDown(b, tb);
-            cPyrDownTimer.Tick("Aligner PyrDown");
-
-            cv::Point guess = PyramidPlanarAligner<Correlator>::AlignInternal(ta, tb, corr, corrXOff, corrYOff, wx, wy, dskip - 1, depth + 1, pool, gainA, gainB);
+            // The next level is created by the pyramid, if it was not cached. 
+            cv::Point guess = AlignInternal(pa, pb, corr, corrXOff, corrYOff, wx, wy, dskip - 1, depth + 1, pool, gainA, gainB);
 
             if(debugCorrelator) {
                 pyrUp(corr, corr);
@@ -458,7 +1059,7 @@ class PyramidPlanarAligner {
 
                 // Perform a brute force correlation, but just for a very small area. 
                 PlanarCorrelationResult detailedRes = 
-                    BruteForcePlanarAligner<Correlator>::Align(
+                    BruteForceAligner::Align(
                             a, b, corrBf, 1, 1, guess.x * 2, guess.y * 2);
 
                 if(debugCorrelator) {
@@ -495,11 +1096,17 @@ class PyramidPlanarAligner {
             // perform a brute-force correlation. 
             STimer cTimer(false);
             PlanarCorrelationResult detailedRes = 
-                BruteForcePlanarAligner<Correlator>::Align(a, b, corr, wx, wy);
+                BruteForceAligner::Align(a, b, corr, wx, wy);
 
             res = detailedRes.offset;
-            gainA = NormedCorrelator<SumA<Vec3b>>::Calculate(a, b, res.x, res.y);
-            gainB = NormedCorrelator<SumA<Vec3b>>::Calculate(b, a, res.x, res.y);
+
+            if(a.channels() == 3) {
+                gainA = NormedCorrelator<SumA<Vec3b>>::Calculate(a, b, res.x, res.y);
+                gainB = NormedCorrelator<SumA<Vec3b>>::Calculate(b, a, res.x, res.y);
+            } else {
+                gainA = NormedCorrelator<SumA<uchar>>::Calculate(a, b, res.x, res.y);
+                gainB = NormedCorrelator<SumA<uchar>>::Calculate(b, a, res.x, res.y);
+            }
             
             auto weight = pow(2, depth);
             pool.Push(detailedRes.variance, detailedRes.n * weight, 
@@ -522,6 +1129,20 @@ class PyramidPlanarAligner {
      * @param dskip Skips dskip correlation steps from the top.  
      */
     static inline PlanarCorrelationResult Align(const Mat &a, const Mat &b, Mat &corr, double wx = 0.5, double wy = 0.5, int dskip = 0) {
+        return Align(PyramidView(a), PyramidView(b), corr, wx, wy, dskip);
+    }
+
+    /*
+     * Alignes to given images, using precomputed (e.g. cached) pyramids. 
+     *
+     * @param pa The pyramid of the first image.
+     * @param pb The pyramid of the second image. 
+     * @param corr The correlation result, just for debugging purposes. 
+     * @param wx The correlation window in x direction.
+     * @param wy The correlation window in y direction.
+     * @param dskip Skips dskip correlation steps from the top.  
+     */
+    static inline PlanarCorrelationResult Align(const PyramidView &pa, const PyramidView &pb, Mat &corr, double wx = 0.5, double wy = 0.5, int dskip = 0) {
         VariancePool<double> pool;
         int corrXOff = 0;
         int corrYOff = 0;
@@ -530,7 +1151,7 @@ class PyramidPlanarAligner {
         double gainA = 0, gainB = 0;
 
         // Invoke the internal alignment operation.
-        cv::Point res = PyramidPlanarAligner<Correlator>::AlignInternal(a, b, corr, corrXOff, corrYOff, wx, wy, dskip, 0, pool, gainA, gainB);
+        cv::Point res = AlignInternal(pa, pb, corr, corrXOff, corrYOff, wx, wy, dskip, 0, pool, gainA, gainB);
 
         // Debug - draw the resulting image pair and correlation. 
         if(outputMatch) {
@@ -543,8 +1164,8 @@ class PyramidPlanarAligner {
             SimplePlaneStitcher stitcher;
 
             auto target = stitcher.Stitch(
-                    {std::make_shared<Image>(Image(a)), 
-                    std::make_shared<Image>(Image(b))}, 
+                    {std::make_shared<Image>(Image(pa.GetLevel(0))), 
+                    std::make_shared<Image>(Image(pb.GetLevel(0)))}, 
                     {res, cv::Point(0, 0)});
 
             //DrawMatchingResults(hom, eye, a, b, target);
@@ -0,0 +1,271 @@
+#include <vector>
+
+#include "../common/logger.hpp"
+#include "../common/assert.hpp"
+
+#include "cachingCheckpointStore.hpp"
+#include "io.hpp"
+
+using namespace std;
+using namespace cv;
+
+namespace optonaut {
+
+    /*
+     * Copies a stitching result, so it can be written after the original
+     * was changed or unloaded.
+     */
+    static StitchingResultP CreateSnapshot(const StitchingResultP &in) {
+        StitchingResultP out(new StitchingResult(*in));
+
+        // Copying an image takes the size from the data, which might be unloaded.
+        out->image.cols = in->image.cols;
+        out->image.rows = in->image.rows;
+        out->mask.cols = in->mask.cols;
+        out->mask.rows = in->mask.rows;
+
+        return out;
+    }
+
+    CachingCheckpointStore::CachingCheckpointStore(string basePath, string sharedPath,
+            size_t budget, string imageExtension) :
+        CheckpointStore(basePath, sharedPath, imageExtension), budget(budget), used(0),
+        isSpilling(false) {
+        loadHook = Image::AddLoadHook([this] (const string &source, int flags, Mat &data) {
+                    return Get(source, flags, data);
+                });
+    }
+
+    CachingCheckpointStore::~CachingCheckpointStore() {
+        // Waits for loads from the cache that are still running.
+        Image::RemoveLoadHook(loadHook);
+
+        unique_lock<mutex> lock(m);
+        WaitForSpilling(lock);
+    }
+
+    void CachingCheckpointStore::Remove(map<string, Entry>::iterator it) {
+        for(auto &image : it->second.images) {
+            sources.erase(image.first);
+        }
+        used -= it->second.bytes;
+        lru.erase(it->second.lruPosition);
+        entries.erase(it);
+    }
+
+    void CachingCheckpointStore::Put(const string &name, Entry entry, unique_lock<mutex> &lock) {
+        // Replaces older data of the same entry without writing it.
+        auto it = entries.find(name);
+        if(it != entries.end()) {
+            Remove(it);
+        }
+
+        entry.bytes = 0;
+        for(auto &image : entry.images) {
+            auto source = sources.find(image.first);
+            AssertM(source == sources.end() || spilling.find(source->second) != spilling.end(),
+                    "Source is cached only once");
+            sources[image.first] = name;
+            entry.bytes += image.second.total() * image.second.elemSize();
+        }
+
+        lru.push_front(name);
+        entry.lruPosition = lru.begin();
+        used += entry.bytes;
+        entries[name] = entry;
+
+        Shrink(lock);
+    }
+
+    void CachingCheckpointStore::Shrink(unique_lock<mutex> &lock) {
+        // The thread that is already spilling continues until the budget is met.
+        if(isSpilling) {
+            return;
+        }
+
+        while(used > budget && !lru.empty()) {
+            // Evicts entries. Entries that need to be written stay loadable
+            // until they are on disk.
+            vector<pair<string, function<void()>>> evicted;
+
+            while(used > budget && !lru.empty()) {
+                auto it = entries.find(lru.back());
+
+                if(it->second.spill) {
+                    used -= it->second.bytes;
+                    lru.erase(it->second.lruPosition);
+                    spilling[it->first] = it->second;
+                    evicted.emplace_back(it->first, it->second.spill);
+                    entries.erase(it);
+                } else {
+                    Remove(it);
+                }
+            }
+
+            if(evicted.empty()) {
+                break;
+            }
+
+            isSpilling = true;
+            lock.unlock();
+
+            for(auto &spill : evicted) {
+                Log << "Spilling " << spill.first;
+                spill.second();
+            }
+
+            lock.lock();
+            isSpilling = false;
+
+            for(auto &spill : evicted) {
+                const string &name = spill.first;
+                for(auto &image : spilling.at(name).images) {
+                    // Sources that were cached again in the meantime stay.
+                    auto source = sources.find(image.first);
+                    auto entry = entries.find(name);
+
+                    if(source != sources.end() && source->second == name &&
+                            (entry == entries.end() ||
+                             entry->second.images.find(image.first) == entry->second.images.end())) {
+                        sources.erase(source);
+                    }
+                }
+                spilling.erase(name);
+            }
+        }
+
+        spilled.notify_all();
+    }
+
+    void CachingCheckpointStore::WaitForSpilling(unique_lock<mutex> &lock) {
+        spilled.wait(lock, [this] { return !isSpilling; });
+    }
+
+    bool CachingCheckpointStore::Get(const string &source, int flags, Mat &data) {
+        Mat cached;
+        {
+            unique_lock<mutex> lock(m);
+
+            auto it = sources.find(source);
+            if(it == sources.end()) {
+                return false;
+            }
+
+            auto entry = entries.find(it->second);
+
+            if(entry != entries.end() && entry->second.images.find(source) != entry->second.images.end()) {
+                lru.splice(lru.begin(), lru, entry->second.lruPosition);
+                cached = entry->second.images.at(source);
+            } else {
+                cached = spilling.at(it->second).images.at(source);
+            }
+        }
+
+        data = ConvertToLoadFlags(cached, flags);
+        return true;
+    }
+
+    void CachingCheckpointStore::SaveRectifiedImage(InputImageP image) {
+        CheckpointStore::SaveRectifiedImage(image);
+
+        Entry entry;
+        entry.images[image->image.source] = image->image.data;
+
+        unique_lock<mutex> lock(m);
+        Put(image->image.source, entry, lock);
+    }
+
+    void CachingCheckpointStore::SaveRing(int ringId, StitchingResultP image) {
+        const string path = GetRingPath(ringId);
+        const string extension = GetImageExtension();
+
+        SetStitchingResultSources(image, path, extension);
+        StitchingResultP snapshot = CreateSnapshot(image);
+
+        Entry entry;
+        entry.images[image->image.source] = image->image.data;
+        entry.images[image->mask.source] = image->mask.data;
+        entry.spill = [snapshot, path, extension] () {
+            StitchingResultToFile(snapshot, path, extension);
+        };
+
+        unique_lock<mutex> lock(m);
+        Put(path, entry, lock);
+    }
+
+    void CachingCheckpointStore::SaveRingMask(int ringId, StitchingResultP image) {
+        const string path = GetRingPath(ringId);
+        const string extension = GetImageExtension();
+
+        // The image of the ring is usually unloaded at this point.
+        StitchingResultP snapshot = CreateSnapshot(image);
+        SetStitchingResultSources(snapshot, path, extension);
+        image->mask.source = snapshot->mask.source;
+
+        Entry entry;
+        entry.images[snapshot->mask.source] = image->mask.data;
+
+        unique_lock<mutex> lock(m);
+
+        bool maskOnly = true;
+        auto it = entries.find(path);
+
+        if(it != entries.end()) {
+            auto cached = it->second.images.find(snapshot->image.source);
+
+            if(cached != it->second.images.end()) {
+                entry.images[cached->first] = cached->second;
+
+                // If the ring was not spilled yet, the image has to be written, too.
+                if(it->second.spill) {
+                    snapshot->image.data = cached->second;
+                    maskOnly = false;
+                }
+            }
+        }
+
+        // If the ring is currently spilled, the image is written by the spilling
+        // thread, before the mask of this entry.
+        entry.spill = [snapshot, path, extension, maskOnly] () {
+            StitchingResultToFile(snapshot, path, extension, maskOnly);
+        };
+
+        Put(path, entry, lock);
+    }
+
+    void CachingCheckpointStore::Clear() {
+        {
+            unique_lock<mutex> lock(m);
+            WaitForSpilling(lock);
+            entries.clear();
+            sources.clear();
+            lru.clear();
+            used = 0;
+        }
+
+        CheckpointStore::Clear();
+    }
+
+    void CachingCheckpointStore::WriteBack() {
+        // Writes under the lock, so no entry is evicted while being written.
+        unique_lock<mutex> lock(m);
+        WaitForSpilling(lock);
+
+        for(auto &entry : entries) {
+            if(entry.second.spill) {
+                entry.second.spill();
+                entry.second.spill = nullptr;
+            }
+        }
+    }
+
+    bool CachingCheckpointStore::IsCached(const string &source) const {
+        unique_lock<mutex> lock(m);
+        return sources.find(source) != sources.end();
+    }
+
+    size_t CachingCheckpointStore::GetUsedBytes() const {
+        unique_lock<mutex> lock(m);
+        return used;
+    }
+}
@@ -0,0 +1,104 @@
+#include <string>
+#include <map>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "checkpointStore.hpp"
+
+#ifndef OPTONAUT_CACHING_CHECKPOINT_HEADER
+#define OPTONAUT_CACHING_CHECKPOINT_HEADER
+
+namespace optonaut {
+
+    /*
+     * Checkpoint store that keeps images, rings and ring masks in memory, up to
+     * a byte budget. When the budget is exceeded, the least recently used entries
+     * are spilled to the files of the underlying checkpoint store.
+     *
+     * Images unloaded by the stitcher stay cached, and loading them again
+     * returns the cached data without touching the disk. Loaded data shares memory
+     * with the cache, like the images of a store that does not support paging.
+     *
+     * Rectified images are written through, since they make up the recording. Rings
+     * and masks are only written when spilled. Rings that are still held in memory
+     * when the store is destroyed are lost, so resuming stitches them again.
+     *
+     * Thread safe. Spilled entries are written without holding the lock, so
+     * loading cached images is not blocked by disk writes.
+     */
+    class CachingCheckpointStore : public CheckpointStore {
+    private:
+        struct Entry {
+            // Data of all images in this entry, by source.
+            std::map<std::string, cv::Mat> images;
+            // Writes the entry to the files, or empty if it is written already.
+            std::function<void()> spill;
+            size_t bytes;
+            std::list<std::string>::iterator lruPosition;
+        };
+
+        std::map<std::string, Entry> entries;
+        // Evicted entries that are currently written. They can still be loaded.
+        std::map<std::string, Entry> spilling;
+        // Entry of each cached source, in entries or spilling.
+        std::map<std::string, std::string> sources;
+        // Most recently used at the front.
+        std::list<std::string> lru;
+        const size_t budget;
+        size_t used;
+        size_t loadHook;
+        // True while a thread writes spilled entries. Only one thread
+        // spills at a time, so files are written in order of eviction.
+        bool isSpilling;
+        std::condition_variable spilled;
+        mutable std::mutex m;
+
+        void Remove(std::map<std::string, Entry>::iterator it);
+        void Put(const std::string &name, Entry entry, std::unique_lock<std::mutex> &lock);
+        void Shrink(std::unique_lock<std::mutex> &lock);
+        void WaitForSpilling(std::unique_lock<std::mutex> &lock);
+        bool Get(const std::string &source, int flags, cv::Mat &data);
+
+    public:
+        /*
+         * @param budget Maximum memory used by all cached images, in bytes.
+         * @param imageExtension The format of spilled images. Mapped containers are
+         *                       cheap to write and to reload.
+         */
+        CachingCheckpointStore(std::string basePath, std::string sharedPath,
+                size_t budget = 512 * 1024 * 1024,
+                std::string imageExtension = MappedImageExtension);
+
+        virtual ~CachingCheckpointStore();
+
+        CachingCheckpointStore(const CachingCheckpointStore&) = delete;
+        CachingCheckpointStore& operator=(const CachingCheckpointStore&) = delete;
+
+        virtual void SaveRectifiedImage(InputImageP image);
+
+        virtual void SaveRing(int ringId, StitchingResultP image);
+        virtual void SaveRingMask(int ringId, StitchingResultP image);
+
+        virtual void Clear();
+
+        /*
+         * Writes all entries that are only held in memory, so the current state
+         * can be resumed. The entries stay cached.
+         */
+        void WriteBack();
+
+        /*
+         * Returns true if the data of the given source is held in memory.
+         */
+        bool IsCached(const std::string &source) const;
+
+        /*
+         * Returns the memory used by all cached images, in bytes.
+         */
+        size_t GetUsedBytes() const;
+    };
+}
+
+#endif
@@ -1,3 +1,5 @@
+#include <unordered_map>
+
 #include "../common/support.hpp"
 #include "../common/logger.hpp"
 
@@ -14,10 +16,40 @@ namespace optonaut {
     
     void CheckpointStore::SaveRectifiedImage(InputImageP image) {
         string path = rawImagesPath + ToString(image->id) + defaultExtension;
-        
-        InputImageToFile(image, path);
+
+        // Deep copies of the small matrices, which might be adjusted later. 
+        // The index is written from this metadata, so it matches the data file. 
+        InputImageP info(new InputImage(*image));
+        info->originalExtrinsics = image->originalExtrinsics.clone();
+        info->adjustedExtrinsics = image->adjustedExtrinsics.clone();
+        info->intrinsics = image->intrinsics.clone();
+        info->image = Image();
+        info->image.cols = image->image.cols;
+        info->image.rows = image->image.rows;
+        info->image.source = path;
+        savedImages[image->id] = info;
+
+        if(writer) {
+            // Shallow copy of the pixels, so the caller may unload the image. 
+            InputImageP snapshot(new InputImage(*info));
+            snapshot->image = image->image;
+
+            const Mat &data = snapshot->image.data;
+            writer->Push(data.total() * data.elemSize(), [snapshot, path] () {
+                InputImageToFile(snapshot, path);
+            });
+        } else {
+            InputImageToFile(image, path);
+        }
+
         image->image.source = path;
     }
+
+    void CheckpointStore::Flush() {
+        if(writer) {
+            writer->Flush();
+        }
+    }
     
     void CheckpointStore::SaveStitcherTemporaryImage(Image &image) {
         string path = stitcherDumpPath + ToString(c) + defaultExtension;
@@ -28,25 +60,54 @@ namespace optonaut {
     }
     
     void CheckpointStore::SaveStitcherInput(const vector<vector<InputImageP>> &rings, const std::map<size_t, double> &exposure) {
+        // The ring map marks a complete recording, so all images have to be written first. 
+        Flush();
+
+        // Index the metadata as it was written to the data files. 
+        vector<vector<InputImageP>> indexed;
+        for(auto &ring : rings) {
+            vector<InputImageP> indexedRing;
+            for(auto &image : ring) {
+                auto it = savedImages.find(image->id);
+                indexedRing.push_back(it != savedImages.end() ? it->second : image);
+            }
+            indexed.push_back(indexedRing);
+        }
+
+        SaveImageIndex(indexed, imageIndexPath);
         SaveRingMap(rings, ringMapPath);
         SaveExposureMap(exposure, exposureMapPath);
     }
     
     void CheckpointStore::LoadStitcherInput(vector<vector<InputImageP>> &rings, map<size_t, double> &exposure) {
 
+        Flush();
+
         Log << "Loading images from " << rawImagesPath;
 
         rings.clear();
-        vector<InputImageP> images = LoadAllImagesFromDirectory(rawImagesPath, defaultExtension);
+        vector<InputImageP> images;
+
+        if(FileExists(imageIndexPath)) {
+            images = LoadImageIndex(imageIndexPath, rawImagesPath);
+        } else {
+            // Recordings from before the index was introduced. 
+            images = LoadAllImagesFromDirectory(rawImagesPath, defaultExtension);
+        }
+
         vector<vector<size_t>> ringmap = LoadRingMap(ringMapPath);
+
+        unordered_map<size_t, InputImageP> imagesById;
+        for(auto &image : images) {
+            imagesById[(size_t)image->id] = image;
+        }
         
         for(auto &r : ringmap) {
             vector<InputImageP> ring;
             for(auto &id : r) {
-                for(auto &image : images) {
-                    if((size_t)image->id == id) {
-                        ring.push_back(image);
-                    }
+                auto it = imagesById.find(id);
+                if(it != imagesById.end()) {
+                    ring.push_back(it->second);
                 }
             }
             rings.push_back(ring);
@@ -65,25 +126,44 @@ namespace optonaut {
         }
     }
 
+    string CheckpointStore::GetRingPath(int ringId) const {
+        return ringPath + "ring_" + ToString(ringId);
+    }
+
     void CheckpointStore::SaveRing(int ringId, StitchingResultP image) {
-        StitchingResultToFile(image, ringPath + "ring_" + ToString(ringId), defaultExtension);
+        StitchingResultToFile(image, GetRingPath(ringId), defaultExtension);
     }
     
     void CheckpointStore::SaveRingMask(int ringId, StitchingResultP image) {
-        StitchingResultToFile(image, ringPath + "ring_" + ToString(ringId), defaultExtension, true);
+        StitchingResultToFile(image, GetRingPath(ringId), defaultExtension, true);
     }
     
     StitchingResultP CheckpointStore::LoadRing(int ringId) {
-        return StitchingResultFromFile(ringPath + "ring_" + ToString(ringId), defaultExtension);
+        return StitchingResultFromFile(GetRingPath(ringId), defaultExtension);
     }
     
     void CheckpointStore::SaveOptograph(StitchingResultP image) {
         Log << "Writing optograph of size " << image->image.size() << " to " << optographPath << "result";
-        StitchingResultToFile(image, optographPath + "result", defaultExtension);
+        StitchingResultToFile(image, optographPath + "result", exportExtension);
+
+        if(cubeFaceWidth > 0) {
+            Log << "Writing cube face tiles to " << optographPath << "cube/";
+            WriteCubeFaceTiles(image->image.data, optographPath + "cube/", 
+                    cubeFaceWidth, optographTileSize, exportExtension);
+        }
+    }
+
+    TilePyramidWriterP CheckpointStore::CreateOptographTileWriter(const Size &size) {
+        if(optographTileSize <= 0) {
+            return NULL;
+        }
+
+        return make_shared<TilePyramidWriter>(optographPath + "tiles/", 
+                size, optographTileSize, exportExtension);
     }
     
     StitchingResultP CheckpointStore::LoadOptograph() {
-        return StitchingResultFromFile(optographPath + "result", defaultExtension);
+        return StitchingResultFromFile(optographPath + "result", exportExtension);
     }
     
     void CheckpointStore::Clear() {
@@ -3,8 +3,11 @@
 #include <map>
 
 #include "../stitcher/stitchingResult.hpp"
+#include "../common/mappedImage.hpp"
+#include "../common/writeBehindQueue.hpp"
 
 #include "inputImage.hpp"
+#include "tilePyramidWriter.hpp"
 
 #ifndef OPTONAUT_CHECKPOINT_HEADER
 #define OPTONAUT_CHECKPOINT_HEADER
@@ -16,6 +19,11 @@ namespace optonaut {
      *
      * This is necassary for resuming interrupted calculations and for
      * saving memory. 
+     *
+     * Threading: A MultiRingStitcher with more than one concurrent ring calls
+     * LoadRing, SaveRing and SupportsPaging concurrently, for different ring ids. 
+     * Overrides of these methods have to be thread safe. All other methods are called 
+     * by one thread at a time. 
      */
     class CheckpointStore {
     private:
@@ -24,34 +32,114 @@ namespace optonaut {
         const std::string rawImagesPath;
         const std::string stitcherDumpPath;
         const std::string ringMapPath;
+        const std::string imageIndexPath;
         const std::string ringPath;
         const std::string optographPath;
         const std::string exposureMapPath;
-        const std::string defaultExtension = ".jpg";
+        const std::string defaultExtension;
+        const std::string exportExtension = ".jpg";
         const std::string ringAdjustmentPath;
         int c;
+        // Metadata of saved rectified images by id, as written to their data files. 
+        std::map<int, InputImageP> savedImages;
+        // Queue for writing rectified images in the background, if enabled. 
+        WriteBehindQueueP writer;
+        // Tile size of the optograph pyramid, or zero if disabled. 
+        int optographTileSize = 0;
+        // Width of cube faces written as tile pyramids, or zero if disabled. 
+        int cubeFaceWidth = 0;
+    protected:
+        /*
+         * Returns the path of a ring, without suffix and extension. 
+         */
+        std::string GetRingPath(int ringId) const;
+
+        /*
+         * Returns the format of intermediate images. 
+         */
+        const std::string &GetImageExtension() const {
+            return defaultExtension;
+        }
     public:
         
         static CheckpointStore* DebugStore;
         
-        CheckpointStore(std::string basePath, std::string sharedPath) :
+        /*
+         * @param imageExtension The format of intermediate images. The final
+         *                       optograph is always exported as JPEG. 
+         */
+        CheckpointStore(std::string basePath, std::string sharedPath, 
+                std::string imageExtension = ".jpg") :
             basePath(basePath),
             sharedPath(sharedPath),
             rawImagesPath(basePath + "raw_images/"),
             stitcherDumpPath(basePath + "dump/"),
             ringMapPath(basePath + "rings.json"),
+            imageIndexPath(basePath + "images.json"),
             ringPath(basePath + "rings/"),
             optographPath(basePath + "optograph/"),
             exposureMapPath(basePath + "exposure.json"),
+            defaultExtension(imageExtension),
             ringAdjustmentPath(sharedPath + "offsets.json"),
             c(0) { }
+
+        virtual ~CheckpointStore() { }
         
+        /*
+         * Saves a rectified image. The image source is set immediately. If write-behind
+         * is enabled, the image is written in the background and may only be reloaded 
+         * after Flush was called. The image may be unloaded right after saving. 
+         */
         virtual void SaveRectifiedImage(InputImageP image);
+
+        /*
+         * Writes rectified images in the background from now on. 
+         *
+         * @param writers The count of images encoded in parallel. 
+         * @param maxQueuedBytes The pixel data held by queued images. Saving blocks
+         *                       while the limit is exceeded. 
+         */
+        void EnableWriteBehind(size_t writers = 2, size_t maxQueuedBytes = 64 * 1024 * 1024) {
+            if(!writer) {
+                writer = std::make_shared<WriteBehindQueue>(writers, maxQueuedBytes);
+            }
+        }
+
+        /*
+         * Blocks until all images saved so far are written. 
+         */
+        virtual void Flush();
+
+        /*
+         * Additionally exports the optograph as tile pyramid. 
+         *
+         * @param tileSize The width and height of tiles. 
+         * @param cubeFaceWidth If positive, the six cube faces of this 
+         *                      width are exported as tile pyramids, too. 
+         */
+        void EnableOptographTiles(int tileSize = 512, int cubeFaceWidth = 0) {
+            optographTileSize = tileSize;
+            this->cubeFaceWidth = cubeFaceWidth;
+        }
+
+        /*
+         * Returns a writer for the tile pyramid of an optograph with
+         * the given size, or NULL if tiles are disabled. The stitcher pushes 
+         * rows as soon as they are blended. 
+         */
+        virtual TilePyramidWriterP CreateOptographTileWriter(const cv::Size &size);
         
         virtual void SaveStitcherTemporaryImage(Image &image);
         
+        /*
+         * Saves the ring map, the exposure and an index of all images. The index 
+         * holds the metadata of the images as they were saved as rectified images. 
+         */
         virtual void SaveStitcherInput(const std::vector<std::vector<InputImageP>> &rings, const std::map<size_t, double> &exposure);
         
+        /*
+         * Saves or loads a stitched ring. Called concurrently for different rings. 
+         */
         virtual void SaveRing(int ringId, StitchingResultP image);
         virtual void SaveRingMask(int ringId, StitchingResultP image);
         virtual StitchingResultP LoadRing(int ringId);
@@ -72,6 +160,17 @@ namespace optonaut {
         virtual bool SupportsPaging() { return true; }
     };
 
+    /*
+     * Checkpoint store that keeps intermediate images in uncompressed, 
+     * memory mapped containers. Loading an image maps the file instead of
+     * decoding it, which makes paging cheap. 
+     */
+    class MappedCheckpointStore : public CheckpointStore {
+        public:
+        MappedCheckpointStore(std::string basePath, std::string sharedPath) :
+            CheckpointStore(basePath, sharedPath, MappedImageExtension) { }
+    };
+
     /*
      * Checkpoint store that does nothing. 
      */
@@ -85,10 +184,12 @@ namespace optonaut {
         virtual void SaveRingMask(int, StitchingResultP) { }
         virtual StitchingResultP LoadRing(int) { return NULL; }
         virtual void SaveOptograph(StitchingResultP) { }
+        virtual TilePyramidWriterP CreateOptographTileWriter(const cv::Size &) { return NULL; }
         virtual StitchingResultP LoadOptograph() { return NULL; }
         virtual void LoadStitcherInput(std::vector<std::vector<InputImageP>> &, std::map<size_t, double> &) { }
         virtual void SaveRingAdjustment(const std::vector<int> &) { }
         virtual void LoadRingAdjustment(std::vector<int> &) { }
+        virtual void Flush() { }
         virtual void Clear() { }
         virtual bool HasUnstitchedRecording() { return false; }
         virtual bool HasData() { return false; }
@@ -109,9 +109,16 @@ namespace optonaut {
         
         Mat downscaled;
         
-        AssertM(image->IsLoaded(), "Image is loaded before downsampling");
-        
-        pyrDown(image->image.data, downscaled);
+        if(image->IsLoaded()) {
+            pyrDown(image->image.data, downscaled);
+        } else {
+            // Decode at reduced size, without loading the original. 
+            AssertM(image->image.source != "", "Image is loaded or has source before downsampling");
+            Image scaled;
+            scaled.source = image->image.source;
+            scaled.LoadScaled(1);
+            downscaled = scaled.data;
+        }
         
         clone->image = Image(downscaled);
         
@@ -116,7 +116,8 @@ namespace optonaut {
     typedef std::shared_ptr<InputImage> InputImageP;
    
     /* 
-     * Creates a downsampled copy. 
+     * Creates a copy, downsampled to half the size. If the image is not loaded, 
+     * the copy is decoded from the source at reduced size. 
      */ 
     InputImageP CloneAndDownsample(InputImageP image);
 
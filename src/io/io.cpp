@@ -17,8 +17,10 @@
 
 #include "../common/support.hpp"
 #include "../common/image.hpp"
+#include "../common/mappedImage.hpp"
 #include "../common/logger.hpp"
 #include "../common/assert.hpp"
+#include "../common/threadPool.hpp"
 #include "../stitcher/stitchingResult.hpp"
 
 #include "inputImage.hpp"
@@ -136,9 +138,20 @@ namespace optonaut {
         }
     }
     
+    /*
+     * Writes image data, choosing the format by the extension of the path. 
+     */
+    void WriteImageFile(const Mat &data, const string &path) {
+        if(IsMappedImagePath(path)) {
+            WriteMappedImage(data, path);
+        } else {
+            imwrite(path, data);
+        }
+    }
+    
     void SaveImage(Image &image, const std::string &path) {
         CreateDirectories(path);
-        imwrite(path, image.data);
+        WriteImageFile(image.data, path);
         image.source = path;
     }
 
@@ -203,11 +216,10 @@ namespace optonaut {
         fclose(fileRef);
     }
 
- 	void ParseInputImageInfoFile(const string &path, InputImageP result) {
-        Document doc;
-        
-        ReadJsonDocument(doc, path);
-        
+    /*
+     * Reads input image metadata from a json object. 
+     */
+    void ParseInputImageInfo(const Value &doc, InputImageP result) {
 		result->id = doc["id"].GetInt();
 		Assert(MatrixFromJson(doc["intrinsics"], result->intrinsics) == 3);
         if(doc.HasMember("originalExtrinsics")) {
@@ -225,14 +237,19 @@ namespace optonaut {
         }
 
         //Log << "Loading intrinsics" << result->intrinsics;
- 	}
-    
-    void WriteInputImageInfoFile(const string &path, InputImageP result) {
-        
-        CreateDirectories(path);
+    }
 
+ 	void ParseInputImageInfoFile(const string &path, InputImageP result) {
         Document doc;
-        Document::AllocatorType &allocator = doc.GetAllocator();
+        
+        ReadJsonDocument(doc, path);
+        ParseInputImageInfo(doc, result);
+ 	}
+    
+    /*
+     * Writes input image metadata to a json object. 
+     */
+    void WriteInputImageInfo(InputImageP result, Value &doc, Document::AllocatorType &allocator) {
         doc.SetObject();
         doc.AddMember("id", result->id, allocator);
         doc.AddMember("width", result->image.cols, allocator);
@@ -255,6 +272,14 @@ namespace optonaut {
                      originalExtrinsics,
                      allocator);
         doc.AddMember("originalExtrinsics", originalExtrinsics, allocator);
+    }
+
+    void WriteInputImageInfoFile(const string &path, InputImageP result) {
+        
+        CreateDirectories(path);
+
+        Document doc;
+        WriteInputImageInfo(result, doc, doc.GetAllocator());
 
         WriteJsonDocument(doc, path);
     }
@@ -294,7 +319,8 @@ namespace optonaut {
 	}
     
     string GetDataFilePath(const string &imagePath) {
-        AssertM(StringEndsWith(imagePath, ".jpg") || StringEndsWith(imagePath, ".bmp"), "File ending correct");
+        AssertM(StringEndsWith(imagePath, ".jpg") || StringEndsWith(imagePath, ".bmp") ||
+                StringEndsWith(imagePath, MappedImageExtension), "File ending correct");
         
         string pathWithoutExtensions = imagePath.substr(0, imagePath.length() - 4);
         string jsonPath = pathWithoutExtensions + ".json";
@@ -307,7 +333,7 @@ namespace optonaut {
         
         WriteInputImageInfoFile(jsonPath, image);
         
-        imwrite(path, image->image.data);
+        WriteImageFile(image->image.data, path);
     }
     
 
@@ -326,22 +352,27 @@ namespace optonaut {
 		return result;
     }
     
+    void SetStitchingResultSources(StitchingResultP image, const string &path, const string &extension, bool maskOnly) {
+        image->mask.source = path + ".mask" + extension;
+
+        if(!maskOnly) {
+            image->image.source = path + ".image" + extension;
+        }
+    }
+    
     void StitchingResultToFile(StitchingResultP image, const string &path, const string &extension, bool maskOnly) {
         
         Log << "Writing stitching result to " << path;
         
         string infoFilePath = path + ".data.json";
-        string imagePath = path + ".image" + extension;
-        string maskPath = path + ".mask" + extension;
         
         WriteStitchingResultInfoFile(infoFilePath, image);
+        SetStitchingResultSources(image, path, extension, maskOnly);
         
-        imwrite(maskPath, image->mask.data);
-        image->mask.source = maskPath;
+        WriteImageFile(image->mask.data, image->mask.source);
        
         if(!maskOnly) { 
-            imwrite(imagePath, image->image.data);
-            image->image.source = imagePath;
+            WriteImageFile(image->image.data, image->image.source);
         }
     }
     
@@ -350,8 +381,6 @@ namespace optonaut {
         Log << "Loading stitching result from " << path;
         
         string infoFilePath = path + ".data.json";
-        string imagePath = path + ".image" + extension;
-        string maskPath = path + ".mask" + extension;
         
         if(!FileExists(infoFilePath))
             return StitchingResultP(NULL);
@@ -365,8 +394,7 @@ namespace optonaut {
         res->mask = Image(Mat(0, 0, CV_8UC3));
         res->image.cols = width;
         res->image.rows = height;
-        res->image.source = imagePath;
-        res->mask.source = maskPath;
+        SetStitchingResultSources(res, path, extension, false);
         res->mask.cols = width;
         res->mask.rows = height;
 
@@ -538,7 +566,7 @@ namespace optonaut {
     }
         
     vector<InputImageP> LoadAllImagesFromDirectory(const string &path, const string &extension) {
-        vector<InputImageP> images;
+        vector<string> names;
         
         DIR *dir;
         struct dirent *ent;
@@ -547,7 +575,7 @@ namespace optonaut {
                 string name = ent->d_name;
                 
                 if(StringEndsWith(name, extension)) {
-                    images.push_back(InputImageFromFile(path + name, true));
+                    names.push_back(name);
                 }
                 
             }
@@ -556,7 +584,83 @@ namespace optonaut {
             //Could not open dir.
             AssertM(false, "Could not open dir: " + path);
         }
+
+        // Metadata files are independent, so parse them in parallel. 
+        vector<InputImageP> images(names.size());
+        ThreadPool::Default().ParallelFor(0, (int)names.size(), [&] (int i) {
+            images[i] = InputImageFromFile(path + names[i], true);
+        });
         
         return images;
     }
+
+    void SaveImageIndex(const vector<vector<InputImageP>> &rings, const string &path) {
+        Document doc;
+        Document::AllocatorType &allocator = doc.GetAllocator();
+        
+        Value jImages(kArrayType);
+        jImages.SetArray();
+
+        for(auto &ring : rings) {
+            for(auto &img : ring) {
+                AssertNEQM(img->image.source, string(""), "Indexed image has source");
+
+                Value jImage;
+                WriteInputImageInfo(img, jImage, allocator);
+
+                // Only the file name, so recordings can be moved. 
+                string file = GetFileName(img->image.source);
+                jImage.AddMember("file", Value(file.c_str(), allocator), allocator);
+
+                jImages.PushBack(jImage, allocator);
+            }
+        }
+        doc.SetObject();
+        doc.AddMember("images", jImages, allocator);
+
+        WriteJsonDocument(doc, path);
+    }
+
+    vector<InputImageP> LoadImageIndex(const string &path, const string &directory) {
+        Document doc;
+        ReadJsonDocument(doc, path);
+
+        const Value &jImages = doc["images"];
+        vector<InputImageP> images(jImages.Size());
+
+        ThreadPool::Default().ParallelFor(0, (int)jImages.Size(), [&] (int i) {
+            InputImageP image(new InputImage());
+            ParseInputImageInfo(jImages[i], image);
+            image->image.source = directory + jImages[i]["file"].GetString();
+            images[i] = image;
+        });
+
+        return images;
+    }
+
+    void SaveTilePyramidIndex(const vector<Size> &levels, int tileSize,
+            const string &extension, const string &path) {
+        Document doc;
+        Document::AllocatorType &allocator = doc.GetAllocator();
+
+        Value jLevels;
+        jLevels.SetArray();
+
+        for(auto &size : levels) {
+            Value jLevel;
+            jLevel.SetObject();
+            jLevel.AddMember("width", size.width, allocator);
+            jLevel.AddMember("height", size.height, allocator);
+            jLevel.AddMember("columns", (size.width + tileSize - 1) / tileSize, allocator);
+            jLevel.AddMember("rows", (size.height + tileSize - 1) / tileSize, allocator);
+            jLevels.PushBack(jLevel, allocator);
+        }
+
+        doc.SetObject();
+        doc.AddMember("tileSize", tileSize, allocator);
+        doc.AddMember("format", Value(extension.c_str(), allocator), allocator);
+        doc.AddMember("levels", jLevels, allocator);
+
+        WriteJsonDocument(doc, path);
+    }
 }
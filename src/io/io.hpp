@@ -68,6 +68,12 @@ namespace optonaut {
      */
     void StitchingResultToFile(StitchingResultP image, const std::string &path, const std::string &extension, bool maskOnly = false);
 
+    /*
+     * Sets the sources of a stitching result to the files written by 
+     * StitchingResultToFile, without writing anything. 
+     */
+    void SetStitchingResultSources(StitchingResultP image, const std::string &path, const std::string &extension, bool maskOnly = false);
+
     /*
      * Reads a file and parses file contents to T. 
      *
@@ -127,10 +133,34 @@ namespace optonaut {
     std::vector<std::vector<size_t>> LoadRingMap(const std::string &path);
 
     /*
-     * Loads all images from a directory. 
+     * Loads all images from a directory. Image data is loaded shallow. 
      */
     std::vector<InputImageP> LoadAllImagesFromDirectory(const std::string &path, const std::string &extension);
 
+    /*
+     * Saves the metadata of all images in the given rings to a single index file, 
+     * so the images can be restored without reading one data file per image. 
+     */
+    void SaveImageIndex(const std::vector<std::vector<InputImageP>> &rings, const std::string &path);
+
+    /*
+     * Loads all images from an index file. Image data is loaded shallow. 
+     *
+     * @param path The path of the index file. 
+     * @param directory The directory that contains the images. 
+     */
+    std::vector<InputImageP> LoadImageIndex(const std::string &path, const std::string &directory);
+
+    /*
+     * Saves the index of a tile pyramid. 
+     *
+     * @param levels The image size of each level, starting with full resolution. 
+     * @param tileSize The width and height of tiles. 
+     * @param extension The image format of tiles. 
+     */
+    void SaveTilePyramidIndex(const std::vector<cv::Size> &levels, int tileSize, 
+            const std::string &extension, const std::string &path);
+
     /*
      * Saves an image to a file. 
      */
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <string>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "../common/support.hpp"
+#include "../common/assert.hpp"
+#include "../common/threadPool.hpp"
+#include "../math/projection.hpp"
+
+#include "io.hpp"
+#include "tilePyramidWriter.hpp"
+
+using namespace std;
+using namespace cv;
+
+namespace optonaut {
+
+    TilePyramidWriter::TilePyramidWriter(const string &directory, const Size &size,
+            int tileSize, const string &extension) :
+        directory(directory), tileSize(tileSize), extension(extension) {
+
+        AssertGTM(tileSize, 0, "Tile size is positive");
+        AssertGTM(size.area(), 0, "Image is not empty");
+
+        Size levelSize = size;
+        while(true) {
+            levels.push_back({ levelSize, Mat(), 0, 0, 0, Mat() });
+
+            if(levelSize.width <= tileSize && levelSize.height <= tileSize) {
+                break;
+            }
+
+            levelSize = Size((levelSize.width + 1) / 2, (levelSize.height + 1) / 2);
+        }
+    }
+
+    void TilePyramidWriter::Push(const Mat &rows) {
+        PushLevel(0, rows);
+    }
+
+    bool TilePyramidWriter::IsComplete() const {
+        for(auto &level : levels) {
+            if(level.received != level.size.height) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void TilePyramidWriter::Finish() {
+        AssertM(IsComplete(), "All rows of the image were pushed");
+
+        vector<Size> sizes;
+        for(auto &level : levels) {
+            sizes.push_back(level.size);
+        }
+
+        SaveTilePyramidIndex(sizes, tileSize, extension, directory + "index.json");
+    }
+
+    string TilePyramidWriter::GetTilePath(size_t level, int row, int col) const {
+        return directory + ToString(level) + "/" + ToString(row) + "_" + ToString(col) + extension;
+    }
+
+    void TilePyramidWriter::Halve(const Mat &in, Mat &out) {
+        Mat even = in;
+
+        if(in.cols % 2 == 1 || in.rows % 2 == 1) {
+            copyMakeBorder(in, even, 0, in.rows % 2, 0, in.cols % 2, BORDER_REPLICATE);
+        }
+
+        // Area interpolation at exactly half the size averages 2x2 blocks.
+        resize(even, out, Size(even.cols / 2, even.rows / 2), 0, 0, INTER_AREA);
+    }
+
+    void TilePyramidWriter::PushLevel(size_t l, const Mat &rows) {
+        Level &level = levels[l];
+
+        AssertEQM(rows.cols, level.size.width, "Pushed rows have image width");
+        AssertGEM(level.size.height - level.received, rows.rows, "Pushed rows fit into image");
+
+        if(level.band.empty()) {
+            level.band = Mat(min(tileSize, level.size.height), level.size.width, rows.type());
+        }
+        AssertEQM(rows.type(), level.band.type(), "Pushed rows have image type");
+
+        for(int y = 0; y < rows.rows;) {
+            const int n = min(rows.rows - y, level.band.rows - level.bandRows);
+
+            rows.rowRange(y, y + n).copyTo(
+                    level.band.rowRange(level.bandRows, level.bandRows + n));
+
+            level.bandRows += n;
+            level.received += n;
+            y += n;
+
+            if(level.bandRows == level.band.rows || level.received == level.size.height) {
+                WriteBand(l);
+            }
+        }
+
+        if(l + 1 == levels.size()) {
+            return;
+        }
+
+        // Rows are downsampled in pairs. An odd row is kept until
+        // its partner arrives, or replicated at the bottom border.
+        Mat pending = rows;
+        if(!level.carry.empty()) {
+            vconcat(level.carry, rows, pending);
+            level.carry.release();
+        }
+
+        const bool last = level.received == level.size.height;
+        int paired = pending.rows;
+
+        if(pending.rows % 2 == 1 && !last) {
+            paired--;
+            level.carry = pending.row(paired).clone();
+        }
+
+        if(paired > 0) {
+            Mat halved;
+            Halve(pending.rowRange(0, paired), halved);
+            PushLevel(l + 1, halved);
+        }
+    }
+
+    void TilePyramidWriter::WriteBand(size_t l) {
+        Level &level = levels[l];
+
+        CreateDirectories(GetTilePath(l, 0, 0));
+
+        for(int x = 0; x < level.size.width; x += tileSize) {
+            const Rect tile(x, 0, min(tileSize, level.size.width - x), level.bandRows);
+            AssertM(imwrite(GetTilePath(l, level.tileRow, x / tileSize), level.band(tile)),
+                    "Able to write tile");
+        }
+
+        level.tileRow++;
+        level.bandRows = 0;
+    }
+
+    void WriteCubeFaceTiles(const Mat &optograph, const string &directory,
+            int faceWidth, int tileSize, const string &extension) {
+
+        ThreadPool::Default().ParallelFor(0, 6, [&] (int faceId) {
+            Mat face;
+            CreateCubeMapFace(optograph, face, faceId, faceWidth, faceWidth);
+
+            TilePyramidWriter writer(directory + "face_" + ToString(faceId) + "/",
+                    face.size(), tileSize, extension);
+            writer.Push(face);
+            writer.Finish();
+        });
+    }
+}
@@ -0,0 +1,100 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <opencv2/core.hpp>
+
+#ifndef OPTONAUT_TILE_PYRAMID_WRITER_HEADER
+#define OPTONAUT_TILE_PYRAMID_WRITER_HEADER
+
+namespace optonaut {
+
+    /*
+     * Writes an image as a pyramid of fixed-size tiles, so viewers can
+     * fetch only the region and resolution they display.
+     *
+     * Level 0 is the full resolution, each further level halves the size
+     * (rounding up), until the whole level fits into a single tile.
+     * Tiles are stored as [directory]/[level]/[row]_[column][extension], edge
+     * tiles are cropped to the image. An index.json in the directory
+     * describes all levels.
+     *
+     * The image is pushed row by row, top to bottom. Tiles are written as soon
+     * as a row of tiles is complete, so only one row of tiles per level is kept in memory.
+     */
+    class TilePyramidWriter {
+    private:
+        struct Level {
+            cv::Size size;
+            cv::Mat band;      // The current row of tiles.
+            int bandRows;      // Rows filled in band.
+            int tileRow;       // Index of the current row of tiles.
+            int received;      // Rows received for this level.
+            cv::Mat carry;     // Odd row that waits for its partner to be downsampled.
+        };
+
+        const std::string directory;
+        const int tileSize;
+        const std::string extension;
+        std::vector<Level> levels;
+
+        void PushLevel(size_t l, const cv::Mat &rows);
+        void WriteBand(size_t l);
+
+    public:
+        /*
+         * @param directory The output directory. Has to end with a slash.
+         * @param size The size of the full resolution image.
+         * @param tileSize The width and height of tiles.
+         * @param extension The image format of tiles.
+         */
+        TilePyramidWriter(const std::string &directory, const cv::Size &size,
+                int tileSize = 512, const std::string &extension = ".jpg");
+
+        /*
+         * Adds the next rows of the full resolution image.
+         */
+        void Push(const cv::Mat &rows);
+
+        /*
+         * Returns true if all rows of the image were pushed.
+         */
+        bool IsComplete() const;
+
+        /*
+         * Writes the index. All rows have to be pushed before.
+         */
+        void Finish();
+
+        size_t GetLevelCount() const {
+            return levels.size();
+        }
+
+        cv::Size GetLevelSize(size_t level) const {
+            return levels[level].size;
+        }
+
+        /*
+         * Returns the path of the tile in the given level, row and column.
+         */
+        std::string GetTilePath(size_t level, int row, int col) const;
+
+        /*
+         * Downsamples an image to half of its size, rounding up, by
+         * averaging 2x2 blocks. Odd borders are replicated.
+         */
+        static void Halve(const cv::Mat &in, cv::Mat &out);
+    };
+
+    typedef std::shared_ptr<TilePyramidWriter> TilePyramidWriterP;
+
+    /*
+     * Renders the six cube faces of an equirectangular optograph and writes
+     * each as a tile pyramid to [directory]face_[id]/.
+     *
+     * @param faceWidth The width and height of a face at full resolution.
+     */
+    void WriteCubeFaceTiles(const cv::Mat &optograph, const std::string &directory,
+            int faceWidth, int tileSize = 512, const std::string &extension = ".jpg");
+}
+
+#endif
@@ -34,23 +34,20 @@ namespace minimal {
 
             for(auto img : in) {
                 InputImageP copy(new InputImage());
-                bool loaded = false;
-
-                if(!img->image.IsLoaded()) {
-                    loaded = true;
-                    img->image.Load();
-                }
-
                 cv::Mat small;
 
-                pyrDown(img->image.data, small);
-
-                for(int i = 1; i < downsample; i++) {
-                    pyrDown(small, small);
-                }
+                if(!img->image.IsLoaded()) {
+                    // Decode at reduced size, without loading the original. 
+                    Image scaled;
+                    scaled.source = img->image.source;
+                    scaled.LoadScaled(downsample);
+                    small = scaled.data;
+                } else {
+                    pyrDown(img->image.data, small);
 
-                if(loaded) {
-                    img->image.Unload();
+                    for(int i = 1; i < downsample; i++) {
+                        pyrDown(small, small);
+                    }
                 }
 
                 copy->image = Image(small);
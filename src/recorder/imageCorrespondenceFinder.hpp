@@ -17,6 +17,7 @@ class ImageCorrespondenceFinder : public SelectionSink {
 
         AlignmentGraph alignment;
         ExposureCompensator exposure;
+        std::shared_ptr<PyramidCache> pyramids;
         PairwiseCorrelator matcher;
 
         Sink<std::vector<InputImageP>> &outSink;
@@ -32,13 +33,45 @@ class ImageCorrespondenceFinder : public SelectionSink {
         bool fullAlignmentOn;
         bool ringClosingOn;
 
-        void ComputeMatch(const SelectionInfo &a, const SelectionInfo &b, 
-                          int overlapArea) {
+        /*
+         * A pair of images that should be matched. 
+         */
+        struct MatchCandidate {
+            SelectionInfo a;
+            SelectionInfo b;
+            int overlapArea;
+        };
+
+        /*
+         * Matches all candidates concurrently, then inserts the results
+         * into the alignment and exposure graphs, in the order of the candidates. 
+         */
+        void ComputeMatches(const std::vector<MatchCandidate> &candidates) {
+            if(candidates.empty()) {
+                return;
+            }
+
             STimer timer;
+
+            std::vector<std::pair<InputImageP, InputImageP>> pairs;
+            for(auto &cand : candidates) {
+                pairs.emplace_back(cand.a.image, cand.b.image);
+            }
+
             //int minSize = min(a.image->image.cols, b.image->image.rows) / 3;
-            auto res = matcher.Match(a.image, b.image, 4, 4, false, 0.2, 1);
+            auto results = matcher.MatchBatch(pairs, MatchOptions(4, 4, false, 0.2, 1));
 
-            timer.Tick("Compute match");
+            timer.Tick("Compute matches");
+
+            for(size_t i = 0; i < candidates.size(); i++) {
+                ApplyMatch(candidates[i].a, candidates[i].b, 
+                        candidates[i].overlapArea, results[i]);
+            }
+        }
+
+        void ApplyMatch(const SelectionInfo &a, const SelectionInfo &b, 
+                          int overlapArea, const CorrelationDiff &res) {
+            STimer timer;
 
             Log << "B adj extrinsics: " << b.image->adjustedExtrinsics;
             Log << "A adj extrinsics: " << a.image->adjustedExtrinsics;
@@ -121,6 +154,8 @@ class ImageCorrespondenceFinder : public SelectionSink {
             bool focalLenAdjOn = true, 
             bool fullAlignmentOn = true,
             bool ringClosingOn = true) :
+        pyramids(std::make_shared<PyramidCache>()), 
+        matcher(PairwiseCorrelator::SearchLuma, pyramids), 
         outSink(outSink), graph(fullGraph),
         focalLenAdjustmentOn(focalLenAdjOn), 
         fullAlignmentOn(fullAlignmentOn),
@@ -151,6 +186,7 @@ class ImageCorrespondenceFinder : public SelectionSink {
             SelectionInfo infoCopy = info;
             infoCopy.image = miniCopy;
             // Now match with all possible images.
+            std::vector<MatchCandidate> candidates;
             
             for(auto cand : miniImages) {
                 auto roiCand = GetOuterRectangle(*warper, cand.image);
@@ -173,9 +209,11 @@ class ImageCorrespondenceFinder : public SelectionSink {
                 if(neighbors) {
                 //if(overlapArea > inCand.area() / 5.0f * 4.0f) {
                     //Log << "Points " << cand.closestPoint.localId << " and " << infoCopy.closestPoint.localId;
-                    ComputeMatch(infoCopy, cand, overlapArea);
+                    candidates.push_back({infoCopy, cand, overlapArea});
                 }
             } 
+
+            ComputeMatches(candidates);
             
             miniImages.push_back(infoCopy);
             largeImages.push_back(info);
@@ -195,6 +233,7 @@ class ImageCorrespondenceFinder : public SelectionSink {
             double error = 0; 
 
             miniImages.clear();
+            pyramids->Clear();
             vector<InputImageP> images;
             for(auto info : largeImages) {
                 images.push_back(info.image);
@@ -18,7 +18,7 @@ namespace optonaut {
          * offset to all images. The applied offset is interpolated depending on image position. 
          */
         static inline bool CloseRing(std::vector<InputImageP> ring) {
-            PairwiseCorrelator corr;
+            PairwiseCorrelator corr(PairwiseCorrelator::SearchParallel);
 
             const bool adjustExtrinsics = true;
             
@@ -10,11 +10,14 @@ namespace optonaut {
     /*
      * Implementation of StereoSink that saves recorder output to 
      * a checkpoint store (and thus usually to disk). 
+     *
+     * Images are written in the background, so the recorder does not
+     * wait for encoding. 
      */
     class StorageImageSink : public ImageSink {
 
     private:
-        CheckpointStore imageStore;
+        CheckpointStore &imageStore;
         std::vector<InputImageP> images;
     public:
         void Push(InputImageP image) {
@@ -25,18 +28,25 @@ namespace optonaut {
         }
 
         void Finish() {
+            imageStore.Flush();
             Log << "Finished";
         }
 
         void SaveInputSummary(const RecorderGraph& graph) {
             Log << "Saving input summary";
+            imageStore.Flush();
             const vector<vector<InputImageP>> rings = graph.SplitIntoRings(images);
             const map<size_t, double> dummy; 
             imageStore.SaveStitcherInput(rings, dummy) ;
         }
 
-        StorageImageSink(CheckpointStore &imageStore ) : 
+        /*
+         * @param imageStore The store to save images to. Write-behind is enabled on the store. 
+         * @param writers The count of images encoded in parallel. 
+         */
+        StorageImageSink(CheckpointStore &imageStore, size_t writers = 2) : 
             imageStore(imageStore){
+            imageStore.EnableWriteBehind(writers);
         }
 	};
 }
@@ -2,33 +2,136 @@
 #include <opencv2/opencv_modules.hpp>
 #include <opencv2/stitching.hpp>
 #include <vector>
+#include <limits>
 
 #include "../math/support.hpp"
-#include "../imgproc/planarCorrelator.hpp"
 #include "../common/support.hpp"
 #include "../common/static_timer.hpp"
 #include "dynamicSeamer.hpp"
-
-// Coordinate remap macros, so we can use the same code for vertical and horizontal seaming. 
-#define REMAPX(x,y)  (vertical ? x : y)
-#define REMAPY(x,y)  (vertical ? y : x)
+#include "seamerKernels.hpp"
 
 using namespace std;
 using namespace cv;
 
 namespace optonaut {
 
-int DynamicSeamer::debugId = 0;
+std::atomic<int> DynamicSeamer::debugId(0);
+
+/*
+ * Returns the given region of an image in seam space, that is
+ * transposed for horizontal seams. 
+ */
+template <bool vertical>
+static Mat ToSeamSpace(const Mat &image, const Rect &roi) {
+    if(vertical) {
+        return image(roi);
+    } else {
+        Mat transposed;
+        transpose(image(Rect(roi.y, roi.x, roi.height, roi.width)), transposed);
+        return transposed;
+    }
+}
+
+/*
+ * Calculates the inverse seam cost for the columns [lo[y], hi[y]) of each row.
+ * All other columns are set to minus infinity, so no path can pass them. 
+ */
+static void CalculateSeamCost(const Mat &a, const Mat &b, const Mat &ma, const Mat &mb,
+        const vector<int> &lo, const vector<int> &hi, Mat &invCost) {
+    invCost.create(a.size(), CV_32F);
+    invCost.setTo(Scalar::all(-numeric_limits<float>::infinity()));
+
+    for(int y = 0; y < a.rows; y++) {
+        kernels::SeamCostRow(a.ptr<uchar>(y) + lo[y] * 3, b.ptr<uchar>(y) + lo[y] * 3, 
+                ma.ptr<uchar>(y) + lo[y], mb.ptr<uchar>(y) + lo[y], 
+                invCost.ptr<float>(y) + lo[y], hi[y] - lo[y]);
+    }
+}
+
+/*
+ * Finds the path with the highest inverse cost from the top to the bottom row,
+ * within the columns [lo[y], hi[y]) of each row. Paths may move one column per row. 
+ *
+ * @param invCost The inverse cost. Accumulated in place. 
+ * @param seam The column of the path in each row. 
+ */
+static void SolveSeam(Mat &invCost, const vector<int> &lo, const vector<int> &hi,
+        int border, vector<int> &seam, int id, bool debug) {
+    const int rows = invCost.rows;
+    const int end = invCost.cols - border;
+
+    Mat path(invCost.size(), CV_8U);
+    
+    // Calculate all paths, from top to bottom.  
+    for(int y = 1; y < rows; y++) {
+        kernels::SeamPathRow(invCost.ptr<float>(y - 1), invCost.ptr<float>(y), 
+                path.ptr<uchar>(y), lo[y], hi[y], border, end);
+    }
+   
+    if(debug) { 
+       cout << "Writing path " << id << endl;
+       imwrite("dbg/" + ToString(id) + "_path.jpg", path * 100);
+    }
+    
+    // Start at the bottom, find the best bath.  
+    const float *last = invCost.ptr<float>(rows - 1);
+    int start = std::min(std::max(1 + border, lo[rows - 1]), hi[rows - 1] - 1);
+
+    for(int x = start + 1; x < hi[rows - 1]; x++) {
+        if(last[x] > last[start]) {
+            start = x;
+        }
+    }
+
+    seam.resize(rows);
+    seam[rows - 1] = start;
+
+    // Trace path from bottom to top. 
+    for(int y = rows - 1; y > 0; y--) {
+        seam[y - 1] = seam[y] + (int)path.at<uchar>(y, seam[y]) - 1;
+    }
+}
+
+/*
+ * Zeroes the columns [from[y], to[y]) of each row of a mask given 
+ * in seam space, starting at the given seam space row. 
+ */
+template <bool vertical>
+static void ClearMaskSpans(Mat &mask, int firstRow, int cols, 
+        const vector<int> &from, const vector<int> &to) {
+    const int rows = (int)from.size();
+
+    if(vertical) {
+        for(int y = 0; y < rows; y++) {
+            if(to[y] > from[y]) {
+                memset(mask.ptr<uchar>(firstRow + y) + from[y], 0, to[y] - from[y]);
+            }
+        }
+    } else {
+        // Spans are columns in image space. We clear them in 
+        // seam space, then transpose, so all writes are contiguous. 
+        Mat keep(rows, cols, CV_8U, Scalar::all(255));
+        for(int y = 0; y < rows; y++) {
+            if(to[y] > from[y]) {
+                memset(keep.ptr<uchar>(y) + from[y], 0, to[y] - from[y]);
+            }
+        }
+
+        Mat transposed;
+        transpose(keep, transposed);
+        Mat target = mask(Rect(firstRow, 0, rows, cols));
+        bitwise_and(target, transposed, target);
+    }
+}
 
 template <bool vertical>
 void DynamicSeamer::Find(Mat& imgA, Mat &imgB, Mat &maskA, Mat &maskB, 
-        const Point &tlAIn, const Point &tlBIn, int border, int overlap, int id)
+        const Point &tlAIn, const Point &tlBIn, int border, int overlap, int id, 
+        int downsample)
 {
     STimer seamTimer;
     static const bool debug = false;
     AssertFalseInProduction(debug);
-    static const bool assertsInLoopsOn = false;
-    AssertFalseInProduction(assertsInLoopsOn);
 
     Point tlA;
     Point tlB;
@@ -80,6 +183,8 @@ void DynamicSeamer::Find(Mat& imgA, Mat &imgB, Mat &maskA, Mat &maskB,
     Assert(imgA.rows == maskA.rows);
     Assert(imgB.rows == maskB.rows);
 
+    AssertGE(downsample, 1);
+
     //All coordinates in ROI top left
 
     //Top left corner of first image in ROI space
@@ -90,136 +195,92 @@ void DynamicSeamer::Find(Mat& imgA, Mat &imgB, Mat &maskA, Mat &maskB,
     int bToRoiX = tlB.x - roi.x;
     int bToRoiY = tlB.y - roi.y;
 
-    Mat invCost = Mat::zeros(roi.size(), CV_32F);
-    Mat path = Mat::zeros(roi.size(), CV_8U);
-
-    //Calculate weighting costs. 
-    for(int y = 0; y < roi.height; y++) {
-        for(int x = border; x < roi.width - border; x++) {
-            
-            int txA = x - aToRoiX;
-            int tyA = y - aToRoiY;
-            int txB = x - bToRoiX;
-            int tyB = y - bToRoiY;
-           
-            if(assertsInLoopsOn) { 
-                // ej: Made it possible to disable asserts in thight loops. They cost
-                // a lot of performance otherwise!
-                // Must be satisfied, or else we calculate ROI wrong. 
-                AssertGE(tyA, 0);
-                AssertGE(tyB, 0);
-                
-                Assert(tyA < arows && tyB < brows);
-                Assert(txA >= 0 && txB >= 0);
-                Assert(txA < acols && txB < bcols);
-            }
+    // Overlapping regions of both images and masks in seam space, 
+    // so all following passes work on contiguous rows. 
+    const Rect roiInA(-aToRoiX, -aToRoiY, roi.width, roi.height);
+    const Rect roiInB(-bToRoiX, -bToRoiY, roi.width, roi.height);
+    Mat a = ToSeamSpace<vertical>(imgA, roiInA);
+    Mat b = ToSeamSpace<vertical>(imgB, roiInB);
+    Mat ma = ToSeamSpace<vertical>(maskA, roiInA);
+    Mat mb = ToSeamSpace<vertical>(maskB, roiInB);
 
-            int xA = REMAPX(txA, tyA);
-            int yA = REMAPY(txA, tyA);
-            int xB = REMAPX(txB, tyB);
-            int yB = REMAPY(txB, tyB);
-
-            if(maskA.at<uchar>(yA, xA) == 0 ||
-               maskB.at<uchar>(yB, xB) == 0) {
-                invCost.at<uchar>(y, x) = 0;
-            } else {
-                invCost.at<float>(y, x) = 
-                    255 - sqrt(LeastSquares<cv::Vec3b>::Calculate(imgA, imgB, xA, yA, xB, yB));
-            }
-            path.at<uchar>(y, x) = 0;
+    const int rows = roi.height;
+    const int cols = roi.width;
+    vector<int> lo(rows, border), hi(rows, cols - border);
+    vector<int> seam;
+    Mat invCost;
+
+    const int coarseRows = rows / downsample;
+    const int coarseCols = cols / downsample;
+    const int coarseBorder = (border + downsample - 1) / downsample;
+
+    if(downsample > 1 && coarseRows > 1 && coarseCols > coarseBorder * 2) {
+        // Find the seam on a downsampled cost map first. Only 
+        // pixels that are completely inside both masks are valid. 
+        Mat sa, sb, sma, smb;
+        const Size coarseSize(coarseCols, coarseRows);
+        resize(a, sa, coarseSize, 0, 0, INTER_AREA);
+        resize(b, sb, coarseSize, 0, 0, INTER_AREA);
+        resize(ma, sma, coarseSize, 0, 0, INTER_AREA);
+        resize(mb, smb, coarseSize, 0, 0, INTER_AREA);
+        compare(sma, 255, sma, CMP_EQ);
+        compare(smb, 255, smb, CMP_EQ);
+
+        vector<int> coarseLo(coarseRows, coarseBorder), coarseHi(coarseRows, coarseCols - coarseBorder);
+        vector<int> coarseSeam;
+        CalculateSeamCost(sa, sb, sma, smb, coarseLo, coarseHi, invCost);
+        SolveSeam(invCost, coarseLo, coarseHi, coarseBorder, coarseSeam, id, false);
+
+        // Then refine it in a narrow band at full resolution. 
+        const int radius = 2 * downsample;
+        for(int y = 0; y < rows; y++) {
+            const int center = coarseSeam[std::min(y / downsample, coarseRows - 1)] * 
+                downsample + downsample / 2;
+            lo[y] = std::max(border, std::min(center - radius, cols - border - 1));
+            hi[y] = std::min(cols - border, std::max(center + radius + 1, lo[y] + 1));
         }
     }
 
+    CalculateSeamCost(a, b, ma, mb, lo, hi, invCost);
+
     if(debug) {
        cout << "Writing cost " << id << endl;
        imwrite("dbg/" + ToString(id) + "_cost_inv.jpg", invCost);
     }
-    
-    // Calculate all paths, from top to bottom.  
-    for(int y = 1; y < roi.height; y++) {
-        for(int x = border; x < roi.width - border; x++) {
-            int min = 0; 
-
-            for(int q = -1; q <= 1; q++) {
-                if(x + q < roi.width - border && x + q >= border) {
-                    if(invCost.at<float>(y - 1, x + q) >
-                       invCost.at<float>(y - 1, x + min)) {
-                        min = q;
-                    }
-                }
-            }
 
-            if(assertsInLoopsOn) {
-                AssertGE(min + x, border);
-                AssertGE(roi.width - border, min + x);
-            }
-            path.at<uchar>(y, x) = (min + 1);
-            invCost.at<float>(y, x) += invCost.at<float>(y - 1, x + min);
-        }
-    }
-   
-    if(debug) { 
-       cout << "Writing path " << id << endl;
-       imwrite("dbg/" + ToString(id) + "_path.jpg", path * 100);
-    }
-    
-    // Start at the bottom, find the best bath.  
-    int start = 1 + border;
-
-    for(int x = 1 + border; x < roi.width - border; x++) {
-        if(invCost.at<float>(roi.height - 1, x) > 
-           invCost.at<float>(roi.height - 1, start)) {
-            start = x;
-        }
-    }
+    SolveSeam(invCost, lo, hi, border, seam, id, debug);
 
-    //Trace path from bottom to top and update masks
-    Mat leftMask = maskA;
-    Mat rightMask = maskB;
-    auto leftToRoiX = aToRoiX;
-    auto rightToRoiX = bToRoiX;
-    auto leftCols = acols;
+    // Update masks along the path. 
+    int leftToRoiX = aToRoiX, leftToRoiY = aToRoiY, leftCols = acols;
+    int rightToRoiX = bToRoiX, rightToRoiY = bToRoiY, rightCols = bcols;
+    bool aIsLeft = true;
 
     if(tlA.x > tlB.x) {
-        std::swap(leftMask, rightMask);
         std::swap(leftToRoiX, rightToRoiX);
-        leftCols = bcols;
+        std::swap(leftToRoiY, rightToRoiY);
+        std::swap(leftCols, rightCols);
+        aIsLeft = false;
     }
-    
-    int x = start;
+
+    Mat &leftMask = aIsLeft ? maskA : maskB;
+    Mat &rightMask = aIsLeft ? maskB : maskA;
 
     if(debug) {
-        cout << "start: " << x << endl;
+        cout << "start: " << seam.back() << endl;
     }
 
-    for(int y = roi.height - 1; y >= 0; y--) {
-        for(int q = std::min<int>(x - leftToRoiX + 1 + overlap, leftCols); q < leftCols; q++) {
-            //Left mask is black right of path.
-            leftMask.at<uchar>(REMAPX(y, q), REMAPY(y, q)) = 0;
-        }
-        for(int q = 0; std::max<int>(q < x - rightToRoiX - overlap, 0); q++) {
-            //Right mask is black left of path
-            rightMask.at<uchar>(REMAPX(y, q), REMAPY(y, q)) = 0;
-        }
-            
-        //imgA.at<Vec3b>(remap(y - aToRoiY, x - aToRoiX)) = Vec3b(0, 0, 255);
-        //imgB.at<Vec3b>(remap(y - bToRoiY, x - bToRoiX)) = Vec3b(0, 0, 255);
-
-        if(y != 0) {
-            int dir = ((int)path.at<uchar>(y, x)) - 1;
-            
-            x += dir;
+    vector<int> leftFrom(rows), leftTo(rows, leftCols); 
+    vector<int> rightFrom(rows, 0), rightTo(rows);
 
-            if(debug) {
-                cout << "x: " << x << endl;
-            }
+    for(int y = 0; y < rows; y++) {
+        //Left mask is black right of path.
+        leftFrom[y] = std::min<int>(seam[y] - leftToRoiX + 1 + overlap, leftCols);
+        //Right mask is black left of path
+        rightTo[y] = std::min<int>(std::max<int>(seam[y] - rightToRoiX - overlap, 0), rightCols);
+    }
 
-            if(assertsInLoopsOn) {
-                AssertGE(x, border);
-                AssertGE(roi.width - border, x);
-            }
-        }   
-    }   
+    ClearMaskSpans<vertical>(leftMask, -leftToRoiY, leftCols, leftFrom, leftTo);
+    ClearMaskSpans<vertical>(rightMask, -rightToRoiY, rightCols, rightFrom, rightTo);
    
     if(debug) { 
         imwrite("dbg/" + ToString(id) + "_ma.jpg", maskA);
@@ -228,7 +289,7 @@ void DynamicSeamer::Find(Mat& imgA, Mat &imgB, Mat &maskA, Mat &maskB,
     seamTimer.Tick("Image Seamed");
 }
 template void DynamicSeamer::Find<true>(Mat& imgA, Mat &imgB, Mat &maskA, Mat &maskB, 
-        const Point &tlAIn, const Point &tlBIn, int border, int overlap, int id);
+        const Point &tlAIn, const Point &tlBIn, int border, int overlap, int id, int downsample);
 template void DynamicSeamer::Find<false>(Mat& imgA, Mat &imgB, Mat &maskA, 
-        Mat &maskB, const Point &tlAIn, const Point &tlBIn, int border, int overlap, int id);
+        Mat &maskB, const Point &tlAIn, const Point &tlBIn, int border, int overlap, int id, int downsample);
 }
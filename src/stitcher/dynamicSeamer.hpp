@@ -1,4 +1,5 @@
 
+#include <atomic>
 #include <opencv2/core.hpp>
 #include "stitchingResult.hpp"
 
@@ -17,7 +18,7 @@ namespace optonaut {
 class DynamicSeamer 
 {
 private:
-    static int debugId;
+    static std::atomic<int> debugId;
 public:
     /*
      * Finds a min-cost cut between imageA and imabeB and updates maskA and maskB accordingly.
@@ -32,9 +33,11 @@ public:
      * @param border Margin to keen unused between the image border and the cut. 
      * @param overlap Thickness of the seam area, that is the margin that is added to the left and the right of the seam, so the images overlap. 
      * @param id Image id. Used for debugging. 
+     * @param downsample If larger than one, the cut is first found on images downsampled by this factor,
+     *                   then refined at full resolution in a narrow band around it. 
      */
     template <bool vertical>
-    static void Find(Mat& imageA, Mat &imageB, Mat &maskA, Mat &maskB, const Point &tlA, const Point &tlB, int border, int overlap, int id);
+    static void Find(Mat& imageA, Mat &imageB, Mat &maskA, Mat &maskB, const Point &tlA, const Point &tlB, int border, int overlap, int id, int downsample = 1);
 
     /*
      * Invokes seam finding for a pair of stitching results. 
@@ -13,6 +13,9 @@ using namespace std;
 
 static const bool debug = false;
 
+// Count of rows that are remapped and blended at once. 
+static const int blendTileRows = 16;
+
 namespace optonaut {
 
     void FlowBlender::Prepare(const Rect &roi) {
@@ -36,7 +39,8 @@ namespace optonaut {
 
         Rect overlap = aRoi & bRoi;
 
-        flow = Mat(b.size(), CV_32FC2, Scalar::all(0.f));
+        flow = pool.Create(b.size(), CV_32FC2);
+        flow.setTo(Scalar::all(0.f));
 
         if(overlap.width == 0 || overlap.height == 0)
             return;
@@ -54,12 +58,13 @@ namespace optonaut {
             Mat _flow = flow(bOverlap);
 
             if(reCalcOffset) { 
-                typedef PyramidPlanarAligner<
-                    NormedCorrelator<LeastSquares<Vec3b>>
-                > AlignerToUse;
+                typedef NormedCorrelator<LeastSquares<Vec3b>> CorrelatorToUse;
 
                 Mat corr; //Debug image used to print the correlation result.  
-                PlanarCorrelationResult result = AlignerToUse::Align(
+                PlanarCorrelationResult result = offsetSearch == OffsetSearch::PhaseCorrelation ? 
+                    PhaseCorrelationPlanarAligner<CorrelatorToUse>::Align(
+                        aOverlapImg, bOverlapImg, corr, 0.2, 0.01, 0) : 
+                    PyramidPlanarAligner<CorrelatorToUse>::Align(
                         aOverlapImg, bOverlapImg, corr, 0.2, 0.01, 0);
 
                 offset = result.offset;
@@ -88,26 +93,16 @@ namespace optonaut {
 
             _flow = _flow(overlapAreaB);
 
-            UMat ig, dg;
+            Mat dg = pool.Create(aOverlapImg.size(), CV_8U);
+            Mat ig = pool.Create(bOverlapImg.size(), CV_8U);
 
             cvtColor(aOverlapImg, dg, COLOR_BGR2GRAY);
             cvtColor(bOverlapImg, ig, COLOR_BGR2GRAY);
 
-            //pyrDown(dg, dg);
-            //pyrDown(ig, ig);
-           
-            UMat tmp(dg.size(), CV_32FC2);    
-
-            calcOpticalFlowFarneback(dg, ig, tmp, 
-                    0.5, // Pyr Scale
-                    1, // Levels
-                    5, // Winsize
-                    4, // Iterations
-                    5, // Poly N 
-                    1.1, // Poly Sigma
-                    0); // Flags
-
-            //pyrUp(tmp, tmp);
+            Mat tmp = pool.Create(dg.size(), CV_32FC2);    
+
+            flowEngine->Calculate(dg, ig, tmp);
+
             tmp.copyTo(_flow);
                 
             if(debug) {
@@ -135,6 +130,35 @@ namespace optonaut {
     }
 
 
+    /*
+     * Returns the bounding box of all non-zero pixels of the given mask. 
+     */
+    static Rect NonZeroBounds(const Mat &mask) {
+        int minX = mask.cols, maxX = -1, minY = mask.rows, maxY = -1;
+
+        for(int y = 0; y < mask.rows; y++) {
+            const uchar* row = mask.ptr(y);
+            int x0 = 0, x1 = mask.cols - 1;
+
+            while(x0 < mask.cols && row[x0] == 0) x0++;
+
+            if(x0 == mask.cols)
+                continue;
+
+            while(row[x1] == 0) x1--;
+
+            minX = std::min(minX, x0);
+            maxX = std::max(maxX, x1);
+            minY = std::min(minY, y);
+            maxY = y;
+        }
+
+        if(maxY < 0)
+            return Rect(0, 0, 0, 0);
+
+        return Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+    }
+
     float neon_clamp ( float val, float minval, float maxval )
     {
         // Branchless NEON clamp.
@@ -146,11 +170,12 @@ namespace optonaut {
     {
         AssertEQ(img.type(), CV_8UC3);
         AssertEQ(flow.type(), CV_32FC2);
+        AssertEQ(flow.size(), img.size());
 
         STimer t;
         static int dbgCtr = 0;
 
-        Mat wmDest(img.size(), CV_32F, Scalar::all(0));
+        Mat wmDest = pool.Create(img.size(), CV_32F);
 
         const Rect sourceRoi(tl - destRoi.tl(), img.size());
         
@@ -190,98 +215,141 @@ namespace optonaut {
             imwrite("dbg/" + ToString(dbgCtr) + "_dest_mask_full.jpg", destMask);
         } 
 
-        Mat temp(img.size(), CV_8UC3);
-
         int w = img.cols;
         int h = img.rows;
         int dw = dest.cols;
         int dh = dest.rows;
 
-        Mat imgMapX(w, h, CV_32F);
-        Mat imgMapY(w, h, CV_32F);
-        Mat zero(w, h, CV_32F, Scalar(0.f));
-        
-        Mat destMapX(w, h, CV_32F);
-        Mat destMapY(w, h, CV_32F);
-
-        // The following code block converts
-        // the flow image to a map for remapping 
-        // using raw pointers. 
-        float* pImgMapX = (float*)imgMapX.ptr();
-        float* pImgMapY = (float*)imgMapY.ptr();
-        float* pDestMapX = (float*)destMapX.ptr();
-        float* pDestMapY = (float*)destMapY.ptr();
-        float* pFlow = (float*)flow.ptr();
-        float* pwmDest = (float*)wmDest.ptr();
-        
-        for (int y = 0; y < h; ++y)
-        {
-            for (int x = 0; x < w; ++x)
-            {
-               
-                float wcd = *pwmDest++;
-                float wcs = 1.f - wcd;
-
-                // Convert flow to remap representation.
-                // Also add weights in one go. 
-                // Translation of source position is proportional
-                // to dest weight and vice-versa. 
-                float imgDx = x + *pFlow * wcd;
-                float destDx = dx + x - *pFlow++ * wcs;
-                float imgDy = y + *pFlow * wcd;
-                float destDy = dy + y - *pFlow++ * wcs;
-
-                // Check mapping - if out-of-bounds we use Identity mapping
-                // Todo: Might want to check mask
-                imgDx = imgDx < 0 || imgDx >= w ? x : imgDx;
-                imgDy = imgDy < 0 || imgDy >= h ? y : imgDy;
-
-                destDx = destDx < 0 || destDx >= dw ? x : destDx;
-                destDy = destDy < 0 || destDy >= dh ? y : destDy;
-
-                *pImgMapX++ = imgDx;
-                *pImgMapY++ = imgDy;
-                *pDestMapX++ = destDx;
-                *pDestMapY++ = destDy;
-            }
+        // The destination is only sampled where its weight is non-zero, 
+        // that is inside the existing mask. Since we blend directly into dest, 
+        // we sample from a copy of the region reachable from there. 
+        const Rect overlap = NonZeroBounds(destMask(sourceRoi));
+        Mat destSource;
+        Point destSourceTl(0, 0);
+
+        if(overlap.area() > 0) {
+            double minFlow, maxFlow;
+            minMaxLoc(flow(overlap).reshape(1), &minFlow, &maxFlow);
+
+            // Bilinear sampling reaches one pixel further. 
+            const int reach = (int)ceil(std::max(-minFlow, maxFlow)) + 2;
+            const Rect region = Rect(overlap.x + dx - reach, overlap.y + dy - reach,
+                    overlap.width + 2 * reach, overlap.height + 2 * reach) & 
+                Rect(0, 0, dw, dh);
+
+            destSource = pool.Create(region.size(), CV_8UC3);
+            dest(region).copyTo(destSource);
+            destSourceTl = region.tl();
         }
 
-        // Remap the images as calculated above.
-        // That is 4 times faster than direct sampling. 
-        Mat remappedImg(w, h, CV_8UC3);
-        Mat remappedDest(w, h, CV_8UC3);
-        
-        cv::remap(img, remappedImg, imgMapX, imgMapY, INTER_LINEAR);
-        cv::remap(dest, remappedDest, destMapX, destMapY, INTER_LINEAR);
-
-        /// Now blend the remapped images. 
-        pwmDest = (float*)wmDest.ptr();
-        uchar* pRemappedImg = remappedImg.ptr();
-        uchar* pRemappedDest = remappedDest.ptr();
-        uchar* pTemp = temp.ptr();
-        
-        for (int y = 0; y < h; ++y)
-        {
-            for (int x = 0; x < w; ++x)
+        t.Tick("Blending Source Copy");
+
+        const int tileRows = std::min(blendTileRows, h);
+
+        Mat imgMapX = pool.Create(Size(w, tileRows), CV_32F);
+        Mat imgMapY = pool.Create(Size(w, tileRows), CV_32F);
+        Mat destMapX = pool.Create(Size(w, tileRows), CV_32F);
+        Mat destMapY = pool.Create(Size(w, tileRows), CV_32F);
+        Mat remappedImg = pool.Create(Size(w, tileRows), CV_8UC3);
+        Mat remappedDest = pool.Create(Size(w, tileRows), CV_8UC3);
+
+        // Remap and blend tile by tile, so all intermediate 
+        // buffers stay in cache. 
+        for(int ty = 0; ty < h; ty += tileRows) {
+            const int rows = std::min(tileRows, h - ty);
+            bool hasDest = false;
+
+            Mat tileImgMapX = imgMapX.rowRange(0, rows);
+            Mat tileImgMapY = imgMapY.rowRange(0, rows);
+            Mat tileDestMapX = destMapX.rowRange(0, rows);
+            Mat tileDestMapY = destMapY.rowRange(0, rows);
+            Mat target = dest(Rect(dx, dy + ty, w, rows));
+
+            for (int y = ty; y < ty + rows; ++y)
             {
-                float wcd = *pwmDest++;
-                float wcs = 1.f - wcd;
+                const Vec2f* pFlow = flow.ptr<Vec2f>(y);
+                const float* pwmDest = wmDest.ptr<float>(y);
+                float* pImgMapX = tileImgMapX.ptr<float>(y - ty);
+                float* pImgMapY = tileImgMapY.ptr<float>(y - ty);
+                float* pDestMapX = tileDestMapX.ptr<float>(y - ty);
+                float* pDestMapY = tileDestMapY.ptr<float>(y - ty);
+
+                for (int x = 0; x < w; ++x)
+                {
+                    float wcd = pwmDest[x];
+                    float wcs = 1.f - wcd;
+
+                    // Convert flow to remap representation.
+                    // Also add weights in one go. 
+                    // Translation of source position is proportional
+                    // to dest weight and vice-versa. 
+                    float imgDx = x + pFlow[x][0] * wcd;
+                    float imgDy = y + pFlow[x][1] * wcd;
+
+                    // Check mapping - if out-of-bounds we use Identity mapping
+                    // Todo: Might want to check mask
+                    pImgMapX[x] = imgDx < 0 || imgDx >= w ? x : imgDx;
+                    pImgMapY[x] = imgDy < 0 || imgDy >= h ? y : imgDy;
+
+                    if(wcd > 0) {
+                        float destDx = dx + x - pFlow[x][0] * wcs;
+                        float destDy = dy + y - pFlow[x][1] * wcs;
+
+                        destDx = destDx < 0 || destDx >= dw ? dx + x : destDx;
+                        destDy = destDy < 0 || destDy >= dh ? dy + y : destDy;
+
+                        pDestMapX[x] = destDx - destSourceTl.x;
+                        pDestMapY[x] = destDy - destSourceTl.y;
+                        hasDest = true;
+                    } else {
+                        // Not weighted, sample the (black) border. 
+                        pDestMapX[x] = -2;
+                        pDestMapY[x] = -2;
+                    }
+                }
+            }
+
+            if(!hasDest) {
+                // Nothing to blend, remap the source straight into dest. 
+                cv::remap(img, target, tileImgMapX, tileImgMapY, INTER_LINEAR);
+                continue;
+            }
+
+            Mat tileImg = remappedImg.rowRange(0, rows);
+            Mat tileDest = remappedDest.rowRange(0, rows);
 
-                for(int c = 0; c < 3; c++) {
-                    *pTemp++ = (uchar)(wcd * (*pRemappedDest++) + wcs * (*pRemappedImg++));
+            cv::remap(img, tileImg, tileImgMapX, tileImgMapY, INTER_LINEAR);
+            cv::remap(destSource, tileDest, tileDestMapX, tileDestMapY, INTER_LINEAR);
+
+            /// Now blend the remapped images into dest. 
+            for (int y = 0; y < rows; ++y)
+            {
+                const float* pwmDest = wmDest.ptr<float>(ty + y);
+                const uchar* pRemappedImg = tileImg.ptr(y);
+                const uchar* pRemappedDest = tileDest.ptr(y);
+                uchar* pTarget = target.ptr(y);
+
+                for (int x = 0; x < w; ++x)
+                {
+                    float wcd = pwmDest[x];
+                    float wcs = 1.f - wcd;
+
+                    for(int c = 0; c < 3; c++) {
+                        pTarget[x * 3 + c] = (uchar)(wcd * pRemappedDest[x * 3 + c] + 
+                                wcs * pRemappedImg[x * 3 + c]);
+                    }
                 }
             }
         }
 
         if(debug) {
-            imwrite("dbg/" + ToString(dbgCtr) + "_blended.jpg", temp);
+            imwrite("dbg/" + ToString(dbgCtr) + "_blended.jpg", dest(sourceRoi));
             dbgCtr++;
         }
         
         t.Tick("Blending Loop");
 
-        // Commit the results to the destination image. 
-        temp.copyTo(dest(sourceRoi));
+        // Commit the mask. 
         destMask(sourceRoi).setTo(Scalar(255));
 
         existingCores.push_back(sourceRoi);
@@ -1,10 +1,21 @@
 #include <opencv2/core.hpp>
 
+#include "../common/bufferPool.hpp"
+#include "flowEngine.hpp"
+
 #ifndef OPTONAUT_FLOW_BLENDER_HEADER
 #define OPTONAUT_FLOW_BLENDER_HEADER
 
 namespace optonaut {
 
+    /*
+     * Aligner used by FlowBlender to re-calculate the offset of an image pair. 
+     */
+    enum class OffsetSearch {
+        Pyramid,
+        PhaseCorrelation
+    };
+
     /*
      * Flow blender. We don't inherit from OpenCV's blender, since we want to save
      * memory by using U8C3 instead of U16C3. 
@@ -15,32 +26,53 @@ namespace optonaut {
     public:
         // Todo: Sharpness param is stupid, should replace 
         // by auto selection from image size. 
-        FlowBlender(float sharpness = 0.005f, const bool useFlow = true);
+        FlowBlender(float sharpness = 0.005f, const bool useFlow = true, 
+                FlowEngineP flowEngine = nullptr);
 
         float GetSharpness() const { return sharpness; }
         void SetSharpness(float val) { sharpness = val; }
 
+        OffsetSearch GetOffsetSearch() const { return offsetSearch; }
+        void SetOffsetSearch(OffsetSearch val) { offsetSearch = val; }
+
         void Prepare(const cv::Rect &dstRoi);
         void Feed(const cv::Mat &img, const cv::Mat &flow, const cv::Point &tl);
         void CalculateFlow(
-            const Mat &a, const Mat &b, 
-            const Point &aTl, const Point &bTl,
-            Mat &flow, 
-            Point &offset = dummyFlow, const bool reCalcOffset = true) const; 
+            const cv::Mat &a, const cv::Mat &b, 
+            const cv::Point &aTl, const cv::Point &bTl,
+            cv::Mat &flow, 
+            cv::Point &offset = dummyFlow, const bool reCalcOffset = true) const; 
         const cv::Mat& GetResult() const { return dest; }
         const cv::Mat& GetResultMask() const { return destMask; }
 
+        /*
+         * Returns the pool all scratch buffers are taken from. 
+         * After the first pair, buffers are re-used and the allocation
+         * count stays constant.
+         */
+        const BufferPool& GetBufferPool() const { return pool; }
+
     private:
-        static Point dummyFlow;
+        static cv::Point dummyFlow;
         float sharpness;
         cv::Mat dest;
         cv::Mat destMask;
         cv::Rect destRoi;
         bool useFlow;
+        OffsetSearch offsetSearch;
+        FlowEngineP flowEngine;
         std::vector<cv::Rect> existingCores;
+        // Mutable, since flows are calculated in a const context. 
+        mutable BufferPool pool;
     };
 
-    inline FlowBlender::FlowBlender(float sharpness, bool useFlow) : useFlow(useFlow) { 
+    /*
+     * @param flowEngine The flow algorithm to use. If null, the default engine is used. 
+     */
+    inline FlowBlender::FlowBlender(float sharpness, bool useFlow, FlowEngineP flowEngine) : 
+        useFlow(useFlow), 
+        offsetSearch(OffsetSearch::Pyramid),
+        flowEngine(flowEngine != nullptr ? flowEngine : CreateDefaultFlowEngine()) { 
         SetSharpness(sharpness); 
     }
 }
@@ -0,0 +1,213 @@
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <opencv2/video/tracking.hpp>
+#if CV_VERSION_MAJOR < 4 && defined(HAVE_OPENCV_OPTFLOW)
+#include <opencv2/optflow.hpp>
+#endif
+
+#include "../common/assert.hpp"
+
+#ifndef OPTONAUT_FLOW_ENGINE_HEADER
+#define OPTONAUT_FLOW_ENGINE_HEADER
+
+// DIS is part of the video module since OpenCV 4, before
+// it is only available with the contrib optflow module.
+#if CV_VERSION_MAJOR >= 4 || defined(HAVE_OPENCV_OPTFLOW)
+#define OPTONAUT_HAS_DIS_FLOW
+#endif
+
+namespace optonaut {
+
+    /*
+     * Dense optical flow algorithm, as used by the flow blender.
+     */
+    class FlowEngine {
+    public:
+        virtual ~FlowEngine() { }
+
+        /*
+         * Calculates the dense flow between two grayscale images of equal size.
+         *
+         * @param prev The first image.
+         * @param next The second image.
+         * @param flow The CV_32FC2 flow, so that prev(y, x) corresponds to
+         *             next(y + flow(y, x)[1], x + flow(y, x)[0]).
+         */
+        virtual void Calculate(cv::InputArray prev, cv::InputArray next,
+                cv::OutputArray flow) const = 0;
+    };
+
+    typedef std::shared_ptr<FlowEngine> FlowEngineP;
+
+    /*
+     * Farneback flow on full resolution.
+     */
+    class FarnebackFlowEngine : public FlowEngine {
+    private:
+        const int levels;
+        const int iterations;
+    public:
+        FarnebackFlowEngine(int levels = 1, int iterations = 4) :
+            levels(levels), iterations(iterations) { }
+
+        virtual void Calculate(cv::InputArray prev, cv::InputArray next,
+                cv::OutputArray flow) const {
+            calcOpticalFlowFarneback(prev, next, flow,
+                    0.5, // Pyr Scale
+                    levels, // Levels
+                    5, // Winsize
+                    iterations, // Iterations
+                    5, // Poly N
+                    1.1, // Poly Sigma
+                    0); // Flags
+        }
+    };
+
+#ifdef OPTONAUT_HAS_DIS_FLOW
+    /*
+     * Dense inverse search flow. Considerably faster than Farneback
+     * for similar quality.
+     */
+    class DISFlowEngine : public FlowEngine {
+    private:
+        const int preset;
+    public:
+        /*
+         * @param preset One of the DIS presets, ultrafast (0), fast (1) or medium (2).
+         */
+        DISFlowEngine(int preset = 1) : preset(preset) { }
+
+        virtual void Calculate(cv::InputArray prev, cv::InputArray next,
+                cv::OutputArray flow) const {
+            // DIS instances hold per-call state, so we don't share them
+            // between threads.
+#if CV_VERSION_MAJOR >= 4
+            cv::Ptr<cv::DenseOpticalFlow> dis = cv::DISOpticalFlow::create(preset);
+#else
+            cv::Ptr<cv::DenseOpticalFlow> dis = cv::optflow::createOptFlow_DIS(preset);
+#endif
+            dis->calc(prev, next, flow);
+        }
+    };
+#endif
+
+    /*
+     * Coarse to fine flow. Calculates the flow with the given engine on
+     * a downsampled image and upsamples the result.
+     */
+    class PyramidFlowEngine : public FlowEngine {
+    private:
+        const FlowEngineP engine;
+        const int levels;
+    public:
+        /*
+         * @param engine The engine to use on the downsampled images.
+         * @param levels The count of pyramid levels, one for half resolution,
+         *               two for quarter resolution.
+         */
+        PyramidFlowEngine(FlowEngineP engine, int levels = 1) :
+            engine(engine), levels(levels) {
+            AssertGE(levels, 0);
+        }
+
+        virtual void Calculate(cv::InputArray prev, cv::InputArray next,
+                cv::OutputArray flow) const {
+            cv::UMat a = prev.getUMat(), b = next.getUMat();
+
+            for(int i = 0; i < levels; i++) {
+                cv::UMat da, db;
+                pyrDown(a, da);
+                pyrDown(b, db);
+                a = da;
+                b = db;
+            }
+
+            cv::UMat coarse;
+            engine->Calculate(a, b, coarse);
+
+            // Flow vectors scale with the image.
+            cv::UMat scaled;
+            resize(coarse, scaled, prev.size(), 0, 0, cv::INTER_LINEAR);
+            cv::multiply(scaled, cv::Scalar::all((double)(1 << levels)), flow);
+        }
+    };
+
+    enum class FlowEngineType {
+        Farneback,
+        DIS,
+        HalfResolutionFarneback,
+        QuarterResolutionFarneback
+    };
+
+    /*
+     * Creates a flow engine of the given type. Falls back to farneback flow if
+     * DIS is not available.
+     */
+    inline FlowEngineP CreateFlowEngine(FlowEngineType type) {
+        switch(type) {
+            case FlowEngineType::DIS:
+#ifdef OPTONAUT_HAS_DIS_FLOW
+                return std::make_shared<DISFlowEngine>();
+#else
+                AssertWM(false, "DIS flow is available");
+                return std::make_shared<FarnebackFlowEngine>();
+#endif
+            case FlowEngineType::HalfResolutionFarneback:
+                return std::make_shared<PyramidFlowEngine>(
+                        std::make_shared<FarnebackFlowEngine>(), 1);
+            case FlowEngineType::QuarterResolutionFarneback:
+                return std::make_shared<PyramidFlowEngine>(
+                        std::make_shared<FarnebackFlowEngine>(), 2);
+            case FlowEngineType::Farneback:
+            default:
+                return std::make_shared<FarnebackFlowEngine>();
+        }
+    }
+
+    /*
+     * Returns the default flow engine, farneback flow on half resolution.
+     */
+    inline FlowEngineP CreateDefaultFlowEngine() {
+        return CreateFlowEngine(FlowEngineType::HalfResolutionFarneback);
+    }
+
+    /*
+     * Calculates the residual photometric error of a flow field, that is the
+     * mean absolute difference between prev and next warped by the flow.
+     * Pixels that are mapped outside of next are ignored.
+     *
+     * @returns The mean error in gray levels, or zero if no pixel could be mapped.
+     */
+    inline double CalculateFlowResidual(const cv::Mat &prev, const cv::Mat &next, const cv::Mat &flow) {
+        AssertEQ(flow.type(), CV_32FC2);
+        AssertEQ(prev.size(), flow.size());
+
+        cv::Mat map(flow.size(), CV_32FC2);
+
+        for(int y = 0; y < flow.rows; y++) {
+            const cv::Vec2f *f = flow.ptr<cv::Vec2f>(y);
+            cv::Vec2f *m = map.ptr<cv::Vec2f>(y);
+            for(int x = 0; x < flow.cols; x++) {
+                m[x] = cv::Vec2f(x + f[x][0], y + f[x][1]);
+            }
+        }
+
+        cv::Mat warped, mask;
+        cv::Mat ones(next.size(), CV_8U, cv::Scalar::all(255));
+        remap(next, warped, map, cv::noArray(), cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+        remap(ones, mask, map, cv::noArray(), cv::INTER_NEAREST, cv::BORDER_CONSTANT);
+
+        if(countNonZero(mask) == 0) {
+            return 0;
+        }
+
+        cv::Mat diff;
+        absdiff(prev, warped, diff);
+
+        const cv::Scalar error = mean(diff, mask);
+
+        return (error[0] + error[1] + error[2] + error[3]) / prev.channels();
+    }
+}
+
+#endif
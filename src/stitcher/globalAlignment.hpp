@@ -57,17 +57,18 @@ namespace optonaut {
         }
 
         // Loads mini images from the source, then unloads the original. 
+        // Images that are not loaded yet are decoded at reduced size directly. 
         void MinifyImages(vector<InputImageP> &images, int downsample = 2) {
            AssertGT(downsample, 0);
 
-           int  counter = 0;
            for(auto img : images) {
-                std::string source = img->image.source;
                 if(!img->image.IsLoaded()) {
-                    img->image.Load();
+                    img->image.LoadScaled(downsample);
                     AssertM(img->image.data.cols != 0, "Image loaded successfully");
+                    continue;
                 }
 
+                std::string source = img->image.source;
                 cv::Mat small;
 
                 pyrDown(img->image.data, small);
@@ -76,7 +77,6 @@ namespace optonaut {
                     pyrDown(small, small);
                 }
 
-                counter++;
                 img->image = Image(small);
                 img->image.source = source;
 
@@ -1,11 +1,7 @@
 #include <vector>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/opencv.hpp>
-//define private public, so we can access
-//opencv internal information and print it (to debug the multi-band blender ONLY)
-#define private public
 #include <opencv2/stitching.hpp>
-#undef private
 
 #include "../math/support.hpp"
 #include "../common/image.hpp"
@@ -15,10 +11,13 @@
 #include "../common/static_timer.hpp"
 #include "../common/functional.hpp"
 #include "../common/logger.hpp"
+#include "../common/threadPool.hpp"
 #include "ringStitcher.hpp"
 #include "multiringStitcher.hpp"
 #include "stitchingResult.hpp"
 #include "dynamicSeamer.hpp"
+#include "ringBlender.hpp"
+#include "ringAdjustment.hpp"
 
 using namespace std;
 using namespace cv;
@@ -76,63 +75,56 @@ namespace optonaut {
     void MultiRingStitcher::AdjustCorners(std::vector<StitchingResultP> &rings, ProgressCallback &progress) {
 
         /*
-         * Correlates an image pair using OpenCVs extended correlation coefficients. 
+         * Correlates the overlapping band of an image pair using OpenCVs extended 
+         * correlation coefficients, coarse to fine. Color rings that are already 
+         * loaded are only converted to grayscale within the band. 
          * Adds the correlation result (the approximate horizontal offset) to the dy cache. 
          */
         auto correlate = [this] (const StitchingResultP &imgA, const StitchingResultP &imgB) {
-            const int warp = MOTION_TRANSLATION;
-            Mat affine = Mat::eye(2, 3, CV_32F);
+            Log << "AffineDYOrig: " << (imgA->corner.y - imgB->corner.y);
 
-            const int iterations = 100;
-            const double eps = 1e-3;
+            int dy = FindRingOffset(imgA->image.data, imgA->corner, 
+                    imgB->image.data, imgB->corner);
 
-            int dy = imgA->corner.y - imgB->corner.y;
-            affine.at<float>(1, 2) = dy;
+            Log << "AffineDY: " << dy;
 
-            TermCriteria termination(TermCriteria::COUNT + TermCriteria::EPS,
-                    iterations, eps);
-
-
-            Log << "AffineDYOrig: " << dy;
-
-            try {
-
-                if(imgA->image.data.type() != CV_8UC1) {
-                    Mat grayA, grayB;
+            dyCache.push_back(dy);
+        };
 
-                    cvtColor(imgA->image.data, grayA, CV_BGR2GRAY);
-                    cvtColor(imgB->image.data, grayB, CV_BGR2GRAY);
-                    
-                    findTransformECC(grayA, grayB, affine, warp, termination);
-                } else {
-                    findTransformECC(imgA->image.data, imgB->image.data, affine, warp, termination);
-                }
-                dy = affine.at<float>(1, 2);
-                Log << "AffineDY: " << dy;
-            } catch (Exception ex) {
-                // :(
+        auto calculate = [&] () {
+            dyCache.clear();
+
+            // Load ring adjustment, if we already have one (for example if we're stitching the right
+            // image, and we want to use the adjustment of the left image). 
+            store.LoadRingAdjustment(dyCache);
+
+            // Setup a ring processor without overlap and process our list of rings. 
+            // Process is: Load image in grayscale, correlate, then unload the image.
+            if(dyCache.size() == 0) {
+                RingProcessor<StitchingResultP> queue(1, 0, 
+                    std::bind(&LoadSRPGrayscaleDropMask, std::ref(store), std::placeholders::_1), 
+                    correlate, 
+                    std::bind(&UnLoadSRP, std::ref(store), std::placeholders::_1));
+                queue.Process(rings, progress);
+                
+                // If we did ring adjustment, save the resulting horizontal offset to our cache. 
+                store.SaveRingAdjustment(dyCache);
             }
 
-            dyCache.push_back(dy);
+            return dyCache;
         };
 
-        // Load ring adjustment, if we already have one (for example if we're stitching the right
-        // image, and we want to use the adjustment of the left image). 
-        store.LoadRingAdjustment(dyCache);
-
-        // Setup a ring processor without overlap and process our list of rings. 
-        // Process is: Load image in grayscale, correlate, then unload the image.
-        if(dyCache.size() == 0) {
-            RingProcessor<StitchingResultP> queue(1, 0, 
-                std::bind(&LoadSRPGrayscaleDropMask, std::ref(store), std::placeholders::_1), 
-                correlate, 
-                std::bind(&UnLoadSRP, std::ref(store), std::placeholders::_1));
-            queue.Process(rings, progress);
-            
-            // If we did ring adjustment, save the resulting horizontal offset to our cache. 
-            store.SaveRingAdjustment(dyCache);
+        // If we share the adjustment, only the producer calculates it. 
+        if(sharedAdjustment != nullptr) {
+            dyCache = producesAdjustment ? 
+                sharedAdjustment->Get(calculate) : sharedAdjustment->Wait(calculate);
+            progress(1);
+        } else {
+            calculate();
         }
 
+        AssertGE(dyCache.size(), rings.size() - 1);
+
         // Apply the horizontal offset to all rings. 
         for(size_t i = 1; i < rings.size(); i++) {
             rings[i]->corner.y = rings[i - 1]->corner.y - dyCache[i - 1];
@@ -157,11 +149,30 @@ namespace optonaut {
         queue.Process(rings);
     }
     
-    void MultiRingStitcher::InitializeForStitching(std::vector<std::vector<InputImageP>> &rings, ExposureCompensator &exposure, double ev) {
+    void MultiRingStitcher::InitializeForStitching(std::vector<std::vector<InputImageP>> &rings, ExposureCompensator &exposure, double ev,
+            SharedRingAdjustmentP sharedAdjustment, MemoryBudgetP memoryBudget, bool producesAdjustment) {
         this->rings = rings;
         this->exposure.SetGains(exposure.GetGains());
         this->ev = ev;
         this->dyCache = vector<int>();
+        this->sharedAdjustment = sharedAdjustment;
+        this->producesAdjustment = producesAdjustment;
+        this->memoryBudget = memoryBudget;
+    }
+
+    size_t MultiRingStitcher::EstimateRingMemory(const vector<InputImageP> &ring) {
+        // The stitched ring and its mask are about as large as all
+        // input images together. On top, the ring stitcher keeps the 
+        // current input images, warped images and flow buffers, which 
+        // we account for by a constant factor. 
+        static const size_t bytesPerPixel = (3 + 1) * 2;
+
+        size_t pixels = 0;
+        for(auto &img : ring) {
+            pixels += (size_t)img->image.cols * (size_t)img->image.rows;
+        }
+
+        return pixels * bytesPerPixel;
     }
     
     StitchingResultP MultiRingStitcher::StitchRing(const vector<InputImageP> &ring, ProgressCallback &progress, int ringId) const {
@@ -230,14 +241,51 @@ namespace optonaut {
         Log << "Attempting to stitch rings.";
         int margin = -1; 
        
-        // For each ring, stitch. 
+        // Stitches a single ring, within our memory budget if we have one. 
+        auto stitchRing = [&] (size_t i) {
+            unique_ptr<MemoryBudget::Reservation> reservation;
+            if(memoryBudget != nullptr) {
+                reservation.reset(new MemoryBudget::Reservation(
+                        *memoryBudget, EstimateRingMemory(rings[i])));
+            }
+            return StitchRing(rings[i], progressCallbacks.At(i), (int)i);
+        };
+
+        vector<StitchingResultP> ringResults(rings.size());
+       
+        if(concurrentRings > 1 && rings.size() > 1) {
+            // Rings are independent until ring adjustment, so we stitch them
+            // concurrently. The pool size caps the count of rings in flight. 
+            ThreadPool pool(std::min(concurrentRings, rings.size()));
+            vector<future<void>> tasks;
+
+            for(size_t i = 0; i < rings.size(); i++) {
+                if(rings[i].size() != 0) {
+                    tasks.push_back(pool.Push([&, i] () {
+                                ringResults[i] = stitchRing(i);
+                            }));
+                }
+            }
+
+            for(auto &task : tasks) {
+                task.get();
+            }
+        } else {
+            for(size_t i = 0; i < rings.size(); i++) {
+                if(rings[i].size() != 0) {
+                    ringResults[i] = stitchRing(i);
+                }
+            }
+        }
+       
+        // For each stitched ring, collect the result. 
         for(size_t i = 0; i < rings.size(); i++) {
             if(rings[i].size() == 0) {
                 progressCallbacks.At(i)(1);
                 continue;
             }
             
-            auto res = StitchRing(rings[i], progressCallbacks.At(i), (int)i);
+            auto res = ringResults[i];
             
             stitchedRings.push_back(res);
 
@@ -259,6 +307,12 @@ namespace optonaut {
             stitcherTimer.Tick("Ring Finished");
         }
 
+        // Rows trimmed away at the top and bottom of the result. 
+        static const int trim = 2;
+
+        // Tiles of the result, written while blending, if enabled. 
+        TilePyramidWriterP tiles;
+
         // If we have more than one ring, adjust the rings, 
         // find seams and blend them together. 
         if(stitchedRings.size() > 1) {
@@ -274,12 +328,7 @@ namespace optonaut {
             
             stitcherTimer.Tick("Corner Adjusting Finished");
             
-            Ptr<Blender> blender;
-            blender = Blender::createDefault(cv::detail::Blender::FEATHER, false);
-            //MultiBandBlender* mb;
-            //mb = dynamic_cast<MultiBandBlender*>(blender.get());
-            //mb->setNumBands(5);
-            
+            RingBlender blender(blendMode);
 
             Rect inRoi = detail::resultRoi(fun::map<StitchingResultP, Point>
                     (stitchedRings, [](const StitchingResultP &x) { return x->corner; }),
@@ -298,7 +347,18 @@ namespace optonaut {
             float dy = (float)outRoi.height / (float)(inRoi.height + 2 * margin);
 
             Log << "InRoi: " << inRoi << " OutRoi: " << outRoi;
-            blender->prepare(outRoi);
+
+            // The blender keeps references to all resized rings, which
+            // cover the output about once, with image and mask. 
+            static const size_t resizedBytesPerPixel = 3 + 1;
+            unique_ptr<MemoryBudget::Reservation> reservation;
+            if(memoryBudget != nullptr) {
+                reservation.reset(new MemoryBudget::Reservation(
+                        *memoryBudget, (size_t)outRoi.area() * resizedBytesPerPixel + 
+                        blender.EstimateMemory(outRoi.size())));
+            }
+
+            blender.Prepare(outRoi);
 
             Log << "Attempting ring blending.";
             for(size_t i = 0; i < stitchedRings.size(); i++) {
@@ -326,35 +386,37 @@ namespace optonaut {
                     res->mask.Unload();
                 }
 
-                Mat warpedImageAsShort;
-                resizedImage.convertTo(warpedImageAsShort, CV_16S);
-
                 //Set one pixel of the mask to black on the edges to enable blending. 
                 resizedMask(Rect(0, 0, resizedMask.cols, 1)).setTo(Scalar::all(0));
                 resizedMask(Rect(0, resizedMask.rows - 1, resizedMask.cols, 1)).setTo(Scalar::all(0));
 
                 Point newCorner((res->corner.x - sx) * dx, (res->corner.y - sy) * dy); 
 
-                blender->feed(warpedImageAsShort, resizedMask, newCorner);
+                blender.Feed(resizedImage, resizedMask, newCorner);
             }
 
-            //for(int i = 0; i < mb->num_bands_; i++) {
-            //    Mat tmp;
-            //    mb->dst_pyr_laplace_[i].convertTo(tmp, CV_8UC3, 12, 0);
-            //    imwrite("dbg/dst_pyr_laplace_" + ToString(i) + ".jpg", tmp);
-            //    mb->dst_band_weights_[i].convertTo(tmp, CV_8UC3, 255.0, 0);
-            //    imwrite("dbg/dst_pyr_weights_" + ToString(i) + ".jpg", mb->dst_band_weights_[i]);
-            //}
-
             stitchedRings.clear();
+
+            tiles = store.CreateOptographTileWriter(Size(outRoi.width, outRoi.height - 2 * trim));
             {
                 Mat imageRes, maskRes;
-                blender->blend(imageRes, maskRes);
-                imageRes.convertTo(imageRes, CV_8U);
+                RingBlender::StripCallback onStrip = nullptr;
+
+                if(tiles != NULL) {
+                    // Only pass on rows that survive trimming.
+                    onStrip = [&tiles, &outRoi] (const Mat &strip, const Mat&, int y) {
+                        const int y0 = max(y, trim);
+                        const int y1 = min(y + strip.rows, outRoi.height - trim);
+                        if(y1 > y0) {
+                            tiles->Push(strip.rowRange(y0 - y, y1 - y));
+                        }
+                    };
+                }
+
+                blender.Blend(imageRes, maskRes, onStrip);
                 res->image = Image(imageRes);
             }
             stitcherTimer.Tick("FinalStitching Finished");
-            blender.release();
         } else {
             res = stitchedRings.front();
             if(!res->image.IsLoaded()) {
@@ -364,9 +426,18 @@ namespace optonaut {
         
         
         // Final Step, trim away one dirty pixel.
-        static const int trim = 2;
-        
         res->image = Image(res->image.data(cv::Rect(0, trim, res->image.cols, res->image.rows - trim * 2)));
+
+        if(tiles == NULL) {
+            // Nothing was blended, so tile the result at once. 
+            tiles = store.CreateOptographTileWriter(res->image.size());
+            if(tiles != NULL) {
+                tiles->Push(res->image.data);
+            }
+        }
+        if(tiles != NULL) {
+            tiles->Finish();
+        }
         
         store.SaveOptograph(res);
         
@@ -2,14 +2,19 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/opencv.hpp>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 #include "../common/image.hpp"
 #include "../common/progressCallback.hpp"
+#include "../common/memoryBudget.hpp"
 #include "../math/support.hpp"
 #include "../recorder/exposureCompensator.hpp"
 #include "../io/checkpointStore.hpp"
 
 #include "ringStitcher.hpp"
+#include "ringBlender.hpp"
 #include "stitchingResult.hpp"
 
 #ifndef OPTONAUT_RINGWISE_STITCHER_HEADER
@@ -17,6 +22,69 @@
 
 namespace optonaut {
 
+    /*
+     * Ring adjustment shared between the stitchers of both eyes. One stitcher
+     * produces the adjustment, all others wait for it and re-use it, so the
+     * result does not depend on which stitcher finishes its rings first. 
+     *
+     * Thread safe.
+     */
+    class SharedRingAdjustment {
+        private:
+            std::vector<int> dyCache;
+            bool ready;
+            bool released;
+            std::mutex m;
+            std::condition_variable changed;
+        public:
+            SharedRingAdjustment() : ready(false), released(false) { }
+
+            SharedRingAdjustment(const SharedRingAdjustment&) = delete;
+            SharedRingAdjustment& operator=(const SharedRingAdjustment&) = delete;
+
+            /*
+             * Returns the adjustment. If it is not available yet, it is calculated 
+             * using the given function. Concurrent callers block until the 
+             * calculation is finished. 
+             */
+            std::vector<int> Get(std::function<std::vector<int>()> calculate) {
+                std::unique_lock<std::mutex> lock(m);
+                if(!ready) {
+                    dyCache = calculate();
+                    ready = true;
+                    changed.notify_all();
+                }
+                return dyCache;
+            }
+
+            /*
+             * Blocks until the producer provided the adjustment and returns it. If the 
+             * producer was released without adjusting rings, for example because it 
+             * loaded its result, the adjustment is calculated using the given function. 
+             */
+            std::vector<int> Wait(std::function<std::vector<int>()> calculate) {
+                std::unique_lock<std::mutex> lock(m);
+                changed.wait(lock, [this] { return ready || released; });
+                if(!ready) {
+                    dyCache = calculate();
+                    ready = true;
+                }
+                return dyCache;
+            }
+
+            /*
+             * Marks the producer as finished. Has to be called by the producer 
+             * in any case, so waiting stitchers do not block forever. 
+             */
+            void Release() {
+                std::unique_lock<std::mutex> lock(m);
+                released = true;
+                changed.notify_all();
+            }
+    };
+
+    typedef std::shared_ptr<SharedRingAdjustment> SharedRingAdjustmentP;
+
     /*
      * Class capable of stitching multiple rings. 
      */    
@@ -29,6 +97,11 @@ namespace optonaut {
             ExposureCompensator exposure; // Exposure compensator.
             CheckpointStore &store; // Store for storing intermediate results (saving memory).
             double ev; // Exposure bias setting.
+            SharedRingAdjustmentP sharedAdjustment; // Adjustment shared with other stitchers, optional.
+            bool producesAdjustment; // True if this stitcher calculates the shared adjustment.
+            MemoryBudgetP memoryBudget; // Budget shared with other stitchers, optional.
+            size_t concurrentRings; // Maximum count of rings stitched at the same time.
+            RingBlendMode blendMode; // Blending mode for compositing the rings. 
            
             /*
              * Finds approximate horizontal offsets between the given rings. 
@@ -47,23 +120,56 @@ namespace optonaut {
         public:
             /*
              * Prepares for stitching with the given width, height and store. 
+             *
+             * @param concurrentRings The maximum count of rings stitched at the same time,
+             *                        and thus the count of rings resident before they are 
+             *                        saved to the store. One stitches rings sequentially. 
              */
-            MultiRingStitcher(int width, int height, CheckpointStore &store) : 
-                w(width), h(height), store(store) { }
+            MultiRingStitcher(int width, int height, CheckpointStore &store, size_t concurrentRings = 1) : 
+                w(width), h(height), store(store), concurrentRings(concurrentRings), 
+                blendMode(RingBlendMode::Feather) { 
+                AssertGT(concurrentRings, (size_t)0);
+            }
 
             /*
              * Prepares for stitching with default width, height and the given store. 
              */
-            MultiRingStitcher(CheckpointStore &store) : 
-                w(0), h(0), store(store) { }
+            MultiRingStitcher(CheckpointStore &store, size_t concurrentRings = 1) : 
+                w(0), h(0), store(store), concurrentRings(concurrentRings), 
+                blendMode(RingBlendMode::Feather) { 
+                AssertGT(concurrentRings, (size_t)0);
+            }
 
             /*
              * Initializes the stitching engine with the given set of input images and
              * the given exposure compensator. 
+             *
+             * @param sharedAdjustment If set, the ring adjustment is calculated only once
+             *                         for all stitchers sharing this instance. 
+             * @param memoryBudget If set, ring stitching and blending block until
+             *                     their estimated memory is available. 
+             * @param producesAdjustment If true, this stitcher calculates the shared adjustment. 
+             *                           Otherwise, it waits for the producer. 
              */
             void InitializeForStitching(
                     std::vector<std::vector<InputImageP>> &rings, 
-                    ExposureCompensator &exposure, double ev = 0);
+                    ExposureCompensator &exposure, double ev = 0,
+                    SharedRingAdjustmentP sharedAdjustment = nullptr,
+                    MemoryBudgetP memoryBudget = nullptr,
+                    bool producesAdjustment = true);
+
+            /*
+             * Sets the blending mode for compositing the rings. Defaults to feather, 
+             * like the previous blender. Multi-band blending is opt-in. 
+             */
+            void SetBlendMode(RingBlendMode mode) {
+                blendMode = mode;
+            }
+
+            /*
+             * Returns the estimated peak memory used to stitch the given ring, in bytes. 
+             */
+            static size_t EstimateRingMemory(const std::vector<InputImageP> &ring);
            
             /*
              * Starts the stitching process. 
@@ -0,0 +1,98 @@
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "../common/assert.hpp"
+#include "../common/logger.hpp"
+#include "../imgproc/imagePyramid.hpp"
+
+#ifndef OPTONAUT_RING_ADJUSTMENT_HEADER
+#define OPTONAUT_RING_ADJUSTMENT_HEADER
+
+namespace optonaut {
+
+    /*
+     * Estimates the vertical offset between two adjacent stitched rings.
+     *
+     * Only the band where both rings overlap is correlated, extended by a search
+     * margin on the second ring. The translation is estimated using ECC
+     * on a pyramid of the band, coarse to fine.
+     *
+     * @param a The first ring, grayscale or color.
+     * @param aCorner The top left corner of the first ring.
+     * @param b The second ring, grayscale or color.
+     * @param bCorner The approximate top left corner of the second ring.
+     *
+     * @returns The vertical offset aCorner.y - bCorner.y, so that both rings
+     *          line up. If the rings do not overlap, the offset of the given corners.
+     */
+    inline int FindRingOffset(const cv::Mat &a, const cv::Point &aCorner,
+            const cv::Mat &b, const cv::Point &bCorner) {
+        // Minimum count of overlapping rows, and of rows on the coarsest level.
+        static const int minRows = 16;
+        static const int maxLevels = 3;
+        static const double eps = 1e-3;
+
+        const int dy = aCorner.y - bCorner.y;
+
+        const int o0 = std::max(aCorner.y, bCorner.y);
+        const int o1 = std::min(aCorner.y + a.rows, bCorner.y + b.rows);
+
+        if(o1 - o0 < minRows) {
+            Log << "Rings do not overlap, keeping offset " << dy;
+            return dy;
+        }
+
+        // Template is the overlap of the first ring, input the overlap
+        // of the second ring, extended by the search margin.
+        const int margin = std::max(minRows, (o1 - o0) / 2);
+        const int b0 = std::max(0, o0 - bCorner.y - margin);
+        const int b1 = std::min(b.rows, o1 - bCorner.y + margin);
+
+        std::vector<cv::Mat> templates(1), inputs(1);
+        ToLuma(a(cv::Rect(0, o0 - aCorner.y, a.cols, o1 - o0))).convertTo(templates[0], CV_32F);
+        ToLuma(b(cv::Rect(0, b0, b.cols, b1 - b0))).convertTo(inputs[0], CV_32F);
+
+        int levels = 0;
+        while(levels < maxLevels && (templates[0].rows >> (levels + 1)) >= minRows) {
+            levels++;
+        }
+
+        for(int l = 0; l < levels; l++) {
+            cv::Mat t, i;
+            pyrDown(templates[l], t);
+            pyrDown(inputs[l], i);
+            templates.push_back(t);
+            inputs.push_back(i);
+        }
+
+        // Template row y corresponds to input row y + ty.
+        cv::Mat affine = cv::Mat::eye(2, 3, CV_32F);
+        affine.at<float>(1, 2) = (float)(o0 - bCorner.y - b0) / (1 << levels);
+
+        for(int l = levels; l >= 0; l--) {
+            // Most iterations are spent on the coarsest level, finer
+            // levels only refine.
+            const int iterations = l == levels ? 50 : 20;
+            cv::TermCriteria termination(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+                    iterations, eps);
+
+            try {
+                findTransformECC(templates[l], inputs[l], affine,
+                        cv::MOTION_TRANSLATION, termination, cv::noArray());
+            } catch (cv::Exception &ex) {
+                // Keep the estimate of the coarser level.
+                Log << "ECC did not converge on level " << l;
+            }
+
+            if(l > 0) {
+                affine.at<float>(0, 2) *= 2;
+                affine.at<float>(1, 2) *= 2;
+            }
+        }
+
+        return cvRound(affine.at<float>(1, 2)) + b0 - o0 + aCorner.y;
+    }
+}
+
+#endif
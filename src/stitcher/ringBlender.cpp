@@ -0,0 +1,239 @@
+#include <opencv2/imgproc.hpp>
+#include <opencv2/stitching/detail/blenders.hpp>
+
+using namespace cv;
+using namespace std;
+
+#include "ringBlender.hpp"
+#include "../common/assert.hpp"
+
+namespace optonaut {
+
+    // Minimum weight sum for a pixel to be considered covered.
+    static const float weightEps = 1e-5f;
+
+    /*
+     * Adds src, weighted per pixel, to dst and the weight to dstWeight.
+     * Plain loops over continuous rows, so they are vectorized by the compiler.
+     */
+    static void AccumulateWeighted(const Mat &src, const Mat &weight, Mat &dst, Mat &dstWeight) {
+        AssertEQ(src.type(), CV_32FC3);
+        AssertEQ(weight.type(), CV_32F);
+
+        for(int y = 0; y < src.rows; y++) {
+            const float *s = src.ptr<float>(y);
+            const float *w = weight.ptr<float>(y);
+            float *d = dst.ptr<float>(y);
+            float *dw = dstWeight.ptr<float>(y);
+
+            for(int x = 0; x < src.cols; x++) {
+                d[x * 3 + 0] += s[x * 3 + 0] * w[x];
+                d[x * 3 + 1] += s[x * 3 + 1] * w[x];
+                d[x * 3 + 2] += s[x * 3 + 2] * w[x];
+                dw[x] += w[x];
+            }
+        }
+    }
+
+    /*
+     * Divides dst by the accumulated weight.
+     */
+    static void Normalize(Mat &dst, const Mat &dstWeight) {
+        for(int y = 0; y < dst.rows; y++) {
+            float *d = dst.ptr<float>(y);
+            const float *dw = dstWeight.ptr<float>(y);
+
+            for(int x = 0; x < dst.cols; x++) {
+                const float f = 1.f / (dw[x] + weightEps);
+                d[x * 3 + 0] *= f;
+                d[x * 3 + 1] *= f;
+                d[x * 3 + 2] *= f;
+            }
+        }
+    }
+
+    RingBlender::RingBlender(RingBlendMode mode, int bands, int stripHeight, float sharpness) :
+        mode(mode), bands(mode == RingBlendMode::MultiBand ? bands : 0),
+        sharpness(sharpness) {
+        AssertGE(bands, 0);
+        AssertGT(stripHeight, 0);
+        AssertGT(sharpness, 0.f);
+
+        // Strips start on multiples of the coarsest pyramid level,
+        // so all strips share the same sampling grid.
+        const int align = 1 << this->bands;
+        this->stripHeight = (stripHeight + align - 1) / align * align;
+    }
+
+    int RingBlender::GetStripMargin() const {
+        if(mode == RingBlendMode::MultiBand) {
+            // Reach of pyrDown and pyrUp, five taps on each level.
+            return 4 << bands;
+        } else {
+            // Distance at which feather weights saturate.
+            return (int)ceil(1.f / sharpness) + 1;
+        }
+    }
+
+    size_t RingBlender::EstimateMemory(const Size &dstSize) const {
+        const size_t margin = GetStripMargin();
+        const size_t stripPixels = (stripHeight + 2 * margin) * (dstSize.width + 2 * margin);
+
+        // Result and mask, plus the accumulated pyramids and
+        // the pyramids of a single input for one strip.
+        static const size_t bytesPerResultPixel = 3 + 1;
+        static const size_t bytesPerStripPixel = 64;
+
+        return (size_t)dstSize.area() * bytesPerResultPixel + stripPixels * bytesPerStripPixel;
+    }
+
+    void RingBlender::Prepare(const Rect &dstRoi) {
+        destRoi = dstRoi;
+        inputs.clear();
+    }
+
+    void RingBlender::Feed(const Mat &img, const Mat &mask, const Point &tl) {
+        AssertEQ(img.type(), CV_8UC3);
+        AssertEQ(mask.type(), CV_8U);
+        AssertEQ(img.size(), mask.size());
+
+        const Rect roi(tl - destRoi.tl(), img.size());
+        const Rect clipped = roi & Rect(Point(0, 0), destRoi.size());
+
+        if(clipped.area() == 0) {
+            return;
+        }
+
+        const Rect local(clipped.tl() - roi.tl(), clipped.size());
+
+        inputs.push_back({ img(local), mask(local), clipped });
+    }
+
+    void RingBlender::Blend(Mat &dst, Mat &dstMask, StripCallback onStrip) {
+        dst.create(destRoi.size(), CV_8UC3);
+        dstMask.create(destRoi.size(), CV_8U);
+
+        const int margin = GetStripMargin();
+        const int h = destRoi.height;
+        const int w = destRoi.width;
+
+        for(int y = 0; y < h; y += stripHeight) {
+            const int y1 = min(h, y + stripHeight);
+            const int cy0 = max(0, y - margin);
+            const int cy1 = min(h, y1 + margin);
+
+            BlendStrip(Rect(0, y, w, y1 - y), Rect(0, cy0, w, cy1 - cy0), dst, dstMask);
+
+            if(onStrip) {
+                onStrip(dst.rowRange(y, y1), dstMask.rowRange(y, y1), y);
+            }
+        }
+
+        // Release references to the inputs.
+        inputs.clear();
+    }
+
+    void RingBlender::BlendStrip(const Rect &strip, const Rect &context,
+            Mat &dst, Mat &dstMask) {
+
+        // Horizontal padding, filled by wrapping around.
+        const int padX = min(GetStripMargin(), context.width);
+
+        vector<Size> sizes(bands + 1);
+        sizes[0] = Size(context.width + 2 * padX, context.height);
+        for(int l = 1; l <= bands; l++) {
+            sizes[l] = Size((sizes[l - 1].width + 1) / 2, (sizes[l - 1].height + 1) / 2);
+        }
+
+        vector<Mat> dstBands(bands + 1);
+        vector<Mat> dstWeights(bands + 1);
+
+        for(int l = 0; l <= bands; l++) {
+            dstBands[l] = pool.Create(sizes[l], CV_32FC3);
+            dstBands[l].setTo(Scalar::all(0));
+            dstWeights[l] = pool.Create(sizes[l], CV_32F);
+            dstWeights[l].setTo(Scalar::all(0));
+        }
+
+        bool covered = false;
+
+        for(auto &input : inputs) {
+            const Rect overlap = input.roi & context;
+
+            if(overlap.area() == 0) {
+                continue;
+            }
+
+            covered = true;
+
+            Mat image = pool.Create(context.size(), CV_8UC3);
+            Mat mask = pool.Create(context.size(), CV_8U);
+            image.setTo(Scalar::all(0));
+            mask.setTo(Scalar::all(0));
+
+            const Rect source(overlap.tl() - input.roi.tl(), overlap.size());
+            const Rect target(overlap.tl() - context.tl(), overlap.size());
+            input.image(source).copyTo(image(target));
+            input.mask(source).copyTo(mask(target));
+
+            Mat paddedImage = pool.Create(sizes[0], CV_8UC3);
+            Mat paddedMask = pool.Create(sizes[0], CV_8U);
+            copyMakeBorder(image, paddedImage, 0, 0, padX, padX, BORDER_WRAP);
+            copyMakeBorder(mask, paddedMask, 0, 0, padX, padX, BORDER_WRAP);
+
+            Mat gauss = pool.Create(sizes[0], CV_32FC3);
+            Mat weight = pool.Create(sizes[0], CV_32F);
+            paddedImage.convertTo(gauss, CV_32F);
+
+            if(mode == RingBlendMode::Feather) {
+                detail::createWeightMap(paddedMask, sharpness, weight);
+            } else {
+                paddedMask.convertTo(weight, CV_32F, 1.0 / 255.0);
+            }
+
+            for(int l = 0; l < bands; l++) {
+                Mat down = pool.Create(sizes[l + 1], CV_32FC3);
+                Mat up = pool.Create(sizes[l], CV_32FC3);
+                Mat downWeight = pool.Create(sizes[l + 1], CV_32F);
+
+                pyrDown(gauss, down, sizes[l + 1]);
+                pyrUp(down, up, sizes[l]);
+                subtract(gauss, up, up);
+
+                AccumulateWeighted(up, weight, dstBands[l], dstWeights[l]);
+
+                pyrDown(weight, downWeight, sizes[l + 1]);
+
+                gauss = down;
+                weight = downWeight;
+            }
+
+            AccumulateWeighted(gauss, weight, dstBands[bands], dstWeights[bands]);
+        }
+
+        const Rect inner(padX, strip.y - context.y, strip.width, strip.height);
+        Mat out = dst(strip);
+        Mat outMask = dstMask(strip);
+
+        if(!covered) {
+            out.setTo(Scalar::all(0));
+            outMask.setTo(Scalar::all(0));
+            return;
+        }
+
+        // Collapse the pyramid.
+        Mat result = dstBands[bands];
+        Normalize(result, dstWeights[bands]);
+
+        for(int l = bands - 1; l >= 0; l--) {
+            Normalize(dstBands[l], dstWeights[l]);
+            Mat up = pool.Create(sizes[l], CV_32FC3);
+            pyrUp(result, up, sizes[l]);
+            add(dstBands[l], up, dstBands[l]);
+            result = dstBands[l];
+        }
+
+        result(inner).convertTo(out, CV_8U);
+        compare(dstWeights[0](inner), weightEps, outMask, CMP_GT);
+    }
+}
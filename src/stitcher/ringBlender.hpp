@@ -0,0 +1,103 @@
+#include <vector>
+#include <functional>
+#include <opencv2/core.hpp>
+
+#include "../common/bufferPool.hpp"
+
+#ifndef OPTONAUT_RING_BLENDER_HEADER
+#define OPTONAUT_RING_BLENDER_HEADER
+
+namespace optonaut {
+
+    enum class RingBlendMode {
+        Feather,
+        MultiBand
+    };
+
+    /*
+     * Blender for compositing stitched rings into the final panorama.
+     * We don't inherit from OpenCV's blender, since we want to take U8C3 input
+     * as it is and avoid keeping full resolution U16C3 and weight buffers.
+     *
+     * Inputs are only referenced when fed. The output is blended in horizontal
+     * strips, so scratch memory is bounded by the strip height. The output wraps
+     * around horizontally, as the panorama covers the full circle.
+     *
+     * In multi-band mode, each strip is blended using laplacian pyramids. In feather
+     * mode, images are blended linearly with weights falling off towards the mask borders.
+     */
+    class RingBlender {
+    public:
+        /*
+         * Called for each blended strip of the result, top to bottom.
+         *
+         * @param strip The blended rows.
+         * @param stripMask The mask of the blended rows.
+         * @param y The first row of the strip in the result.
+         */
+        typedef std::function<void(const cv::Mat &strip, const cv::Mat &stripMask, int y)> StripCallback;
+
+        /*
+         * @param mode The blending mode.
+         * @param bands The count of pyramid levels for multi-band blending.
+         * @param stripHeight The count of output rows blended at once.
+         * @param sharpness Falloff of feather weights, per pixel.
+         */
+        RingBlender(RingBlendMode mode = RingBlendMode::Feather, int bands = 5,
+                int stripHeight = 256, float sharpness = 0.02f);
+
+        void Prepare(const cv::Rect &dstRoi);
+
+        /*
+         * Adds an image to the blend. The image and the mask are not copied,
+         * so they must not be changed before Blend was called.
+         *
+         * @param img The image, as U8C3.
+         * @param mask The mask of the image, as U8.
+         * @param tl The top left corner of the image in the destination.
+         */
+        void Feed(const cv::Mat &img, const cv::Mat &mask, const cv::Point &tl);
+
+        /*
+         * Blends all fed images.
+         *
+         * @param dst The result, as U8C3.
+         * @param dstMask The mask of the result, as U8.
+         * @param onStrip Optional, called as soon as a strip is final, so consumers
+         *                can process the result while the remaining strips are blended.
+         */
+        void Blend(cv::Mat &dst, cv::Mat &dstMask, StripCallback onStrip = nullptr);
+
+        /*
+         * Returns the count of rows above and below each strip
+         * that are blended for context.
+         */
+        int GetStripMargin() const;
+
+        /*
+         * Returns the estimated peak memory used by blending into the given
+         * destination, without the fed images, in bytes.
+         */
+        size_t EstimateMemory(const cv::Size &dstSize) const;
+
+    private:
+        struct Input {
+            cv::Mat image;
+            cv::Mat mask;
+            cv::Rect roi; // Region of the image in the destination.
+        };
+
+        const RingBlendMode mode;
+        const int bands;
+        int stripHeight;
+        const float sharpness;
+        cv::Rect destRoi;
+        std::vector<Input> inputs;
+        BufferPool pool;
+
+        void BlendStrip(const cv::Rect &strip, const cv::Rect &context,
+                cv::Mat &dst, cv::Mat &dstMask);
+    };
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/stitching/warpers.hpp>
+
+#include "../common/assert.hpp"
+#include "../common/logger.hpp"
+#include "../math/support.hpp"
+#include "../math/projection.hpp"
+
+#ifndef OPTONAUT_RING_GEOMETRY_CACHE_HEADER
+#define OPTONAUT_RING_GEOMETRY_CACHE_HEADER
+
+namespace optonaut {
+
+    /*
+     * Warping geometry of a single ring, as used by the ring stitcher.
+     * Immutable once created.
+     */
+    struct RingGeometry {
+        cv::Mat K; // Intrinsics, scaled to the image size, as float.
+        std::vector<cv::Mat> rotations; // Rotations, as 3x3 float.
+        std::vector<cv::Point> corners; // Warped top-left corners of all images.
+        std::vector<cv::Size> warpedSizes; // Warped sizes of all images.
+        cv::Rect dstRoi; // Outer rectangle of a warped image.
+        cv::Rect coreRoi; // Inner rectangle of a warped image, relative to dstRoi.
+        cv::Rect resultRoi; // Region of the stitched ring.
+        cv::Mat xymap; // Fixed point warp map, restricted to the core region.
+        cv::Mat interpolationMap; // Interpolation table for xymap.
+        cv::Mat warpedMask; // Warped image mask, restricted to the core region.
+    };
+
+    typedef std::shared_ptr<const RingGeometry> RingGeometryP;
+
+    /*
+     * Cache for ring geometries, keyed by intrinsics, image size,
+     * warper scale and rotations. Left and right stitchers of the same
+     * ring share one geometry.
+     *
+     * Geometries are reference counted. Besides the ones in use, the most
+     * recently created geometries are retained, so the rings of the right 
+     * eye can re-use the geometries of the left eye when stitched afterwards. 
+     *
+     * Thread safe.
+     */
+    class RingGeometryCache {
+    private:
+        std::map<std::string, std::weak_ptr<const RingGeometry>> entries;
+        // Strong references to the most recently created geometries. 
+        std::deque<RingGeometryP> retained;
+        const size_t retainCount;
+        std::mutex m;
+
+        static void Append(std::string &key, const void *data, size_t size) {
+            key.append(static_cast<const char*>(data), size);
+        }
+
+        static void Append(std::string &key, const cv::Mat &mat) {
+            AssertM(mat.isContinuous(), "Key matrix is continuous");
+            Append(key, mat.data, mat.total() * mat.elemSize());
+        }
+
+        /*
+         * Creates a binary key from the exact geometry parameters.
+         */
+        static std::string CreateKey(const cv::Mat &K, const cv::Size &imageSize,
+                float warperScale, const std::vector<cv::Mat> &rotations) {
+            std::string key;
+            Append(key, &imageSize.width, sizeof(int));
+            Append(key, &imageSize.height, sizeof(int));
+            Append(key, &warperScale, sizeof(float));
+            Append(key, K);
+
+            for(auto &r : rotations) {
+                Append(key, r);
+            }
+
+            return key;
+        }
+
+        /*
+         * Calculates the geometry. K and rotations are expected
+         * as float matrices.
+         */
+        static RingGeometryP Create(const cv::Mat &K, const cv::Size &imageSize,
+                float warperScale, const std::vector<cv::Mat> &rotations) {
+            auto geometry = std::make_shared<RingGeometry>();
+            const size_t n = rotations.size();
+
+            cv::SphericalWarper warperFactory;
+            cv::Ptr<cv::detail::RotationWarper> warper = warperFactory.create(warperScale);
+
+            geometry->K = K;
+            geometry->rotations = rotations;
+            geometry->corners.resize(n);
+            geometry->warpedSizes.resize(n);
+
+            // Calulate result ROI
+            for(size_t i = 0; i < n; i++) {
+                cv::Rect roi = warper->warpRoi(imageSize, K, rotations[i]);
+                geometry->corners[i] = cv::Point(roi.x, roi.y);
+                geometry->warpedSizes[i] = cv::Size(roi.width, roi.height);
+            }
+
+            //Prepare global masks and distortions.
+            const cv::Mat &R = rotations[0];
+
+            cv::Rect dstRoi = GetOuterRectangle(*warper, K, R, imageSize);
+            cv::Rect coreRoi = GetInnerRectangle(*warper, K, R, imageSize);
+
+            // Update result ROI
+            cv::Rect resultRoi = cv::detail::resultRoi(geometry->corners, geometry->warpedSizes);
+            resultRoi = cv::Rect(resultRoi.x, resultRoi.y + (coreRoi.y - dstRoi.y),
+                             resultRoi.width,
+                             coreRoi.height);
+
+            coreRoi = cv::Rect(coreRoi.x + 1, coreRoi.y + 1, coreRoi.width - 1, coreRoi.height - 1);
+
+            Log << "Destinatin ROI: " << dstRoi;
+            Log << "Result ROI: " << resultRoi;
+            Log << "Core ROI: " << coreRoi;
+
+            Log << "Warping K: " << K;
+            Log << "Warping R: " << R;
+
+            cv::Mat uxmap, uymap;
+            warper->buildMaps(imageSize, K, R, uxmap, uymap);
+            coreRoi = cv::Rect(coreRoi.tl() - dstRoi.tl(), coreRoi.size() - cv::Size(1, 1));
+
+            // We only ever keep the core region of warped images, so we
+            // only build maps for that region. Fixed point maps halve the
+            // memory bandwidth of remapping and are what remap
+            // would convert float maps to anyway.
+            convertMaps(uxmap(coreRoi), uymap(coreRoi),
+                    geometry->xymap, geometry->interpolationMap, CV_16SC2);
+
+            cv::Mat mask(imageSize, CV_8U, cv::Scalar::all(255));
+            remap(mask, geometry->warpedMask, uxmap(coreRoi), uymap(coreRoi),
+                    cv::INTER_NEAREST, cv::BORDER_CONSTANT);
+            Log << "Warped mask size: " << geometry->warpedMask.size();
+
+            geometry->dstRoi = dstRoi;
+            geometry->coreRoi = coreRoi;
+            geometry->resultRoi = resultRoi;
+
+            return geometry;
+        }
+
+    public:
+        /*
+         * Creates a new cache. 
+         *
+         * @param retainCount Count of geometries to keep when not in use. 
+         */
+        RingGeometryCache(size_t retainCount = 4) : retainCount(retainCount) { }
+
+        RingGeometryCache(const RingGeometryCache&) = delete;
+        RingGeometryCache& operator=(const RingGeometryCache&) = delete;
+
+        /*
+         * Returns the geometry for the given parameters, creating it if necessary.
+         *
+         * @param intrinsics The camera intrinsics, as double.
+         * @param imageSize The size of the input images.
+         * @param warperScale The scale of the spherical warper.
+         * @param rotations The rotations of all images of the ring, as 4x4 or 3x3 double.
+         */
+        RingGeometryP Get(const cv::Mat &intrinsics, const cv::Size &imageSize,
+                float warperScale, const std::vector<cv::Mat> &rotations) {
+            AssertGT(rotations.size(), (size_t)0);
+
+            cv::Mat scaledK, K;
+            ScaleIntrinsicsToImage(intrinsics, imageSize, scaledK);
+            From3DoubleTo3Float(scaledK, K);
+
+            std::vector<cv::Mat> floatRotations(rotations.size());
+            for(size_t i = 0; i < rotations.size(); i++) {
+                From3DoubleTo3Float(rotations[i], floatRotations[i]);
+            }
+
+            const std::string key = CreateKey(K, imageSize, warperScale, floatRotations);
+
+            {
+                std::unique_lock<std::mutex> lock(m);
+                auto it = entries.find(key);
+
+                if(it != entries.end()) {
+                    RingGeometryP cached = it->second.lock();
+                    if(cached != nullptr) {
+                        return cached;
+                    }
+                }
+            }
+
+            // Create outside of the lock, so other rings are not blocked.
+            RingGeometryP geometry = Create(K, imageSize, warperScale, floatRotations);
+
+            std::unique_lock<std::mutex> lock(m);
+
+            auto it = entries.find(key);
+
+            if(it != entries.end()) {
+                RingGeometryP cached = it->second.lock();
+                if(cached != nullptr) {
+                    // Another thread was faster.
+                    return cached;
+                }
+            }
+
+            entries[key] = geometry;
+
+            retained.push_back(geometry);
+            while(retained.size() > retainCount) {
+                retained.pop_front();
+            }
+
+            // Drop geometries that are not used anymore.
+            for(auto it = entries.begin(); it != entries.end();) {
+                if(it->second.expired()) {
+                    it = entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            return geometry;
+        }
+
+        /*
+         * Releases all retained geometries. Geometries that are in use
+         * stay valid. 
+         */
+        void Clear() {
+            std::unique_lock<std::mutex> lock(m);
+            retained.clear();
+        }
+
+        /*
+         * Returns the count of geometries that are currently in use or retained.
+         */
+        size_t Size() {
+            std::unique_lock<std::mutex> lock(m);
+            size_t count = 0;
+            for(auto &entry : entries) {
+                if(!entry.second.expired()) {
+                    count++;
+                }
+            }
+            return count;
+        }
+
+        /*
+         * Returns the process-wide cache.
+         */
+        static RingGeometryCache &Default() {
+            static RingGeometryCache cache;
+            return cache;
+        }
+    };
+}
+
+#endif
@@ -11,9 +11,12 @@
 #include "../common/ringProcessor.hpp"
 #include "../imgproc/planarCorrelator.hpp"
 #include "../common/static_timer.hpp"
+#include "../common/threadPool.hpp"
+#include "../common/bufferPool.hpp"
 #include "ringStitcher.hpp"
 #include "dynamicSeamer.hpp"
 #include "flowBlender.hpp"
+#include "ringGeometryCache.hpp"
 
 using namespace std;
 using namespace cv;
@@ -28,6 +31,8 @@ struct FlowImage {
     Mat image;
     Mat flow;
     int id;
+    // Valid if the flow is calculated asynchronously. 
+    std::shared_future<void> flowReady;
 };
 
 typedef shared_ptr<FlowImage> FlowImageP;
@@ -56,24 +61,30 @@ private:
     //cv::Ptr<cv::detail::Blender> blender;
     cv::Ptr<cv::detail::RotationWarper> warper;
     cv::Ptr<cv::WarperCreator> warperFactory;
-    std::vector<cv::Point> corners;
-    std::vector<cv::Size> warpedSizes;
-    cv::UMat uxmap, uymap;
-    cv::Rect resultRoi;
-    cv::Rect dstRoi;
-    cv::Rect coreRoi;
+    RingGeometryP geometry;
     RingProcessor<FlowImageP> queue;
-    cv::Mat warpedMask;
-    cv::Mat K;
 
     FlowBlender blender;
 
+    // Buffers for warped images, re-used as soon as an image was fed. 
+    BufferPool warpPool;
+
     cv::Size initialSize;
 
+    bool pipelined;
+    // Declared last, so pending flow calculations finish before
+    // anything they access is destroyed. 
+    std::unique_ptr<ThreadPool> flowWorker;
+
     //Stitcher feed function.
     void Feed(const FlowImageP &in) {
         STimer feedTimer;
 
+        if(in->flowReady.valid()) {
+            in->flowReady.get();
+            feedTimer.Tick("Flow Awaited");
+        }
+
         if(debug) {
             imwrite("dbg/feed_" + ToString(in->id) + ".jpg", in->image);
         }
@@ -82,7 +93,7 @@ private:
         //in->image.data.convertTo(warpedImageAsShort, CV_16S);
 
         Rect imageRoi(in->corner, in->image.size());
-        Rect overlap = imageRoi & resultRoi;
+        Rect overlap = imageRoi & geometry->resultRoi;
 
         Rect overlapI(0, 0, overlap.width, overlap.height);
         if(overlap.width == imageRoi.width) {
@@ -94,7 +105,7 @@ private:
                     in->flow(overlapI), 
                     overlap.tl());
 
-            Rect other(resultRoi.x, overlap.y, 
+            Rect other(geometry->resultRoi.x, overlap.y, 
                     imageRoi.width - overlap.width, overlap.height);
             Rect otherI(overlap.width, 0, other.width, other.height);
             blender.Feed(in->image(otherI), 
@@ -113,18 +124,37 @@ private:
 
         Log << "Flow calculation: " << a->id << " <> " << b->id;
 
-        blender.CalculateFlow(a->image, b->image, a->corner, b->corner, b->flow);
-        return;
+        if(!pipelined) {
+            CalculateFlow(a, b);
+            return;
+        }
+
+        // The flow only depends on the warped images, so it is calculated
+        // while the previous image is fed. Since the ring processor feeds a 
+        // after b was pushed, at most two flows are pending at any time. 
+        b->flowReady = flowWorker->Push([this, a, b] () { 
+                CalculateFlow(a, b); 
+            }).share();
     };
+
+    //Calculates the flow of b, relative to a.
+    void CalculateFlow(const FlowImageP &a,
+            const FlowImageP &b) {
+        // Local offset, since flows might be calculated concurrently. 
+        Point offset(0, 0);
+        blender.CalculateFlow(a->image, b->image, a->corner, b->corner, b->flow, offset);
+    }
     public:
     Impl(
             const InputImageP img, vector<Mat> rotations,
-            float warperScale, bool useFlow) :
+            float warperScale, bool useFlow, FlowEngineP flowEngine, bool pipelined) :
         queue(1, 
             std::bind(&Impl::FindSeams, this,
                 std::placeholders::_1, std::placeholders::_2), 
             std::bind(&Impl::Feed, this, std::placeholders::_1)),
-        blender(0.005, useFlow) {
+        blender(0.005, useFlow, flowEngine),
+        pipelined(pipelined),
+        flowWorker(pipelined ? new ThreadPool(1) : nullptr) {
         STimer timer; 
         timer.Tick("Async Preperation");
         
@@ -132,67 +162,18 @@ private:
         
         AssertGT(n, (size_t)0);
 
-        corners.resize(n);
-        warpedSizes.resize(n);
-
         warperFactory = new cv::SphericalWarper();
         warper = warperFactory->create(static_cast<float>(warperScale));
 
-        Mat scaledK;
-        ScaleIntrinsicsToImage(img->intrinsics, img->image, scaledK);
-        From3DoubleTo3Float(scaledK, K);
-
         initialSize = img->image.size();
 
-        // Calulate result ROI
-        for(size_t i = 0; i < n; i++) {
-            Mat R;
-            From3DoubleTo3Float(rotations[i], R); 
-            //Warping
-            Rect roi = warper->warpRoi(img->image.size(), K, R);
-            corners[i] = Point(roi.x, roi.y);
-            warpedSizes[i] = Size(roi.width, roi.height);
-
-            rotations[i] = R;
-        }
-
-        //Prepare global masks and distortions. 
-        const Mat &R = rotations[0];
-        
-        dstRoi = GetOuterRectangle(*warper, K, R, img->image.size());
-        coreRoi = GetInnerRectangle(*warper, K, R, img->image.size());
-
-        // Update result ROI
-        resultRoi = cv::detail::resultRoi(corners, warpedSizes);
-        resultRoi = Rect(resultRoi.x, resultRoi.y + (coreRoi.y - dstRoi.y),
-                         resultRoi.width, 
-                         coreRoi.height);
-        
-        coreRoi = Rect(coreRoi.x + 1, coreRoi.y + 1, coreRoi.width - 1, coreRoi.height - 1);
-        
-        Log << "Destinatin ROI: " << dstRoi;
-        Log << "Result ROI: " << resultRoi;
-        Log << "Core ROI: " << coreRoi;
-        Log << "Dest ROI: " << dstRoi;
-
-        Log << "Warping K: " << K;
-        Log << "Warping R: " << R; 
+        // Left and right stitchers of a ring share their geometry. 
+        geometry = RingGeometryCache::Default().Get(img->intrinsics, 
+                initialSize, warperScale, rotations);
 
+        timer.Tick("Geometry Prepared");
 
-        blender.Prepare(resultRoi);
-
-
-        warper->buildMaps(img->image.size(), K, R, uxmap, uymap);
-        coreRoi = Rect(coreRoi.tl() - dstRoi.tl(), coreRoi.size() - Size(1, 1));
-
-        warpedMask = Mat(dstRoi.size(), CV_8U, Scalar::all(0));
-        {
-            Log << "Warped mask size: " << warpedMask.size();
-            Mat mask = Mat(img->image.rows, img->image.cols, CV_8U, Scalar::all(255));
-            remap(mask, warpedMask, uxmap, uymap, INTER_NEAREST, BORDER_CONSTANT); 
-            warpedMask = warpedMask(coreRoi);
-            mask.release();
-        }
+        blender.Prepare(geometry->resultRoi);
     }
 
     void Push(const InputImageP img) {
@@ -217,14 +198,14 @@ private:
         From3DoubleTo3Float(img->adjustedExtrinsics, R);
         
         //Image Warping
-        Mat warpedImage(dstRoi.size(), CV_8UC3);
-        remap(img->image.data, warpedImage, uxmap, uymap, 
+        Mat warpedImage = warpPool.Create(geometry->coreRoi.size(), CV_8UC3);
+        remap(img->image.data, warpedImage, geometry->xymap, geometry->interpolationMap, 
                 INTER_LINEAR, BORDER_CONSTANT); 
-        res->image = warpedImage(coreRoi);
+        res->image = warpedImage;
         res->id = img->id;
       
         //Calculate Image Position (without wrapping around)
-        Rect roi = GetInnerRectangle(*warper, K, R, img->image.size());
+        Rect roi = GetInnerRectangle(*warper, geometry->K, R, img->image.size());
         Point bl = roi.tl() - Point(0, roi.height);
         Point tl = roi.tl();
 
@@ -285,6 +266,8 @@ private:
         warper.release();
         warperFactory.release();
 
+        const vector<Point> &corners = geometry->corners;
+
         res->corner.x = corners[0].x;
         res->corner.y = corners[0].y + correction;
         res->seamed = false;
@@ -300,17 +283,18 @@ private:
 };
 
 AsyncRingStitcher::AsyncRingStitcher(std::vector<cv::Mat> rotations, 
-        float warperScale, bool useFlow) :
+        float warperScale, bool useFlow, FlowEngineP flowEngine, bool pipelined) :
     pimpl_(NULL),
     warperScale(warperScale),
-    rotations(rotations), useFlow(useFlow) {
+    rotations(rotations), useFlow(useFlow), flowEngine(flowEngine), 
+    pipelined(pipelined) {
         AssertFalseInProduction(debug);        
 }
 
 void AsyncRingStitcher::Push(const InputImageP image) {
 
     if(pimpl_ == NULL) {   
-        pimpl_ = new Impl(image, rotations, warperScale, useFlow);
+        pimpl_ = new Impl(image, rotations, warperScale, useFlow, flowEngine, pipelined);
     }
     pimpl_->Push(image); 
 }
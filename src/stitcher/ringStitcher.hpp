@@ -10,6 +10,7 @@
 #include "../recorder/exposureCompensator.hpp"
 #include "../math/support.hpp"
 #include "../io/checkpointStore.hpp"
+#include "flowEngine.hpp"
 
 #ifndef OPTONAUT_RSTITCHER_HEADER
 #define OPTONAUT_RSTITCHER_HEADER
@@ -28,6 +29,8 @@ class AsyncRingStitcher : public ImageSink {
     float warperScale;
     std::vector<cv::Mat> rotations;
     bool useFlow;
+    FlowEngineP flowEngine;
+    bool pipelined;
 
     public:
 
@@ -40,9 +43,13 @@ class AsyncRingStitcher : public ImageSink {
      *                  are going to be pushed, but they need to cover the same area on the panorama. 
      * @param warperScale Scale of the warper. See openCV docs for explaination. 
      * @param useFlow Indicates wether to use flow or linear blending. 
+     * @param flowEngine The flow algorithm to use. If null, the default engine is used. 
+     * @param pipelined If true, flows are calculated on a worker thread, while
+     *                  previous images are blended. The result is the same. 
      */
     AsyncRingStitcher(std::vector<cv::Mat> rotations, float warperScale = 300, 
-                bool useFlow = true);
+                bool useFlow = true, FlowEngineP flowEngine = nullptr, 
+                bool pipelined = true);
 
     /*
      * Pushes an image and adds it to the result. 
@@ -78,13 +85,23 @@ class AsyncRingStitcher : public ImageSink {
  * and with a progress callback. 
  */
 class RingStitcher {
+    private:
+    FlowEngineP flowEngine;
+
 	public:
+    /*
+     * Creates a new ring stitcher. 
+     *
+     * @param flowEngine The flow algorithm to use. If null, the default engine is used. 
+     */
+    RingStitcher(FlowEngineP flowEngine = nullptr) : flowEngine(flowEngine) { }
+
     StitchingResultP Stitch(const std::vector<InputImageP> &images, ProgressCallback &progress, bool useFlow = true) {
 
         std::vector<Mat> rotations = fun::map<InputImageP, Mat>(images, 
                 [](const InputImageP &i) { return i->adjustedExtrinsics; }); 
 
-        AsyncRingStitcher core(rotations, GetWarperScale(), useFlow);
+        AsyncRingStitcher core(rotations, GetWarperScale(), useFlow, flowEngine);
 
         //TODO: Place all IO, exposure compensation and so on here. 
 
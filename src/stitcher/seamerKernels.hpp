@@ -0,0 +1,151 @@
+/*
+ * Row kernels for the dynamic seamer.
+ *
+ * All kernels work on contiguous rows in seam space, that is, the seam runs
+ * from the first to the last row. The SIMD paths are selected at compile time
+ * (SSE4.1, also used when compiling for AVX2), otherwise a scalar fallback is used.
+ * x86 builds enable SSE4.1 by default (BUILD_SSE41). ARM builds are scalar.
+ * Both paths produce bit-identical results.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#include <smmintrin.h>
+#endif
+
+#ifndef OPTONAUT_SEAMER_KERNELS_HEADER
+#define OPTONAUT_SEAMER_KERNELS_HEADER
+
+namespace optonaut {
+namespace kernels {
+
+    namespace scalar {
+        inline void SeamCostRow(const uint8_t *a, const uint8_t *b,
+                const uint8_t *ma, const uint8_t *mb, float *cost, int n) {
+            for(int i = 0; i < n; i++, a += 3, b += 3) {
+                float d0 = (float)a[0] - (float)b[0];
+                float d1 = (float)a[1] - (float)b[1];
+                float d2 = (float)a[2] - (float)b[2];
+                float c = 255 - std::sqrt((d0 * d0 + d1 * d1 + d2 * d2) / 9.f);
+                cost[i] = ma[i] != 0 && mb[i] != 0 ? c : 0;
+            }
+        }
+    }
+
+    /*
+     * Calculates the inverse seam cost of n BGR pixels, that is 255 minus
+     * the RMS difference of both images, or zero where one of the masks is not set.
+     */
+    inline void SeamCostRow(const uint8_t *a, const uint8_t *b,
+            const uint8_t *ma, const uint8_t *mb, float *cost, int n) {
+        int i = 0;
+#if defined(__SSE4_1__) || defined(__AVX2__)
+        const __m128i toBGR0 = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 nine = _mm_set1_ps(9);
+        const __m128 white = _mm_set1_ps(255);
+
+        // The 16 byte loads read four bytes past the fourth pixel.
+        for(; i + 6 <= n; i += 4) {
+            __m128i va = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(a + i * 3)), toBGR0);
+            __m128i vb = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(b + i * 3)), toBGR0);
+            __m128i d0 = _mm_sub_epi16(_mm_cvtepu8_epi16(va), _mm_cvtepu8_epi16(vb));
+            __m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+            __m128i ssd = _mm_hadd_epi32(_mm_madd_epi16(d0, d0), _mm_madd_epi16(d1, d1));
+
+            __m128 c = _mm_sub_ps(white, _mm_sqrt_ps(_mm_div_ps(_mm_cvtepi32_ps(ssd), nine)));
+
+            int32_t m0, m1;
+            memcpy(&m0, ma + i, 4);
+            memcpy(&m1, mb + i, 4);
+            __m128i invalid = _mm_or_si128(
+                    _mm_cmpeq_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(m0)), zero),
+                    _mm_cmpeq_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(m1)), zero));
+
+            _mm_storeu_ps(cost + i, _mm_andnot_ps(_mm_castsi128_ps(invalid), c));
+        }
+#endif
+        scalar::SeamCostRow(a + i * 3, b + i * 3, ma + i, mb + i, cost + i, n - i);
+    }
+
+    /*
+     * Single step of the seam path search. Picks the best of the three
+     * predecessors, preferring the straight one, then the left one.
+     */
+    inline void SeamPathStep(const float *prev, float *cost, uint8_t *path,
+            int x, bool hasLeft, bool hasRight) {
+        float best = prev[x];
+        uint8_t dir = 1;
+
+        if(hasLeft && prev[x - 1] > best) {
+            best = prev[x - 1];
+            dir = 0;
+        }
+        if(hasRight && prev[x + 1] > best) {
+            best = prev[x + 1];
+            dir = 2;
+        }
+
+        cost[x] += best;
+        path[x] = dir;
+    }
+
+    /*
+     * Accumulates the inverse cost of the best path into cost for all
+     * x in [from, to) and stores the direction of the predecessor (0 for left,
+     * 1 for straight, 2 for right) in path.
+     * Predecessors are only taken from [begin, end).
+     */
+    inline void SeamPathRow(const float *prev, float *cost, uint8_t *path,
+            int from, int to, int begin, int end) {
+        int x = from;
+
+        // Left border.
+        for(; x < to && x <= begin; x++) {
+            SeamPathStep(prev, cost, path, x, x > begin, x + 1 < end);
+        }
+
+        const int inner = std::min(to, end - 1);
+#if defined(__SSE4_1__) || defined(__AVX2__)
+        const __m128i straight = _mm_set1_epi32(1);
+        const __m128i right = _mm_set1_epi32(2);
+        const __m128i zero = _mm_setzero_si128();
+
+        for(; x + 4 <= inner; x += 4) {
+            __m128 l = _mm_loadu_ps(prev + x - 1);
+            __m128 c = _mm_loadu_ps(prev + x);
+            __m128 r = _mm_loadu_ps(prev + x + 1);
+
+            __m128 takeLeft = _mm_cmpgt_ps(l, c);
+            __m128 best = _mm_blendv_ps(c, l, takeLeft);
+            __m128 takeRight = _mm_cmpgt_ps(r, best);
+            best = _mm_blendv_ps(best, r, takeRight);
+
+            _mm_storeu_ps(cost + x, _mm_add_ps(_mm_loadu_ps(cost + x), best));
+
+            __m128i dir = _mm_andnot_si128(_mm_castps_si128(takeLeft), straight);
+            dir = _mm_blendv_epi8(dir, right, _mm_castps_si128(takeRight));
+            dir = _mm_packus_epi16(_mm_packs_epi32(dir, zero), zero);
+
+            int32_t packed = _mm_cvtsi128_si32(dir);
+            memcpy(path + x, &packed, 4);
+        }
+#endif
+        for(; x < inner; x++) {
+            SeamPathStep(prev, cost, path, x, true, true);
+        }
+
+        // Right border.
+        for(; x < to; x++) {
+            SeamPathStep(prev, cost, path, x, x > begin, x + 1 < end);
+        }
+    }
+}
+}
+
+#endif
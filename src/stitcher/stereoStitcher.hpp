@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "../common/progressCallback.hpp"
+#include "../common/memoryBudget.hpp"
+#include "../common/threadPool.hpp"
+#include "../io/checkpointStore.hpp"
+
+#include "stitcher.hpp"
+
+#ifndef OPTONAUT_STEREO_STITCHER_HEADER
+#define OPTONAUT_STEREO_STITCHER_HEADER
+
+namespace optonaut {
+
+    /*
+     * Stitches the left and the right eye of a recording concurrently.
+     *
+     * The ring adjustment is calculated once, by the left eye, and re-used by
+     * the right eye, like when stitching the eyes one after the other. Ring 
+     * stitching and final blending of both eyes share one memory budget.
+     */
+    class StereoStitcher {
+
+    private:
+        Stitcher leftStitcher;
+        Stitcher rightStitcher;
+        const size_t threads;
+        const size_t memoryLimit;
+
+        StitchingResultP leftResult;
+        StitchingResultP rightResult;
+
+        /*
+         * Returns the count of rings each eye may stitch at the same time, 
+         * so both eyes together stay within the thread budget. 
+         */
+        static size_t RingsPerEye(size_t threads) {
+            return std::max((size_t)1, threads / 2);
+        }
+
+    public:
+        /*
+         * Creates a new stereo stitcher.
+         *
+         * @param threads The count of rings stitched at the same time. Both eyes
+         *                run concurrently if possible, the remaining threads are split
+         *                between the rings of each eye. With one thread, the eyes are 
+         *                stitched one after the other. 
+         *                Each ring additionally uses the flow pipeline of the ring stitcher.
+         * @param memoryLimit The memory available to both eyes, in bytes.
+         */
+        StereoStitcher(CheckpointStore &leftStore, CheckpointStore &rightStore,
+                size_t threads = 2, size_t memoryLimit = 512 * 1024 * 1024) :
+            leftStitcher(leftStore, RingsPerEye(threads)), 
+            rightStitcher(rightStore, RingsPerEye(threads)),
+            threads(threads), memoryLimit(memoryLimit) {
+            AssertGT(threads, (size_t)0);
+        }
+
+        StereoStitcher(int width, int height,
+                CheckpointStore &leftStore, CheckpointStore &rightStore,
+                size_t threads = 2, size_t memoryLimit = 512 * 1024 * 1024) :
+            leftStitcher(width, height, leftStore, RingsPerEye(threads)), 
+            rightStitcher(width, height, rightStore, RingsPerEye(threads)),
+            threads(threads), memoryLimit(memoryLimit) {
+            AssertGT(threads, (size_t)0);
+        }
+
+        /*
+         * Stitches both eyes. Blocks until both results are available.
+         */
+        void Finish(ProgressCallback &progress, std::string debugName = "") {
+            auto adjustment = std::make_shared<SharedRingAdjustment>();
+            auto budget = std::make_shared<MemoryBudget>(memoryLimit);
+
+            ProgressCallbackAccumulator progressCallbacks(progress, { 0.5f, 0.5f });
+            ProgressCallback &leftCallback = progressCallbacks.At(0);
+            ProgressCallback &rightCallback = progressCallbacks.At(1);
+
+            const std::string leftName = debugName == "" ? "" : debugName + "_left";
+            const std::string rightName = debugName == "" ? "" : debugName + "_right";
+
+            auto stitchLeft = [&] () {
+                leftResult = leftStitcher.Finish(leftCallback, leftName, adjustment, budget);
+                adjustment->Release();
+            };
+            auto stitchRight = [&] () {
+                rightResult = rightStitcher.Finish(rightCallback, rightName, adjustment, budget, false);
+            };
+
+            if(threads == 1) {
+                stitchLeft();
+                stitchRight();
+            } else {
+                // Right eye on a worker, left eye on the calling thread.
+                ThreadPool worker(1);
+                auto right = worker.Push(stitchRight);
+                stitchLeft();
+                right.get();
+            }
+        }
+
+        StitchingResultP GetLeftResult() {
+            return leftResult;
+        }
+
+        StitchingResultP GetRightResult() {
+            return rightResult;
+        }
+    };
+}
+
+#endif
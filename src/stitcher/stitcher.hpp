@@ -22,15 +22,29 @@ namespace optonaut {
         MultiRingStitcher core;
     public:
 
-        Stitcher(CheckpointStore &store) :
-            store(store), core(store) {
+        /*
+         * @param concurrentRings The maximum count of rings stitched at the same time.
+         */
+        Stitcher(CheckpointStore &store, size_t concurrentRings = 1) :
+            store(store), core(store, concurrentRings) {
         }
         
-        Stitcher(int width, int height, CheckpointStore &store) :
-            store(store), core(width, height, store) {
+        Stitcher(int width, int height, CheckpointStore &store, size_t concurrentRings = 1) :
+            store(store), core(width, height, store, concurrentRings) {
         }
 
-        StitchingResultP Finish(ProgressCallback &progress, std::string debugName = "") {
+        /*
+         * Stitches the recording in the store, or loads the result if it was stitched before.
+         *
+         * @param sharedAdjustment Ring adjustment shared with other stitchers, optional.
+         * @param memoryBudget Memory budget shared with other stitchers, optional.
+         * @param producesAdjustment If false, waits for the shared adjustment instead of
+         *                           calculating it. 
+         */
+        StitchingResultP Finish(ProgressCallback &progress, std::string debugName = "",
+                SharedRingAdjustmentP sharedAdjustment = nullptr,
+                MemoryBudgetP memoryBudget = nullptr,
+                bool producesAdjustment = true) {
             vector<vector<InputImageP>> rings;
             ExposureCompensator exposure;
             map<size_t, double> gains;
@@ -53,7 +67,8 @@ namespace optonaut {
             
             cout << "Stitching " << endl;
             
-            core.InitializeForStitching(rings, exposure, 0.4);
+            core.InitializeForStitching(rings, exposure, 0.4, sharedAdjustment, memoryBudget, 
+                    producesAdjustment);
             res = core.Stitch(progress, debugName);
 
             // Debugging Code. 
@@ -13,6 +13,7 @@
 #include "common/backtrace.hpp"
 #include "common/drawing.hpp"
 #include "stitcher/stitcher.hpp"
+#include "stitcher/stereoStitcher.hpp"
 #include "stitcher/globalAlignment.hpp"
 #include "io/io.hpp"
 #include "recorder/recorder2.hpp"
@@ -145,11 +146,11 @@ void Record(vector<string> &files) {
     recorder->Finish();
 #ifdef USE_THREE_RING
     // Motor
-    optonaut::Stitcher leftStitcher(leftStore);
-    optonaut::Stitcher rightStitcher(rightStore);
+    StereoStitcher stitcher(leftStore, rightStore);
+    stitcher.Finish(ProgressCallback::Empty);
 
-    auto left = leftStitcher.Finish(ProgressCallback::Empty);
-    auto right = rightStitcher.Finish(ProgressCallback::Empty);
+    auto left = stitcher.GetLeftResult();
+    auto right = stitcher.GetRightResult();
 #else
 
     // 1 ring
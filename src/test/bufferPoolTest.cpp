@@ -0,0 +1,63 @@
+#include "../common/assert.hpp"
+#include "../common/bufferPool.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+int main(int, char**) {
+    BufferPool pool;
+
+    {
+        Mat a = pool.Create(Size(640, 480), CV_8UC3);
+        a.setTo(Scalar::all(7));
+        AssertEQ(pool.GetAllocationCount(), (size_t)1);
+    }
+
+    AssertGT(pool.GetFreeBytes(), (size_t)0);
+
+    {
+        // Same bucket, memory is re-used. 
+        Mat b = pool.Create(Size(638, 480), CV_8UC3);
+        AssertEQ(pool.GetAllocationCount(), (size_t)1);
+        AssertEQ(pool.GetReuseCount(), (size_t)1);
+
+        // Buffer is in use, so a new one is needed. 
+        Mat c = pool.Create(Size(640, 480), CV_8UC3);
+        AssertEQ(pool.GetAllocationCount(), (size_t)2);
+
+        // Re-allocation by OpenCV stays in the pool. 
+        Mat d = pool.Create(Size(16, 16), CV_8UC3);
+        AssertEQ(pool.GetAllocationCount(), (size_t)3);
+        d.create(Size(640, 480), CV_8UC3);
+        AssertEQ(pool.GetAllocationCount(), (size_t)4);
+    }
+
+    // Steady state - no further allocations after the first iteration. 
+    size_t allocations = 0;
+    for(int i = 0; i < 10; i++) {
+        Mat a = pool.Create(Size(640, 480), CV_8UC3);
+        Mat b = pool.Create(Size(640, 480), CV_32F);
+        b.setTo(Scalar::all(0));
+
+        if(i == 0) {
+            allocations = pool.GetAllocationCount();
+        }
+    }
+    AssertEQ(pool.GetAllocationCount(), allocations);
+
+    pool.Clear();
+    AssertEQ(pool.GetFreeBytes(), (size_t)0);
+
+    // Matrices may outlive their pool. 
+    Mat survivor;
+    {
+        BufferPool shortLived;
+        survivor = shortLived.Create(Size(32, 32), CV_8UC1);
+        survivor.setTo(Scalar::all(1));
+    }
+    AssertEQ(sum(survivor)[0], 32.0 * 32.0);
+    survivor.release();
+
+    cout << "[\u2713] Buffer pool module." << endl;
+}
@@ -0,0 +1,111 @@
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../io/io.hpp"
+#include "../io/cachingCheckpointStore.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+StitchingResultP CreateRing(int id, int width, int height) {
+    auto ring = make_shared<StitchingResult>();
+    ring->id = id;
+    ring->corner = Point(id, 2 * id);
+    ring->seamed = false;
+    ring->image = Image(Mat(height, width, CV_8UC3));
+    ring->mask = Image(Mat(height, width, CV_8U));
+    randu(ring->image.data, Scalar::all(0), Scalar::all(255));
+    randu(ring->mask.data, Scalar::all(0), Scalar::all(255));
+    return ring;
+}
+
+int main(int, char**) {
+    const string base = "tmp/caching-checkpoint-store-test/";
+    DeleteDirectories(base);
+
+    const size_t imageBytes = 64 * 48 * 3;
+    CachingCheckpointStore store(base + "store/", base + "shared/", 3 * imageBytes);
+
+    // Rectified images are written through, the most recent ones stay cached.
+    vector<InputImageP> images;
+    vector<Mat> expected;
+    for(int i = 0; i < 5; i++) {
+        auto image = CreateImage(i, 64, 48);
+        expected.push_back(image->image.data.clone());
+        store.SaveRectifiedImage(image);
+        image->image.Unload();
+        images.push_back(image);
+
+        AssertGEM(3 * imageBytes, store.GetUsedBytes(), "Cache stays within budget");
+        AssertM(FileExists(image->image.source), "Rectified image is written through");
+    }
+
+    AssertM(!store.IsCached(images[1]->image.source), "Least recently used image is evicted");
+    AssertM(store.IsCached(images[2]->image.source), "Recent image is cached");
+
+    for(size_t i = 0; i < images.size(); i++) {
+        images[i]->image.Load();
+        AssertEqual(images[i]->image.data, expected[i], "Image is restored");
+        images[i]->image.Unload();
+    }
+
+    // Rings are held in memory and only written when spilled.
+    auto ring = CreateRing(0, 32, 16);
+    Mat ringImage = ring->image.data.clone();
+    Mat ringMask = ring->mask.data.clone();
+
+    store.SaveRing(0, ring);
+    ring->image.Unload();
+    ring->mask.Unload();
+
+    AssertM(store.IsCached(ring->image.source), "Ring is cached");
+    AssertM(!FileExists(ring->image.source), "Cached ring is not written");
+
+    ring->mask.Load(IMREAD_GRAYSCALE);
+    AssertEqual(ring->mask.data, ringMask, "Mask is loaded from cache");
+
+    // Seaming changes the mask after the image was unloaded.
+    randu(ring->mask.data, Scalar::all(0), Scalar::all(255));
+    ringMask = ring->mask.data.clone();
+    ring->seamed = true;
+    store.SaveRingMask(0, ring);
+    ring->mask.Unload();
+
+    AssertM(store.IsCached(ring->image.source), "Ring image stays cached");
+
+    // Saving more images spills the ring.
+    for(int i = 5; i < 8; i++) {
+        auto image = CreateImage(i, 64, 48);
+        store.SaveRectifiedImage(image);
+    }
+
+    AssertM(!store.IsCached(ring->image.source), "Ring is spilled");
+    AssertM(FileExists(ring->image.source), "Spilled ring image is written");
+    AssertM(FileExists(ring->mask.source), "Spilled ring mask is written");
+
+    auto loaded = store.LoadRing(0);
+    AssertM(loaded != NULL, "Spilled ring can be loaded");
+    AssertEQM(loaded->corner, ring->corner, "Corner is restored");
+    AssertM(loaded->seamed, "Seamed flag is restored");
+    loaded->image.Load();
+    loaded->mask.Load(IMREAD_GRAYSCALE);
+    AssertEqual(loaded->image.data, ringImage, "Ring image is restored");
+    AssertEqual(loaded->mask.data, ringMask, "Ring mask is restored");
+
+    // Writing back keeps rings cached, but makes them resumable.
+    auto other = CreateRing(1, 16, 8);
+    store.SaveRing(1, other);
+    AssertM(store.LoadRing(1) == NULL, "Cached ring can not be resumed");
+    store.WriteBack();
+    AssertM(store.IsCached(other->image.source), "Written ring stays cached");
+    AssertM(store.LoadRing(1) != NULL, "Written ring can be resumed");
+
+    store.Clear();
+    AssertEQM(store.GetUsedBytes(), (size_t)0, "Clearing empties the cache");
+
+    DeleteDirectories(base);
+
+    cout << "[\u2713] CachingCheckpointStore module." << endl;
+}
@@ -0,0 +1,92 @@
+#include <vector>
+#include <map>
+#include <cstdio>
+
+#include "../common/assert.hpp"
+#include "../io/io.hpp"
+#include "../io/checkpointStore.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+void AssertRingsRestored(const vector<vector<InputImageP>> &expected,
+        const vector<vector<InputImageP>> &loaded) {
+    AssertEQM(loaded.size(), expected.size(), "Ring count is restored");
+
+    for(size_t i = 0; i < expected.size(); i++) {
+        AssertEQM(loaded[i].size(), expected[i].size(), "Ring size is restored");
+
+        for(size_t j = 0; j < expected[i].size(); j++) {
+            auto a = expected[i][j];
+            auto b = loaded[i][j];
+
+            AssertEQM(b->id, a->id, "Image order is restored");
+            AssertM(!b->image.IsLoaded(), "Image data is not loaded");
+            AssertEQM(b->image.size(), a->image.size(), "Image size is restored");
+            AssertEQM(b->intrinsics.at<double>(0, 0), a->intrinsics.at<double>(0, 0),
+                    "Intrinsics are restored");
+            AssertEQM(b->adjustedExtrinsics.at<double>(1, 1), a->adjustedExtrinsics.at<double>(1, 1),
+                    "Extrinsics are restored");
+
+            b->image.Load();
+            Mat diff;
+            absdiff(b->image.data, a->image.data, diff);
+            AssertEQM(countNonZero(diff.reshape(1)), 0, "Image data is restored");
+            b->image.Unload();
+        }
+    }
+}
+
+int main(int, char**) {
+    const string base = "tmp/checkpoint-store-test/";
+    DeleteDirectories(base);
+
+    CheckpointStore store(base + "store/", base + "shared/", MappedImageExtension);
+
+    // Rings are not sorted by id.
+    vector<vector<InputImageP>> rings(3);
+    for(int i = 0; i < 24; i++) {
+        auto image = CreateImage(23 - i, 32, 24);
+        // Distinct matrices, so mixed up images are detected.
+        image->intrinsics *= image->id + 1;
+        image->adjustedExtrinsics *= image->id + 2;
+        rings[(i * 7) % 3].push_back(image);
+    }
+    map<size_t, double> exposure;
+
+    for(auto &ring : rings) {
+        for(auto &image : ring) {
+            store.SaveRectifiedImage(image);
+        }
+    }
+    store.SaveStitcherInput(rings, exposure);
+
+    vector<vector<InputImageP>> loaded;
+
+    // Recordings without index are restored from the image data files.
+    AssertEQM(remove((base + "store/images.json").c_str()), 0, "Index is removed");
+    store.LoadStitcherInput(loaded, exposure);
+    AssertRingsRestored(rings, loaded);
+
+    // With index, the image data files are not needed. The index holds the 
+    // metadata as written to the data files, not later adjustments. 
+    Mat adjusted = rings[0][0]->adjustedExtrinsics;
+    rings[0][0]->adjustedExtrinsics = adjusted * 3;
+    store.SaveStitcherInput(rings, exposure);
+    rings[0][0]->adjustedExtrinsics = adjusted;
+    for(auto &ring : rings) {
+        for(auto &image : ring) {
+            const string &source = image->image.source;
+            const string dataFile = source.substr(0, source.length() - 4) + ".json";
+            AssertEQM(remove(dataFile.c_str()), 0, "Data file is removed");
+        }
+    }
+    store.LoadStitcherInput(loaded, exposure);
+    AssertRingsRestored(rings, loaded);
+
+    DeleteDirectories(base);
+
+    cout << "[\u2713] CheckpointStore module." << endl;
+}
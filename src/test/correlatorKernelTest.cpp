@@ -0,0 +1,119 @@
+#include <vector>
+#include <random>
+#include "../imgproc/correlatorKernels.hpp"
+#include "../imgproc/planarCorrelator.hpp"
+#include "../common/assert.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Compares the row kernels against the scalar implementation
+ * for all row lengths around the SIMD block boundaries.
+ */
+void TestRowKernels() {
+    const int maxSamples = 40;
+    const int length = maxSamples * kernels::BGRSampleStride;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    vector<uint8_t> a(length), b(length);
+
+    for(int i = 0; i < length; i++) {
+        a[i] = (uint8_t)dist(rng);
+        b[i] = (uint8_t)dist(rng);
+    }
+
+    for(int n = 0; n <= maxSamples; n++) {
+        // Rows end exactly at the buffer end, so we notice overreads
+        // when running under a memory checker.
+        const uint8_t *pa = a.data() + (maxSamples - n) * kernels::BGRSampleStride;
+        const uint8_t *pb = b.data() + (maxSamples - n) * kernels::BGRSampleStride;
+
+        AssertEQ(kernels::SquaredDifferenceBGR(pa, pb, n),
+                kernels::scalar::SquaredDifferenceBGR(pa, pb, n));
+        AssertEQ(kernels::AbsoluteDifferenceBGR(pa, pb, n),
+                kernels::scalar::AbsoluteDifferenceBGR(pa, pb, n));
+        AssertEQ(kernels::DifferenceBGR(pa, pb, n),
+                kernels::scalar::DifferenceBGR(pa, pb, n));
+        AssertEQ(kernels::SumBGR(pa, n),
+                kernels::scalar::SumBGR(pa, n));
+        AssertEQ(kernels::SquaredDifferenceBGRInt(pa, pb, n),
+                kernels::scalar::SquaredDifferenceBGRInt(pa, pb, n));
+        AssertEQ(kernels::AbsoluteDifferenceBGRInt(pa, pb, n),
+                kernels::scalar::AbsoluteDifferenceBGRInt(pa, pb, n));
+
+        // Integer and float kernels are both exact for these sums.
+        AssertEQ((float)kernels::SquaredDifferenceBGRInt(pa, pb, n),
+                kernels::scalar::SquaredDifferenceBGR(pa, pb, n));
+
+        if(n > 0) {
+            const uint8_t *ga = a.data() + length - ((n - 1) * kernels::GraySampleStride + 1);
+            const uint8_t *gb = b.data() + length - ((n - 1) * kernels::GraySampleStride + 1);
+
+            AssertEQ(kernels::SquaredDifferenceGray(ga, gb, n),
+                    kernels::scalar::SquaredDifferenceGray(ga, gb, n));
+            AssertEQ(kernels::AbsoluteDifferenceGray(ga, gb, n),
+                    kernels::scalar::AbsoluteDifferenceGray(ga, gb, n));
+        }
+    }
+}
+
+/*
+ * Compares the row-based correlation against the pixel-based one,
+ * also on non-continuous (ROI) images.
+ */
+template <typename ErrorMetric>
+void TestCorrelationSum(const Mat &a, const Mat &b) {
+    for(int dy = -5; dy <= 5; dy++) {
+        for(int dx = -7; dx <= 7; dx++) {
+            int sx = max(0, -dx);
+            int ex = min(a.cols, b.cols - dx);
+            int sy = max(0, -dy);
+            int ey = min(a.rows, b.rows - dy);
+
+            float expected = CorrelationSum<ErrorMetric, false>::
+                Calculate(a, b, dx, dy, sx, ex, sy, ey);
+            float actual = CorrelationSum<ErrorMetric, true>::
+                Calculate(a, b, dx, dy, sx, ex, sy, ey);
+
+            AssertM(abs(expected - actual) <= abs(expected) * 1e-4 + 1e-3,
+                    "Row kernel matches pixel-wise metric");
+        }
+    }
+}
+
+int main(int, char**) {
+    TestRowKernels();
+
+    Mat fullA(40, 64, CV_8UC3), fullB(40, 64, CV_8UC3);
+    randu(fullA, Scalar::all(0), Scalar::all(255));
+    randu(fullB, Scalar::all(0), Scalar::all(255));
+
+    Mat a = fullA(Rect(3, 2, 47, 31));
+    Mat b = fullB(Rect(5, 4, 50, 29));
+
+    TestCorrelationSum<LeastSquares<Vec3b>>(a, b);
+    TestCorrelationSum<AbsoluteDifference<Vec3b>>(a, b);
+    TestCorrelationSum<Gain<Vec3b>>(a, b);
+    TestCorrelationSum<SumA<Vec3b>>(a, b);
+    TestCorrelationSum<LeastSquaresInt<Vec3b>>(a, b);
+    TestCorrelationSum<AbsoluteDifferenceInt<Vec3b>>(a, b);
+
+    Mat grayA, grayB;
+    cvtColor(a, grayA, COLOR_BGR2GRAY);
+    cvtColor(b, grayB, COLOR_BGR2GRAY);
+
+    TestCorrelationSum<LeastSquaresInt<uchar>>(grayA(Rect(1, 1, 40, 25)), grayB);
+    TestCorrelationSum<AbsoluteDifferenceInt<uchar>>(grayA(Rect(1, 1, 40, 25)), grayB);
+
+    // Integer metrics are scaled like their float counterparts. 
+    float expected = NormedCorrelator<LeastSquares<Vec3b>>::Calculate(a, b, 2, -3);
+    float actual = NormedCorrelator<LeastSquaresInt<Vec3b>>::Calculate(a, b, 2, -3);
+    AssertM(abs(expected - actual) <= abs(expected) * 1e-4, 
+            "Integer metric matches float metric");
+
+    cout << "[\u2713] Correlator kernel module." << endl;
+}
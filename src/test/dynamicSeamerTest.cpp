@@ -0,0 +1,214 @@
+#include <limits>
+
+#include "../common/assert.hpp"
+#include "../stitcher/dynamicSeamer.hpp"
+#include "../stitcher/seamerKernels.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Per-pixel reference implementation of the seamer, in seam space.
+ */
+template <bool vertical>
+void ReferenceFind(const Mat &imgA, const Mat &imgB, Mat &maskA, Mat &maskB,
+        Point tlA, Point tlB, int border, int overlap) {
+    auto at = [] (Mat &m, int x, int y) -> uchar& {
+        return vertical ? m.at<uchar>(y, x) : m.at<uchar>(x, y);
+    };
+    auto pixel = [] (const Mat &m, int x, int y) {
+        return vertical ? m.at<Vec3b>(y, x) : m.at<Vec3b>(x, y);
+    };
+
+    Size sizeA = vertical ? imgA.size() : Size(imgA.rows, imgA.cols);
+    Size sizeB = vertical ? imgB.size() : Size(imgB.rows, imgB.cols);
+    if(!vertical) {
+        tlA = Point(tlA.y, tlA.x);
+        tlB = Point(tlB.y, tlB.x);
+    }
+
+    Rect roi = Rect(tlA, sizeA) & Rect(tlB, sizeB);
+    if(roi.width <= border * 2) {
+        return;
+    }
+
+    Point a = tlA - roi.tl(), b = tlB - roi.tl();
+    Mat cost(roi.size(), CV_32F, Scalar::all(0));
+    Mat path(roi.size(), CV_8U, Scalar::all(1));
+
+    for(int y = 0; y < roi.height; y++) {
+        for(int x = border; x < roi.width - border; x++) {
+            if(at(maskA, x - a.x, y - a.y) == 0 || at(maskB, x - b.x, y - b.y) == 0) {
+                continue;
+            }
+            Vec3b va = pixel(imgA, x - a.x, y - a.y);
+            Vec3b vb = pixel(imgB, x - b.x, y - b.y);
+            float ssd = 0;
+            for(int c = 0; c < 3; c++) {
+                ssd += ((float)va[c] - vb[c]) * ((float)va[c] - vb[c]);
+            }
+            cost.at<float>(y, x) = 255 - sqrt(ssd / 9);
+        }
+    }
+
+    for(int y = 1; y < roi.height; y++) {
+        for(int x = border; x < roi.width - border; x++) {
+            int best = 0;
+            for(int q = -1; q <= 1; q++) {
+                if(x + q >= border && x + q < roi.width - border &&
+                   cost.at<float>(y - 1, x + q) > cost.at<float>(y - 1, x + best)) {
+                    best = q;
+                }
+            }
+            path.at<uchar>(y, x) = best + 1;
+            cost.at<float>(y, x) += cost.at<float>(y - 1, x + best);
+        }
+    }
+
+    int x = 1 + border;
+    for(int q = 1 + border; q < roi.width - border; q++) {
+        if(cost.at<float>(roi.height - 1, q) > cost.at<float>(roi.height - 1, x)) {
+            x = q;
+        }
+    }
+
+    bool aIsLeft = tlA.x <= tlB.x;
+    Mat &left = aIsLeft ? maskA : maskB;
+    Mat &right = aIsLeft ? maskB : maskA;
+    Point l = aIsLeft ? a : b, r = aIsLeft ? b : a;
+    int leftCols = aIsLeft ? sizeA.width : sizeB.width;
+
+    for(int y = roi.height - 1; y >= 0; y--) {
+        for(int q = x - l.x + 1 + overlap; q < leftCols; q++) {
+            at(left, q, y - l.y) = 0;
+        }
+        for(int q = 0; q < x - r.x - overlap; q++) {
+            at(right, q, y - r.y) = 0;
+        }
+        x += path.at<uchar>(y, x) - 1;
+    }
+}
+
+Mat CreateImage(const Size &size) {
+    Mat noise(size.height / 2, size.width / 2, CV_8UC3), image;
+    randu(noise, Scalar::all(0), Scalar::all(255));
+    resize(noise, image, size, 0, 0, INTER_NEAREST);
+    return image;
+}
+
+Mat CreateMask(const Size &size) {
+    Mat mask(size, CV_8U, Scalar::all(255));
+    // Some holes, so invalid pixels are covered.
+    rectangle(mask, Rect(size.width / 2, size.height / 3, 7, 5), Scalar::all(0), -1);
+    return mask;
+}
+
+template <bool vertical>
+void TestAgainstReference(Point tlB) {
+    const Size sizeA(120, 90), sizeB(110, 100);
+    const Point tlA(0, 0);
+
+    Mat imgA = CreateImage(vertical ? sizeA : Size(sizeA.height, sizeA.width));
+    Mat imgB = CreateImage(vertical ? sizeB : Size(sizeB.height, sizeB.width));
+    if(!vertical) {
+        tlB = Point(tlB.y, tlB.x);
+    }
+
+    Mat maskA = CreateMask(imgA.size()), maskB = CreateMask(imgB.size());
+    Mat refA = maskA.clone(), refB = maskB.clone();
+
+    DynamicSeamer::Find<vertical>(imgA, imgB, maskA, maskB, tlA, tlB, 3, 2, 0);
+    ReferenceFind<vertical>(imgA, imgB, refA, refB, tlA, tlB, 3, 2);
+
+    Mat diff;
+    absdiff(maskA, refA, diff);
+    AssertEQM(countNonZero(diff), 0, "First mask equals reference");
+    absdiff(maskB, refB, diff);
+    AssertEQM(countNonZero(diff), 0, "Second mask equals reference");
+    Mat cut;
+    compare(refA, 255, cut, CMP_NE);
+    AssertGTM(countNonZero(cut), 35, "Seam was applied to first mask");
+}
+
+/*
+ * Two different images that are equal in a narrow vertical band,
+ * so the best cut runs along the band. The band covers a full block
+ * of the downsampled image.
+ */
+void TestDownsampled(int downsample) {
+    const Size size(200, 160);
+    const int band = 98;
+    Mat imgA = CreateImage(size), imgB = CreateImage(size);
+    imgA.colRange(band - 2, band + 3).copyTo(imgB.colRange(band - 2, band + 3));
+
+    Mat maskA(size, CV_8U, Scalar::all(255)), maskB(size, CV_8U, Scalar::all(255));
+
+    DynamicSeamer::Find<true>(imgA, imgB, maskA, maskB, Point(0, 0), Point(0, 0), 4, 0, 0, downsample);
+
+    for(int y = 0; y < size.height; y++) {
+        int leftEnd = countNonZero(maskA.row(y));
+        int rightStart = size.width - countNonZero(maskB.row(y));
+        AssertGEM(2, abs(leftEnd - 1 - band), "Cut follows the band");
+        AssertEQM(leftEnd, rightStart + 1, "Masks share the seam column");
+    }
+}
+
+/*
+ * Compares the row kernels against their scalar fallbacks on random rows.
+ */
+void TestKernels() {
+    RNG rng(11);
+
+    for(int n = 1; n < 40; n++) {
+        vector<uint8_t> a(n * 3 + 16), b(n * 3 + 16), ma(n + 4), mb(n + 4);
+        for(size_t i = 0; i < a.size(); i++) {
+            a[i] = rng.uniform(0, 256);
+            b[i] = rng.uniform(0, 256);
+        }
+        for(size_t i = 0; i < ma.size(); i++) {
+            ma[i] = rng.uniform(0, 4) == 0 ? 0 : 255;
+            mb[i] = rng.uniform(0, 4) == 0 ? 0 : 255;
+        }
+
+        vector<float> cost(n), expected(n);
+        kernels::SeamCostRow(a.data(), b.data(), ma.data(), mb.data(), cost.data(), n);
+        kernels::scalar::SeamCostRow(a.data(), b.data(), ma.data(), mb.data(), expected.data(), n);
+
+        for(int i = 0; i < n; i++) {
+            AssertEQM(cost[i], expected[i], "Cost kernel equals scalar fallback");
+        }
+
+        // Few distinct values, so ties are covered.
+        vector<float> prev(n), acc(n), accExpected(n);
+        vector<uint8_t> path(n), pathExpected(n);
+        for(int i = 0; i < n; i++) {
+            prev[i] = (float)rng.uniform(0, 3);
+            acc[i] = accExpected[i] = (float)rng.uniform(0, 3);
+        }
+
+        kernels::SeamPathRow(prev.data(), acc.data(), path.data(), 0, n, 0, n);
+        for(int x = 0; x < n; x++) {
+            kernels::SeamPathStep(prev.data(), accExpected.data(), pathExpected.data(),
+                    x, x > 0, x + 1 < n);
+            AssertEQM(acc[x], accExpected[x], "Path kernel cost equals single steps");
+            AssertEQM(path[x], pathExpected[x], "Path kernel direction equals single steps");
+        }
+    }
+}
+
+int main(int, char**) {
+    cv::theRNG().state = 1337;
+
+    TestKernels();
+
+    TestAgainstReference<true>(Point(40, 5));
+    TestAgainstReference<true>(Point(-30, -7));
+    TestAgainstReference<false>(Point(40, 5));
+    TestAgainstReference<false>(Point(-30, -7));
+
+    TestDownsampled(1);
+    TestDownsampled(4);
+
+    cout << "[\u2713] DynamicSeamer module." << endl;
+}
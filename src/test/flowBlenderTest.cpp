@@ -0,0 +1,131 @@
+#include <opencv2/stitching/detail/blenders.hpp>
+
+#include "../common/assert.hpp"
+#include "../stitcher/flowBlender.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Blends the image into dest by remapping both images as a whole
+ * and blending them afterwards. That is the unfused blending path, 
+ * used as reference. 
+ */
+void ReferenceFeed(Mat &dest, const Mat &destMask, float sharpness, 
+        const Mat &img, const Mat &flow, const Rect &sourceRoi) {
+    const int w = img.cols, h = img.rows;
+
+    Mat wmDest(img.size(), CV_32F, Scalar::all(0));
+    cv::detail::createWeightMap(destMask(sourceRoi), sharpness, wmDest);
+
+    Mat imgMapX(h, w, CV_32F), imgMapY(h, w, CV_32F);
+    Mat destMapX(h, w, CV_32F), destMapY(h, w, CV_32F);
+
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            float wcd = wmDest.at<float>(y, x);
+            float wcs = 1.f - wcd;
+            Vec2f f = flow.at<Vec2f>(y, x);
+
+            float imgDx = x + f[0] * wcd;
+            float imgDy = y + f[1] * wcd;
+
+            imgMapX.at<float>(y, x) = imgDx < 0 || imgDx >= w ? x : imgDx;
+            imgMapY.at<float>(y, x) = imgDy < 0 || imgDy >= h ? y : imgDy;
+            destMapX.at<float>(y, x) = sourceRoi.x + x - f[0] * wcs;
+            destMapY.at<float>(y, x) = sourceRoi.y + y - f[1] * wcs;
+        }
+    }
+
+    Mat remappedImg, remappedDest;
+    remap(img, remappedImg, imgMapX, imgMapY, INTER_LINEAR);
+    remap(dest, remappedDest, destMapX, destMapY, INTER_LINEAR);
+
+    Mat target = dest(sourceRoi);
+
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            float wcd = wmDest.at<float>(y, x);
+            float wcs = 1.f - wcd;
+
+            for(int c = 0; c < 3; c++) {
+                target.at<Vec3b>(y, x)[c] = (uchar)(
+                        wcd * remappedDest.at<Vec3b>(y, x)[c] +
+                        wcs * remappedImg.at<Vec3b>(y, x)[c]);
+            }
+        }
+    }
+}
+
+/*
+ * Checks that the flow engine explains a shift between two images 
+ * better than zero flow. 
+ */
+void TestFlowEngine(FlowEngineType type) {
+    Mat scene;
+    cvtColor(CreateBlurredNoise(Size(200, 160), CV_8UC3, 255), scene, COLOR_BGR2GRAY);
+    Mat a = scene(Rect(4, 4, 160, 120));
+    Mat b = scene(Rect(6, 5, 160, 120));
+
+    Mat flow;
+    CreateFlowEngine(type)->Calculate(a, b, flow);
+
+    AssertEQ(flow.size(), a.size());
+    AssertEQ(flow.type(), CV_32FC2);
+
+    const double residual = CalculateFlowResidual(a, b, flow);
+    const double zeroResidual = CalculateFlowResidual(a, b, 
+            Mat(a.size(), CV_32FC2, Scalar::all(0)));
+
+    AssertGTM(zeroResidual, residual, "Flow reduces the photometric error");
+}
+
+int main(int, char**) {
+    const Rect roi(0, 0, 420, 140);
+    const Point tlA(0, 20), tlB(110, 15);
+
+    Mat a = CreateBlurredNoise(Size(170, 110), CV_8UC3, 255);
+    Mat b = CreateBlurredNoise(Size(170, 110), CV_8UC3, 255);
+    Mat flow = CreateBlurredNoise(b.size(), CV_32FC2, 30);
+
+    FlowBlender blender(0.05f);
+    blender.Prepare(roi);
+    blender.Feed(a, Mat(a.size(), CV_32FC2, Scalar::all(0)), tlA);
+
+    AssertEQM(norm(blender.GetResult()(Rect(tlA, a.size())), a, NORM_INF), 0.0, 
+            "Image without overlap is copied");
+
+    Mat expected = blender.GetResult().clone();
+    ReferenceFeed(expected, blender.GetResultMask(), blender.GetSharpness(), 
+            b, flow, Rect(tlB, b.size()));
+
+    blender.Feed(b, flow, tlB);
+
+    AssertM(norm(blender.GetResult(), expected, NORM_INF) <= 1.0, 
+            "Fused blending equals reference within rounding");
+
+    // Steady state - scratch buffers are re-used after the first pair. 
+    size_t allocations = 0;
+    for(int i = 0; i < 3; i++) {
+        Mat pairFlow;
+        blender.CalculateFlow(a, b, tlA, tlB, pairFlow);
+        blender.Feed(b, pairFlow, tlB);
+
+        if(i == 0) {
+            allocations = blender.GetBufferPool().GetAllocationCount();
+        }
+    }
+    AssertEQM(blender.GetBufferPool().GetAllocationCount(), allocations, 
+            "No allocations in steady state");
+
+    TestFlowEngine(FlowEngineType::Farneback);
+    TestFlowEngine(FlowEngineType::HalfResolutionFarneback);
+    TestFlowEngine(FlowEngineType::QuarterResolutionFarneback);
+#ifdef OPTONAUT_HAS_DIS_FLOW
+    TestFlowEngine(FlowEngineType::DIS);
+#endif
+
+    cout << "[\u2713] Flow blender module." << endl;
+}
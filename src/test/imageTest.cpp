@@ -0,0 +1,81 @@
+#include "../common/assert.hpp"
+#include "../common/image.hpp"
+#include "../common/mappedImage.hpp"
+#include "../io/io.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Creates a smooth random image, so scaled decoding and
+ * pyramid downsampling give similar results.
+ */
+Mat CreateImage(const Size &size) {
+    Mat noise(6, 8, CV_8UC3), image;
+    randu(noise, Scalar::all(0), Scalar::all(255));
+    resize(noise, image, size, 0, 0, INTER_CUBIC);
+    return image;
+}
+
+Mat PyrDown(const Mat &in, int level) {
+    Mat out = in;
+    for(int i = 0; i < level; i++) {
+        pyrDown(out, out);
+    }
+    return out;
+}
+
+double MeanDifference(const Mat &a, const Mat &b) {
+    Mat diff;
+    absdiff(a, b, diff);
+    return mean(diff.reshape(1))[0];
+}
+
+int main(int, char**) {
+    const string base = "tmp/image-test/";
+    DeleteDirectories(base);
+    CreateDirectories(base + "x");
+
+    // Odd size, so rounding of the decoder has to match pyrDown.
+    Mat original = CreateImage(Size(323, 241));
+    const string jpeg = base + "image.jpg";
+    const string raw = base + "image" + MappedImageExtension;
+    imwrite(jpeg, original);
+    WriteMappedImage(original, raw);
+
+    Image full;
+    full.source = jpeg;
+    full.Load();
+
+    for(int level = 0; level <= 4; level++) {
+        Mat expected = PyrDown(full.data, level);
+
+        // JPEG sources are decoded at reduced size.
+        Image scaled;
+        scaled.source = jpeg;
+        scaled.LoadScaled(level);
+
+        AssertEQM(scaled.data.size(), expected.size(), "Scaled size equals pyramid size");
+        AssertEQM(scaled.size(), expected.size(), "Metadata is updated");
+        AssertEQM(scaled.type(), CV_8UC3, "Color image is loaded");
+        AssertGTM(16.0, MeanDifference(scaled.data, expected), "Scaled image equals pyramid");
+
+        Image gray;
+        gray.source = jpeg;
+        gray.LoadScaled(level, IMREAD_GRAYSCALE);
+        AssertEQM(gray.type(), CV_8U, "Grayscale image is loaded");
+        AssertEQM(gray.data.size(), expected.size(), "Scaled grayscale size equals pyramid size");
+
+        // Other sources fall back to the pyramid.
+        Image mapped;
+        mapped.source = raw;
+        mapped.LoadScaled(level);
+        AssertEQM(MeanDifference(mapped.data, PyrDown(original, level)), 0.0,
+                "Mapped image is downsampled using pyramid");
+    }
+
+    DeleteDirectories(base);
+
+    cout << "[\u2713] Image module." << endl;
+}
@@ -0,0 +1,101 @@
+#include <vector>
+#include <map>
+
+#include "../common/assert.hpp"
+#include "../common/image.hpp"
+#include "../common/mappedImage.hpp"
+#include "../io/io.hpp"
+#include "../io/checkpointStore.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+bool Equals(const Mat &a, const Mat &b) {
+    if(a.size() != b.size() || a.type() != b.type()) {
+        return false;
+    }
+    Mat diff;
+    absdiff(a, b, diff);
+    return countNonZero(diff.reshape(1)) == 0;
+}
+
+int main(int, char**) {
+    const string base = "tmp/mapped-image-test/";
+    const string path = base + "image" + MappedImageExtension;
+
+    DeleteDirectories(base);
+    CreateDirectories(path);
+
+    // Round trip, including views that are not continuous.
+    Mat color(67, 101, CV_8UC3);
+    randu(color, Scalar::all(0), Scalar::all(255));
+    Mat view = color(Rect(3, 5, 50, 40));
+
+    WriteMappedImage(view, path);
+    Mat loaded = ReadMappedImage(path);
+    AssertM(Equals(loaded, view), "Mapped image equals written image");
+    AssertM(loaded.isContinuous(), "Mapped image is continuous");
+
+    // Writes are private to the mapping.
+    loaded.setTo(Scalar::all(0));
+    AssertM(Equals(ReadMappedImage(path), view), "Writes don't change the file");
+
+    // Overwriting keeps existing mappings intact.
+    Mat mapped = ReadMappedImage(path);
+    WriteMappedImage(color, path);
+    AssertM(Equals(mapped, view), "Existing mapping is unchanged");
+    AssertM(Equals(ReadMappedImage(path), color), "File is replaced");
+
+    // Channels are converted as requested by the flags.
+    Mat gray;
+    cvtColor(color, gray, COLOR_BGR2GRAY);
+    AssertM(Equals(ReadMappedImage(path, IMREAD_GRAYSCALE), gray), "Image is converted to grayscale");
+    WriteMappedImage(gray, path);
+    AssertEQM(ReadMappedImage(path, IMREAD_COLOR).type(), CV_8UC3, "Mask is converted to color");
+    AssertEQM(ReadMappedImage(path, IMREAD_UNCHANGED).type(), CV_8U, "Mask is loaded unchanged");
+
+    // Images load from mapped containers transparently, and copies
+    // keep the mapping alive after unloading.
+    Image image;
+    image.source = path;
+    image.Load(IMREAD_GRAYSCALE);
+    Mat copy = image.data;
+    image.Unload();
+    AssertM(Equals(copy, gray), "Copy outlives unloaded image");
+
+    // The mapped store round trips stitcher input without re-encoding.
+    MappedCheckpointStore store(base + "store/", base + "shared/");
+    vector<vector<InputImageP>> rings = { { CreateImage(0, 64, 48), CreateImage(1, 64, 48) },
+                                          { CreateImage(2, 64, 48) } };
+    map<size_t, double> exposure = { { 0, 1.0 }, { 1, 1.5 }, { 2, 2.0 } };
+
+    for(auto &ring : rings) {
+        for(auto &img : ring) {
+            store.SaveRectifiedImage(img);
+            AssertM(IsMappedImagePath(img->image.source), "Source is set to container");
+        }
+    }
+    store.SaveStitcherInput(rings, exposure);
+
+    vector<vector<InputImageP>> loadedRings;
+    map<size_t, double> loadedExposure;
+    store.LoadStitcherInput(loadedRings, loadedExposure);
+
+    AssertEQM(loadedRings.size(), rings.size(), "Ring count is restored");
+    for(size_t i = 0; i < rings.size(); i++) {
+        AssertEQM(loadedRings[i].size(), rings[i].size(), "Ring size is restored");
+        for(size_t j = 0; j < rings[i].size(); j++) {
+            auto img = loadedRings[i][j];
+            AssertEQM(img->id, rings[i][j]->id, "Image order is restored");
+            img->image.Load();
+            AssertM(Equals(img->image.data, rings[i][j]->image.data), "Image is restored losslessly");
+        }
+    }
+    AssertEQM(loadedExposure.size(), exposure.size(), "Exposure is restored");
+
+    DeleteDirectories(base);
+
+    cout << "[\u2713] MappedImage module." << endl;
+}
@@ -0,0 +1,100 @@
+#include <vector>
+#include <set>
+#include <mutex>
+
+#include "../common/assert.hpp"
+#include "../common/progressCallback.hpp"
+#include "../common/intrinsics.hpp"
+#include "../io/io.hpp"
+#include "../io/checkpointStore.hpp"
+#include "../stitcher/multiringStitcher.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Checkpoint store that records which rings were saved and loaded. 
+ */
+class RecordingCheckpointStore : public CheckpointStore {
+    private:
+    mutex m;
+    set<int> saved;
+    set<int> loaded;
+
+    public:
+    RecordingCheckpointStore(const string &basePath, const string &sharedPath) :
+        CheckpointStore(basePath, sharedPath, MappedImageExtension) { }
+
+    virtual void SaveRing(int ringId, StitchingResultP image) {
+        CheckpointStore::SaveRing(ringId, image);
+        unique_lock<mutex> lock(m);
+        AssertM(saved.insert(ringId).second, "Ring is saved once");
+    }
+
+    virtual StitchingResultP LoadRing(int ringId) {
+        {
+            unique_lock<mutex> lock(m);
+            loaded.insert(ringId);
+        }
+        return CheckpointStore::LoadRing(ringId);
+    }
+
+    set<int> GetSavedRings() {
+        unique_lock<mutex> lock(m);
+        return saved;
+    }
+
+    set<int> GetLoadedRings() {
+        unique_lock<mutex> lock(m);
+        return loaded;
+    }
+};
+
+StitchingResultP Stitch(CheckpointStore &store, vector<vector<InputImageP>> &rings, 
+        size_t concurrentRings) {
+    ProgressCallback progress([] (float) { return true; });
+    ExposureCompensator exposure;
+
+    MultiRingStitcher stitcher(store, concurrentRings);
+    stitcher.InitializeForStitching(rings, exposure, 0.4);
+    return stitcher.Stitch(progress);
+}
+
+int main(int, char**) {
+    const string base = "tmp/multiring-stitcher-test/";
+    DeleteDirectories(base);
+
+    auto rings = CreateRecording(iPhone6Intrinsics, Size(108, 192));
+    const set<int> allRings = { 0, 1, 2 };
+
+    // Concurrent rings give the same result as sequential ones.
+    RecordingCheckpointStore sequentialStore(base + "sequential/", base + "sequential/shared/");
+    StitchingResultP sequential = Stitch(sequentialStore, rings, 1);
+
+    RecordingCheckpointStore concurrentStore(base + "concurrent/", base + "concurrent/shared/");
+    StitchingResultP concurrent = Stitch(concurrentStore, rings, 3);
+
+    AssertEqual(concurrent->image.data, sequential->image.data, 
+            "Concurrent stitching equals sequential stitching");
+    AssertM(sequentialStore.GetSavedRings() == allRings, "All rings are saved");
+    AssertM(concurrentStore.GetSavedRings() == allRings, "All rings are saved concurrently");
+
+    // Resuming only stitches the rings that were not saved before. 
+    RecordingCheckpointStore resumeStore(base + "resume/", base + "resume/shared/");
+
+    StitchingResultP saved = concurrentStore.LoadRing(1);
+    saved->image.Load();
+    saved->mask.Load(IMREAD_GRAYSCALE);
+    resumeStore.SaveRing(1, saved);
+
+    StitchingResultP resumed = Stitch(resumeStore, rings, 3);
+
+    AssertEqual(resumed->image.data, sequential->image.data, 
+            "Resumed stitching equals sequential stitching");
+    AssertM(resumeStore.GetLoadedRings() == allRings, "All rings are looked up");
+    AssertM(resumeStore.GetSavedRings() == allRings, "Missing rings are saved");
+
+    cout << "[\u2713] MultiRingStitcher module." << endl;
+}
@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../imgproc/pairwiseCorrelator.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Creates an image that shows the given region of the scene, 
+ * with identity extrinsics. 
+ */
+InputImageP CreateImage(int id, const Mat &scene, const Rect &region) {
+    auto image = make_shared<InputImage>();
+    image->id = id;
+    image->image = Image(scene(region).clone());
+
+    image->intrinsics = Mat::eye(3, 3, CV_64F);
+    image->intrinsics.at<double>(0, 0) = region.width;
+    image->intrinsics.at<double>(1, 1) = region.width;
+    image->intrinsics.at<double>(0, 2) = region.width / 2;
+    image->intrinsics.at<double>(1, 2) = region.height / 2;
+
+    image->originalExtrinsics = Mat::eye(4, 4, CV_64F);
+    image->adjustedExtrinsics = Mat::eye(4, 4, CV_64F);
+
+    return image;
+}
+
+/*
+ * Checks that the batch results are equal to the ones of single matches, 
+ * in input order. 
+ */
+void TestBatch(int flags) {
+    Mat noise(200, 300, CV_8UC3), scene;
+    randu(noise, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(noise, scene, Size(9, 9), 3);
+
+    vector<InputImageP> images;
+    for(int i = 0; i < 4; i++) {
+        images.push_back(CreateImage(i, scene, Rect(40 + i * 7, 30 + i * 3, 160, 120)));
+    }
+
+    vector<pair<InputImageP, InputImageP>> pairs;
+    for(size_t i = 0; i < images.size(); i++) {
+        for(size_t j = 0; j < images.size(); j++) {
+            if(i != j) {
+                pairs.emplace_back(images[i], images[j]);
+            }
+        }
+    }
+
+    MatchOptions options(4, 4, false, 0.25, 1);
+    PairwiseCorrelator correlator(flags);
+
+    auto results = correlator.MatchBatch(pairs, options);
+    AssertEQ(results.size(), pairs.size());
+
+    for(size_t i = 0; i < pairs.size(); i++) {
+        auto expected = correlator.Match(pairs[i].first, pairs[i].second, options);
+
+        AssertEQ(results[i].valid, expected.valid);
+        AssertEQ(results[i].offset, expected.offset);
+        AssertEQ(results[i].rejectionReason, expected.rejectionReason);
+    }
+
+    // Sanity check - the first pair is offset by the crop position. 
+    AssertM(results[0].valid, "Overlapping images match");
+    AssertEQ(abs(results[0].offset.x), 7.0f);
+    AssertEQ(abs(results[0].offset.y), 3.0f);
+}
+
+int main(int, char**) {
+    TestBatch(0);
+    TestBatch(PairwiseCorrelator::SearchBounded | PairwiseCorrelator::SearchLuma);
+
+    cout << "[\u2713] Pairwise batch module." << endl;
+}
@@ -0,0 +1,52 @@
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../imgproc/planarCorrelator.hpp"
+#include "../imgproc/phaseCorrelationAligner.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+template <typename Correlator>
+void TestShifts(int type) {
+    typedef BruteForcePlanarAligner<Correlator> BruteForce;
+    typedef PhaseCorrelationPlanarAligner<Correlator> Phase;
+
+    Mat texture = CreateTexture(Size(400, 300), type);
+    const Rect base(100, 80, 160, 120);
+
+    for(Point shift : { Point(0, 0), Point(7, -3), Point(-21, 12), Point(30, 25), Point(-3, -28) }) {
+        Mat a = texture(base);
+        Mat b = texture(base + shift);
+        Mat corr;
+
+        PlanarCorrelationResult expected = BruteForce::Align(a, b, corr, 0.25, 0.25);
+        AssertEQM(expected.offset, -shift, "Brute force aligner recovers shift");
+
+        PlanarCorrelationResult res = Phase::Align(a, b, corr, 0.25, 0.25);
+        AssertEQM(res.offset, expected.offset, "Offset equals brute force offset");
+
+        // The cost is the one of the brute force aligner at the chosen offset.
+        PlanarCorrelationResult local = BruteForce::Align(a, b, corr, 1, 1,
+                expected.offset.x, expected.offset.y);
+        AssertEQM(res.offset, local.offset, "Offset is a local minimum");
+        AssertEQM(res.cost, local.cost, "Cost equals brute force cost");
+        AssertEQM(res.variance, local.variance, "Variance equals brute force variance");
+        AssertEQM(res.n, local.n, "Count equals brute force count");
+
+        // Pyramid views are aligned using their base level.
+        PlanarCorrelationResult view = Phase::Align(PyramidView(a), PyramidView(b), corr, 0.25, 0.25);
+        AssertEQM(view.offset, res.offset, "Views give the same offset");
+        AssertEQM(view.cost, res.cost, "Views give the same cost");
+    }
+}
+
+int main(int, char**) {
+    TestShifts<NormedCorrelator<LeastSquares<Vec3b>>>(CV_8UC3);
+    TestShifts<NormedCorrelator<LeastSquaresInt<Vec3b>>>(CV_8UC3);
+    TestShifts<NormedCorrelator<LeastSquaresInt<uchar>>>(CV_8UC1);
+
+    cout << "[\u2713] PhaseCorrelationPlanarAligner module." << endl;
+}
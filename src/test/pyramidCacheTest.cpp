@@ -0,0 +1,97 @@
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../imgproc/imagePyramid.hpp"
+#include "../imgproc/planarCorrelator.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+int main(int, char**) {
+
+    auto a = CreateImage(0, 101, 67);
+    auto b = CreateImage(1, 101, 67);
+
+    PyramidCache cache;
+
+    // Pyramids are cached per image. 
+    AssertM(cache.Get(a) == cache.Get(a), "Pyramid is re-used");
+    AssertM(cache.Get(a) != cache.Get(b), "Pyramids are separated by id");
+
+    // Views of cropped regions have the same size as pyramids of the crop. 
+    Mat crop = a->image.data(Rect(13, 7, 51, 33));
+    PyramidView cached = cache.GetView(a, crop);
+    PyramidView uncached(crop);
+
+    for(size_t i = 0; i < 4; i++) {
+        AssertEQM(cached.GetLevel(i).size(), uncached.GetLevel(i).size(), 
+                "Cropped view matches pyrDown of crop");
+    }
+
+    AssertEQM(norm(cached.GetLevel(0), crop, NORM_L1), 0.0, 
+            "Base of view equals crop");
+
+    // Coarser levels of crops are created from the crop itself, so all levels equal the uncached pyramid. 
+    for(size_t i = 0; i < 4; i++) {
+        AssertEQM(norm(cached.GetLevel(i), uncached.GetLevel(i), NORM_L1), 0.0, 
+                "Odd cropped view equals pyramid of crop");
+    }
+
+    Mat other = a->image.data(Rect(17, 10, 51, 33));
+    Mat corr;
+    typedef PyramidPlanarAligner<NormedCorrelator<LeastSquares<Vec3b>>> Aligner;
+    PlanarCorrelationResult cachedRes = Aligner::Align(cached, cache.GetView(a, other), corr, 0.25, 0.25);
+    PlanarCorrelationResult uncachedRes = Aligner::Align(uncached, PyramidView(other), corr, 0.25, 0.25);
+
+    AssertEQM(cachedRes.offset, uncachedRes.offset, "Cached alignment equals uncached alignment");
+    AssertEQM(cachedRes.cost, uncachedRes.cost, "Cached alignment equals uncached alignment");
+
+    // Crops at even offsets also equal the uncached pyramid, since pyrDown 
+    // of the crop reflects at the border of the crop, not the image. 
+    Mat aligned = a->image.data(Rect(12, 8, 51, 33));
+    PyramidView alignedView = cache.GetView(a, aligned);
+    PyramidView alignedUncached(aligned);
+
+    const Mat &full = cache.Get(a)->GetLevel(0);
+    AssertM(alignedView.GetLevel(0).data == full.data + 8 * full.step[0] + 12 * full.elemSize(), 
+            "Aligned view shares base");
+
+    for(size_t i = 0; i < 4; i++) {
+        AssertEqual(alignedView.GetLevel(i), alignedUncached.GetLevel(i), 
+                "Even cropped view equals pyramid of crop");
+    }
+
+    Mat alignedOther = a->image.data(Rect(16, 10, 51, 33));
+    cachedRes = Aligner::Align(alignedView, cache.GetView(a, alignedOther), corr, 0.25, 0.25);
+    uncachedRes = Aligner::Align(alignedUncached, PyramidView(alignedOther), corr, 0.25, 0.25);
+
+    AssertEQM(cachedRes.offset, uncachedRes.offset, "Even cropped alignment equals uncached alignment");
+    AssertEQM(cachedRes.cost, uncachedRes.cost, "Even cropped alignment equals uncached alignment");
+
+    // Luma pyramids are cached separately and have a single channel. 
+    AssertM(cache.Get(a, true) == cache.Get(a, true), "Luma pyramid is re-used");
+    AssertM(cache.Get(a, true) != cache.Get(a), "Luma pyramid is separate");
+
+    PyramidView luma = cache.GetView(a, crop, true);
+    AssertEQ(luma.GetLevel(0).type(), CV_8UC1);
+    AssertEQ(luma.GetLevel(2).size(), cached.GetLevel(2).size());
+    AssertEQM(norm(luma.GetLevel(0), ToLuma(crop), NORM_L1), 0.0, 
+            "Base of luma view equals converted crop");
+
+    // Unloading drops the pyramid. 
+    size_t usedBefore = cache.GetUsedBytes();
+    b->image.Unload();
+    AssertGTM(usedBefore, cache.GetUsedBytes(), "Pyramid dropped on unload");
+
+    // Budget is respected. 
+    PyramidCache small(cache.Get(a)->GetByteSize());
+    auto c = CreateImage(2, 101, 67);
+    auto first = small.Get(a);
+    small.Get(c);
+    AssertM(first != small.Get(a), "Pyramid was evicted");
+    AssertGE(cache.Get(a)->GetByteSize(), small.GetUsedBytes());
+
+    cout << "[\u2713] Pyramid cache module." << endl;
+}
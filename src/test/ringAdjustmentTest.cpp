@@ -0,0 +1,33 @@
+#include "../common/assert.hpp"
+#include "../stitcher/ringAdjustment.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+int main(int, char**) {
+    for(int type : { CV_8UC1, CV_8UC3 }) {
+        Mat canvas = CreateTexture(Size(2000, 700), type);
+
+        // Ring b is actually five pixels lower than its corner says. 
+        Mat a = canvas(Rect(0, 0, canvas.cols, 300));
+        Mat b = canvas(Rect(0, 245, canvas.cols, 300));
+
+        AssertEQM(FindRingOffset(a, Point(0, 0), b, Point(0, 240)), -245, 
+                "Offset is recovered when ring is too high");
+        AssertEQM(FindRingOffset(a, Point(0, 0), b, Point(0, 250)), -245, 
+                "Offset is recovered when ring is too low");
+        AssertEQM(FindRingOffset(a, Point(0, 100), b, Point(0, 340)), -245, 
+                "Offset is independent of the ring position");
+    }
+
+    // Rings that don't overlap keep their offset. 
+    Mat a = CreateTexture(Size(400, 100), CV_8UC1);
+    Mat b = CreateTexture(Size(400, 100), CV_8UC1);
+
+    AssertEQM(FindRingOffset(a, Point(0, 0), b, Point(0, 120)), -120, 
+            "Offset is kept without overlap");
+
+    cout << "[\u2713] RingAdjustment module." << endl;
+}
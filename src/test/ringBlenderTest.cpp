@@ -0,0 +1,117 @@
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../stitcher/ringBlender.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+struct Ring {
+    Mat image;
+    Mat mask;
+    Point corner;
+};
+
+/*
+ * Blends the rings with the given settings.
+ */
+void Blend(const vector<Ring> &rings, const Rect &roi, RingBlendMode mode,
+        int stripHeight, Mat &result, Mat &resultMask) {
+    RingBlender blender(mode, 5, stripHeight);
+    blender.Prepare(roi);
+
+    for(auto &ring : rings) {
+        blender.Feed(ring.image, ring.mask, ring.corner);
+    }
+
+    blender.Blend(result, resultMask);
+}
+
+/*
+ * Shifts an image horizontally, wrapping around. 
+ */
+Mat Roll(const Mat &image, int shift) {
+    Mat rolled(image.size(), image.type());
+    const int w = image.cols;
+    shift = ((shift % w) + w) % w;
+
+    image(Rect(0, 0, w - shift, image.rows)).copyTo(rolled(Rect(shift, 0, w - shift, image.rows)));
+    image(Rect(w - shift, 0, shift, image.rows)).copyTo(rolled(Rect(0, 0, shift, image.rows)));
+
+    return rolled;
+}
+
+int main(int, char**) {
+    const Rect roi(0, 0, 640, 480);
+    const int ringHeight = 180;
+
+    // Three overlapping rings, with seamed masks. 
+    vector<Ring> rings;
+    for(int i = 0; i < 3; i++) {
+        Ring ring;
+        ring.image = CreateTexture(Size(roi.width, ringHeight), CV_8UC3, 8, 0);
+        ring.mask = Mat(ring.image.size(), CV_8U, Scalar::all(255));
+        ring.corner = Point(0, i * 150);
+
+        if(i > 0) {
+            ring.mask(Rect(0, 0, roi.width, 10)).setTo(Scalar::all(0));
+        }
+        if(i < 2) {
+            ring.mask(Rect(0, 160, roi.width, ringHeight - 160)).setTo(Scalar::all(0));
+        }
+
+        rings.push_back(ring);
+    }
+
+    for(auto mode : { RingBlendMode::MultiBand, RingBlendMode::Feather }) {
+        Mat reference, referenceMask;
+        Blend(rings, roi, mode, roi.height * 2, reference, referenceMask);
+
+        AssertEQ(reference.type(), CV_8UC3);
+        AssertEQ(reference.size(), roi.size());
+        AssertEQM(countNonZero(referenceMask), roi.area(), "Rings cover the output");
+
+        // Blending in strips gives the same result as blending at once. 
+        Mat striped, stripedMask;
+        Blend(rings, roi, mode, 64, striped, stripedMask);
+
+        Mat diff;
+        absdiff(reference, striped, diff);
+        AssertGEM(1.0, norm(diff, NORM_INF), "Strips blend like the whole image");
+        absdiff(referenceMask, stripedMask, diff);
+        AssertEQM(countNonZero(diff), 0, "Strips have the same mask");
+
+        // The output wraps around horizontally. 
+        vector<Ring> rolledRings = rings;
+        for(auto &ring : rolledRings) {
+            ring.image = Roll(ring.image, roi.width / 2);
+            ring.mask = Roll(ring.mask, roi.width / 2);
+        }
+
+        Mat rolled, rolledMask;
+        Blend(rolledRings, roi, mode, 64, rolled, rolledMask);
+
+        absdiff(Roll(rolled, -roi.width / 2), striped, diff);
+        AssertGEM(1.0, norm(diff, NORM_INF), "Blending wraps around");
+
+        // Away from seams, rings are kept as they are.
+        absdiff(striped(Rect(0, 0, roi.width, 16)), 
+                rings[0].image(Rect(0, 0, roi.width, 16)), diff);
+        AssertGEM(1.0, mean(diff)[0], "Rings are kept away from seams");
+    }
+
+    // Images outside of the output are ignored. 
+    {
+        RingBlender blender;
+        blender.Prepare(roi);
+        blender.Feed(rings[0].image, rings[0].mask, Point(0, roi.height + 10));
+
+        Mat result, resultMask;
+        blender.Blend(result, resultMask);
+        AssertEQM(countNonZero(resultMask), 0, "Images outside are ignored");
+    }
+
+    cout << "[\u2713] RingBlender module." << endl;
+}
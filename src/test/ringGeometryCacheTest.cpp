@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../stitcher/ringGeometryCache.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Creates rotations for a ring of images, turning around the y axis. 
+ */
+vector<Mat> CreateRing(int n, double offset) {
+    vector<Mat> rotations;
+
+    for(int i = 0; i < n; i++) {
+        Mat r;
+        CreateRotationY(offset + i * 2 * M_PI / n, r);
+        rotations.push_back(r);
+    }
+
+    return rotations;
+}
+
+int main(int, char**) {
+    Mat intrinsics = Mat::eye(3, 3, CV_64F);
+    intrinsics.at<double>(0, 0) = 400;
+    intrinsics.at<double>(1, 1) = 400;
+    intrinsics.at<double>(0, 2) = 160;
+    intrinsics.at<double>(1, 2) = 120;
+
+    const Size size(320, 240);
+    RingGeometryCache cache(1);
+
+    auto left = cache.Get(intrinsics, size, 300, CreateRing(8, 0));
+    auto right = cache.Get(intrinsics, size, 300, CreateRing(8, 0));
+
+    AssertM(left == right, "Geometry is shared between equal rings");
+    AssertEQ(left->corners.size(), (size_t)8);
+    AssertEQ(left->xymap.size(), left->coreRoi.size());
+    AssertEQ(left->warpedMask.size(), left->coreRoi.size());
+
+    // Warping with the cached core maps equals warping with the full float 
+    // maps and cropping to the core region afterwards. 
+    SphericalWarper warperFactory;
+    Ptr<detail::RotationWarper> warper = warperFactory.create(300);
+    Mat uxmap, uymap;
+    warper->buildMaps(size, left->K, left->rotations[0], uxmap, uymap);
+
+    Mat image = CreateTexture(size, CV_8UC3);
+    Mat warped, cached;
+    remap(image, warped, uxmap, uymap, INTER_LINEAR, BORDER_CONSTANT);
+    remap(image, cached, left->xymap, left->interpolationMap, INTER_LINEAR, BORDER_CONSTANT);
+    AssertEqual(cached, warped(left->coreRoi), "Cached warp equals full warp");
+
+    Mat mask(size, CV_8U, Scalar::all(255)), warpedMask;
+    remap(mask, warpedMask, uxmap, uymap, INTER_NEAREST, BORDER_CONSTANT);
+    AssertEqual(left->warpedMask, warpedMask(left->coreRoi), "Cached mask equals full warped mask");
+
+    auto other = cache.Get(intrinsics, size, 300, CreateRing(8, 0.1));
+    AssertM(left != other, "Geometry depends on rotations");
+
+    auto scaled = cache.Get(intrinsics, size, 600, CreateRing(8, 0));
+    AssertM(left != scaled, "Geometry depends on warper scale");
+
+    // Only the last geometry is retained when unused. 
+    left.reset();
+    right.reset();
+    other.reset();
+    AssertEQ(cache.Size(), (size_t)1);
+
+    cache.Clear();
+    AssertEQ(cache.Size(), (size_t)1);
+    scaled.reset();
+    AssertEQ(cache.Size(), (size_t)0);
+
+    cout << "[\u2713] Ring geometry cache module." << endl;
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <vector>
+
+#include "../common/assert.hpp"
+#include "../common/intrinsics.hpp"
+#include "../stitcher/ringStitcher.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+StitchingResultP Stitch(const vector<InputImageP> &ring, bool pipelined) {
+    vector<Mat> rotations;
+    for(auto &image : ring) {
+        rotations.push_back(image->adjustedExtrinsics);
+    }
+
+    AsyncRingStitcher stitcher(rotations, 300, true, nullptr, pipelined);
+
+    for(auto &image : ring) {
+        stitcher.Push(image);
+    }
+
+    return stitcher.Finalize();
+}
+
+int main(int, char**) {
+    auto ring = CreateRecording(iPhone6Intrinsics, Size(108, 192))[1];
+
+    // Calculating flows on a worker thread gives the same result as 
+    // calculating them in sequence. 
+    StitchingResultP sequential = Stitch(ring, false);
+    StitchingResultP pipelined = Stitch(ring, true);
+
+    AssertEQ(pipelined->corner, sequential->corner);
+    AssertEqual(pipelined->image.data, sequential->image.data, 
+            "Pipelined stitching equals sequential stitching");
+    AssertEqual(pipelined->mask.data, sequential->mask.data, 
+            "Pipelined mask equals sequential mask");
+
+    cout << "[\u2713] RingStitcher module." << endl;
+}
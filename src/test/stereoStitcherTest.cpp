@@ -0,0 +1,188 @@
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "../common/assert.hpp"
+#include "../common/threadPool.hpp"
+#include "../common/memoryBudget.hpp"
+#include "../common/progressCallback.hpp"
+#include "../common/intrinsics.hpp"
+#include "../io/io.hpp"
+#include "../stitcher/multiringStitcher.hpp"
+#include "../stitcher/stereoStitcher.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace optonaut;
+
+/*
+ * Checkpoint store that counts ring adjustment calculations. Each 
+ * calculation starts by loading a previously stored adjustment. 
+ */
+class CountingCheckpointStore : public CheckpointStore {
+    private:
+    atomic<int> &adjustments;
+
+    public:
+    CountingCheckpointStore(const string &basePath, const string &sharedPath, atomic<int> &adjustments) :
+        CheckpointStore(basePath, sharedPath, MappedImageExtension), adjustments(adjustments) { }
+
+    virtual void LoadRingAdjustment(vector<int> &vals) {
+        adjustments++;
+        CheckpointStore::LoadRingAdjustment(vals);
+    }
+};
+
+void SaveRecording(CheckpointStore &store, const vector<vector<InputImageP>> &rings) {
+    for(auto &ring : rings) {
+        for(auto &image : ring) {
+            store.SaveRectifiedImage(image);
+        }
+    }
+    store.SaveStitcherInput(rings, map<size_t, double>());
+}
+
+/*
+ * Stitches two synthetic eyes with the stereo stitcher and compares
+ * the results to stitching the left, then the right eye on their own. 
+ */
+void TestFinish() {
+    const string base = "tmp/stereo-stitcher-test/";
+    DeleteDirectories(base);
+
+    auto leftRings = CreateRecording(iPhone6Intrinsics, cv::Size(108, 192));
+    auto rightRings = CreateRecording(iPhone6Intrinsics, cv::Size(108, 192));
+
+    ProgressCallback progress([] (float) { return true; });
+
+    // Both eyes stitch their rings concurrently. Only the left eye 
+    // calculates the ring adjustment. 
+    atomic<int> leftAdjustments(0), rightAdjustments(0);
+    CountingCheckpointStore leftStore(base + "stereo/left/", base + "stereo/shared/", leftAdjustments);
+    CountingCheckpointStore rightStore(base + "stereo/right/", base + "stereo/shared/", rightAdjustments);
+    SaveRecording(leftStore, leftRings);
+    SaveRecording(rightStore, rightRings);
+
+    StereoStitcher stereo(leftStore, rightStore, 4);
+    stereo.Finish(progress);
+
+    AssertEQM(leftAdjustments.load(), 1, "Left eye calculates the ring adjustment");
+    AssertEQM(rightAdjustments.load(), 0, "Right eye re-uses the ring adjustment");
+
+    // Sequential stitching with its own shared path. The left eye 
+    // calculates the adjustment, the right eye loads it. 
+    CheckpointStore leftSequentialStore(base + "sequential/left/", base + "sequential/shared/", MappedImageExtension);
+    CheckpointStore rightSequentialStore(base + "sequential/right/", base + "sequential/shared/", MappedImageExtension);
+    SaveRecording(leftSequentialStore, leftRings);
+    SaveRecording(rightSequentialStore, rightRings);
+
+    StitchingResultP left = Stitcher(leftSequentialStore).Finish(progress);
+    StitchingResultP right = Stitcher(rightSequentialStore).Finish(progress);
+
+    vector<int> stereoOffsets, sequentialOffsets;
+    leftStore.LoadRingAdjustment(stereoOffsets);
+    leftSequentialStore.LoadRingAdjustment(sequentialOffsets);
+    AssertM(stereoOffsets == sequentialOffsets, "Stereo and sequential ring offsets are equal");
+
+    AssertEqual(stereo.GetLeftResult()->image.data, left->image.data, 
+            "Left eye equals sequential stitching");
+    AssertEqual(stereo.GetRightResult()->image.data, right->image.data, 
+            "Right eye equals sequential stitching");
+}
+
+int main(int, char**) {
+
+    ThreadPool pool(4);
+
+    // The ring adjustment is calculated once and handed to all callers. 
+    SharedRingAdjustment adjustment;
+    atomic<int> calculations(0);
+    vector<future<vector<int>>> results;
+
+    for(int i = 0; i < 4; i++) {
+        results.push_back(pool.Push([&adjustment, &calculations] () {
+                    return adjustment.Get([&calculations] () {
+                            calculations++;
+                            this_thread::sleep_for(chrono::milliseconds(20));
+                            return vector<int>({ 3, -2 });
+                        });
+                }));
+    }
+
+    for(auto &result : results) {
+        vector<int> dy = result.get();
+        AssertEQM(dy.size(), (size_t)2, "Adjustment is delivered");
+        AssertEQM(dy[0], 3, "Adjustment is delivered");
+        AssertEQM(dy[1], -2, "Adjustment is delivered");
+    }
+
+    AssertEQM(calculations.load(), 1, "Adjustment is calculated once");
+
+    // Waiting stitchers never calculate the adjustment while the producer runs. 
+    SharedRingAdjustment produced;
+    auto waiting = pool.Push([&produced] () {
+                return produced.Wait([] () { 
+                        AssertM(false, "Waiting stitcher does not calculate");
+                        return vector<int>(); 
+                    });
+            });
+    this_thread::sleep_for(chrono::milliseconds(20));
+    produced.Get([] () { return vector<int>({ 5 }); });
+    produced.Release();
+    AssertM(waiting.get() == vector<int>({ 5 }), "Waiting stitcher gets produced adjustment");
+
+    // If the producer is released without adjusting, waiting stitchers calculate it. 
+    SharedRingAdjustment abandoned;
+    abandoned.Release();
+    AssertM(abandoned.Wait([] () { return vector<int>({ 7 }); }) == vector<int>({ 7 }), 
+            "Waiting stitcher calculates abandoned adjustment");
+
+    // Reservations never exceed the budget. 
+    MemoryBudget budget(100);
+    atomic<int> concurrent(0);
+    atomic<int> maxConcurrent(0);
+
+    pool.ParallelFor(0, 16, [&] (int) {
+                MemoryBudget::Reservation reservation(budget, 40);
+                int c = ++concurrent;
+                int m = maxConcurrent;
+                while(c > m && !maxConcurrent.compare_exchange_weak(m, c)) { }
+                AssertGEM(budget.GetLimit(), budget.GetUsedBytes(), "Budget is respected");
+                this_thread::sleep_for(chrono::milliseconds(5));
+                concurrent--;
+            });
+
+    AssertGEM(2, maxConcurrent.load(), "Budget limits concurrent tasks");
+    AssertEQM(budget.GetUsedBytes(), (size_t)0, "All memory is returned");
+
+    // Oversized reservations are granted when running alone. 
+    {
+        MemoryBudget::Reservation reservation(budget, 1000);
+        AssertEQM(budget.GetUsedBytes(), (size_t)1000, "Oversized reservation is granted");
+    }
+
+    AssertEQM(budget.GetUsedBytes(), (size_t)0, "All memory is returned");
+
+    // Accumulated progress is consistent when reported concurrently. 
+    float last = 0;
+    ProgressCallback parent([&last] (float progress) {
+                last = progress;
+                return true;
+            });
+    {
+        ProgressCallbackAccumulator accumulator(parent, vector<float>(8, 1.0f / 8));
+
+        pool.ParallelFor(0, 8, [&accumulator] (int i) {
+                    for(int j = 1; j <= 100; j++) {
+                        accumulator.At(i)((float)j / 100);
+                    }
+                });
+    }
+
+    AssertEQM((int)(last * 1000 + 0.5f), 1000, "All progress is reported");
+
+    TestFinish();
+
+    cout << "[\u2713] StereoStitcher module." << endl;
+}
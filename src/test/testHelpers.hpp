@@ -0,0 +1,97 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../common/assert.hpp"
+#include "../math/support.hpp"
+#include "../math/projection.hpp"
+#include "../io/inputImage.hpp"
+
+#ifndef OPTONAUT_TEST_HELPERS_HEADER
+#define OPTONAUT_TEST_HELPERS_HEADER
+
+namespace optonaut {
+
+    /*
+     * Creates an input image with random content. All matrices are identities.
+     */
+    inline InputImageP CreateImage(int id, int width, int height) {
+        auto image = std::make_shared<InputImage>();
+        image->id = id;
+        image->image = Image(cv::Mat(height, width, CV_8UC3));
+        cv::randu(image->image.data, cv::Scalar::all(0), cv::Scalar::all(255));
+        image->intrinsics = cv::Mat::eye(3, 3, CV_64F);
+        image->originalExtrinsics = cv::Mat::eye(4, 4, CV_64F);
+        image->adjustedExtrinsics = cv::Mat::eye(4, 4, CV_64F);
+        return image;
+    }
+
+    /*
+     * Creates a smooth random texture, by upsampling noise with one
+     * random value per cell.
+     *
+     * @param sigma Deviation of an additional Gaussian blur, or 0 for none.
+     */
+    inline cv::Mat CreateTexture(const cv::Size &size, int type,
+            int cellSize = 4, double sigma = 1) {
+        cv::Mat noise(size.height / cellSize, size.width / cellSize, type), texture;
+        cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(255));
+        cv::resize(noise, texture, size, 0, 0, cv::INTER_LINEAR);
+
+        if(sigma > 0) {
+            cv::GaussianBlur(texture, texture, cv::Size(5, 5), sigma);
+        }
+        return texture;
+    }
+
+    /*
+     * Creates blurred noise in [-scale, scale]. Unsigned types saturate at 0.
+     * Used for random flow fields.
+     */
+    inline cv::Mat CreateBlurredNoise(const cv::Size &size, int type, double scale) {
+        cv::Mat noise(size, type), texture;
+        cv::randu(noise, cv::Scalar::all(-scale), cv::Scalar::all(scale));
+        cv::GaussianBlur(noise, texture, cv::Size(9, 9), 3);
+        return texture;
+    }
+
+    /*
+     * Creates a synthetic recording of three rings around the equator with
+     * four textured images each. Neighbouring images overlap by half.
+     */
+    inline std::vector<std::vector<InputImageP>> CreateRecording(
+            const cv::Mat &intrinsics, const cv::Size &size) {
+        const double hStep = GetHorizontalFov(intrinsics) / 2;
+        const double vStep = GetVerticalFov(intrinsics) * 3 / 4;
+
+        std::vector<std::vector<InputImageP>> rings(3);
+        int id = 0;
+
+        for(size_t i = 0; i < rings.size(); i++) {
+            for(int j = 0; j < 4; j++) {
+                auto image = CreateImage(id++, size.width, size.height);
+                image->image = Image(CreateTexture(size, CV_8UC3));
+                image->intrinsics = intrinsics.clone();
+                GeoToRot(j * hStep, ((int)i - 1) * vStep, image->originalExtrinsics);
+                image->adjustedExtrinsics = image->originalExtrinsics.clone();
+                rings[i].push_back(image);
+            }
+        }
+
+        return rings;
+    }
+
+    /*
+     * Asserts that two images have the same size and content.
+     */
+    inline void AssertEqual(const cv::Mat &a, const cv::Mat &b, const std::string &msg) {
+        AssertEQM(a.size(), b.size(), msg);
+        cv::Mat diff;
+        cv::absdiff(a, b, diff);
+        AssertEQM(cv::countNonZero(diff.reshape(1)), 0, msg);
+    }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include <vector>
+#include <atomic>
+
+#include "../common/assert.hpp"
+#include "../common/threadPool.hpp"
+
+using namespace std;
+using namespace optonaut;
+
+int main(int, char**) {
+
+    ThreadPool pool(4);
+
+    // Futures deliver the results of the pushed tasks. 
+    vector<future<int>> results;
+
+    for(int i = 0; i < 100; i++) {
+        results.push_back(pool.Push([i] () { return i * i; }));
+    }
+
+    for(int i = 0; i < 100; i++) {
+        AssertEQM(results[i].get(), i * i, "Task result is delivered");
+    }
+
+    // Each index of a parallel for is visited exactly once. 
+    const int count = 1000;
+    vector<atomic<int>> visits(count);
+
+    for(auto &v : visits) {
+        v = 0;
+    }
+
+    pool.ParallelFor(0, count, [&visits] (int i) {
+                visits[i]++;
+            });
+
+    for(int i = 0; i < count; i++) {
+        AssertEQM(visits[i].load(), 1, "Index visited exactly once");
+    }
+
+    // Nested parallel for loops do not dead-lock. 
+    atomic<int> sum(0);
+
+    pool.ParallelFor(0, 8, [&pool, &sum] (int) {
+                pool.ParallelFor(0, 8, [&sum] (int j) {
+                        sum += j;
+                    });
+            });
+
+    AssertEQM(sum.load(), 8 * 28, "Nested loops are executed");
+
+    cout << "[\u2713] ThreadPool module." << endl;
+}
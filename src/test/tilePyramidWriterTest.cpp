@@ -0,0 +1,76 @@
+#include <vector>
+#include <algorithm>
+
+#include "../common/assert.hpp"
+#include "../common/support.hpp"
+#include "../io/io.hpp"
+#include "../io/tilePyramidWriter.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+/*
+ * Reassembles a level of a pyramid from its tiles.
+ */
+Mat LoadLevel(const TilePyramidWriter &writer, size_t level, int tileSize) {
+    const Size size = writer.GetLevelSize(level);
+    Mat result(size, CV_8UC3);
+
+    for(int y = 0; y < size.height; y += tileSize) {
+        for(int x = 0; x < size.width; x += tileSize) {
+            Mat tile = imread(writer.GetTilePath(level, y / tileSize, x / tileSize));
+            AssertEQM(tile.cols, min(tileSize, size.width - x), "Tile width is cropped to image");
+            AssertEQM(tile.rows, min(tileSize, size.height - y), "Tile height is cropped to image");
+            tile.copyTo(result(Rect(x, y, tile.cols, tile.rows)));
+        }
+    }
+
+    return result;
+}
+
+int main(int, char**) {
+    const string base = "tmp/tile-pyramid-writer-test/";
+    DeleteDirectories(base);
+
+    // Odd sizes, so borders are replicated on each level.
+    const int tileSize = 64;
+    Mat image(301, 517, CV_8UC3);
+    randu(image, Scalar::all(0), Scalar::all(255));
+
+    TilePyramidWriter writer(base, image.size(), tileSize, ".png");
+
+    AssertEQM(writer.GetLevelCount(), (size_t)5, "Levels until image fits into one tile");
+    AssertEQM(writer.GetLevelSize(4), Size(33, 19), "Level sizes are rounded up");
+
+    // Rows arrive in bands of varying height, like blended strips.
+    int y = 0;
+    for(int band = 1; y < image.rows; band = band * 3 % 97 + 1) {
+        const int rows = min(band, image.rows - y);
+        AssertM(!writer.IsComplete(), "Writer is not complete before all rows were pushed");
+        writer.Push(image.rowRange(y, y + rows));
+        y += rows;
+    }
+
+    AssertM(writer.IsComplete(), "Writer is complete after all rows were pushed");
+    writer.Finish();
+    AssertM(FileExists(base + "index.json"), "Index is written");
+
+    Mat expected = image;
+    for(size_t l = 0; l < writer.GetLevelCount(); l++) {
+        if(l > 0) {
+            TilePyramidWriter::Halve(expected, expected);
+        }
+
+        Mat level = LoadLevel(writer, l, tileSize);
+        AssertEQM(level.size(), expected.size(), "Level has expected size");
+
+        Mat diff;
+        absdiff(level, expected, diff);
+        AssertEQM(countNonZero(diff.reshape(1)), 0, "Level equals downsampled image");
+    }
+
+    DeleteDirectories(base);
+
+    cout << "[\u2713] TilePyramidWriter module." << endl;
+}
@@ -0,0 +1,84 @@
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+#include "../common/assert.hpp"
+#include "../common/writeBehindQueue.hpp"
+#include "../io/io.hpp"
+#include "../io/checkpointStore.hpp"
+#include "testHelpers.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace optonaut;
+
+int main(int, char**) {
+    {
+        // Queued bytes never exceed the limit, all writes are done after flushing.
+        WriteBehindQueue queue(3, 100);
+        atomic<int> written(0);
+        atomic<size_t> maxQueued(0);
+
+        for(int i = 0; i < 20; i++) {
+            queue.Push(30, [&] () {
+                    size_t q = queue.GetQueuedBytes();
+                    size_t m = maxQueued;
+                    while(q > m && !maxQueued.compare_exchange_weak(m, q)) { }
+                    this_thread::sleep_for(chrono::milliseconds(2));
+                    written++;
+                });
+        }
+
+        queue.Flush();
+        AssertEQM(written.load(), 20, "All writes are done after flush");
+        AssertGEM((size_t)100, maxQueued.load(), "Queued bytes are limited");
+        AssertEQM(queue.GetQueuedBytes(), (size_t)0, "All memory is returned");
+
+        // Errors are reported by the flush.
+        queue.Push(10, [] () { throw runtime_error("disk full"); });
+        bool thrown = false;
+        try {
+            queue.Flush();
+        } catch (runtime_error &) {
+            thrown = true;
+        }
+        AssertM(thrown, "Write error is re-thrown");
+        AssertEQM(queue.GetQueuedBytes(), (size_t)0, "Memory of failed write is returned");
+    }
+
+    // Images are written behind, they can be unloaded right after saving and
+    // are reloaded from the same source after flushing.
+    const string base = "tmp/write-behind-test/";
+    DeleteDirectories(base);
+
+    CheckpointStore store(base + "store/", base + "shared/", MappedImageExtension);
+    store.EnableWriteBehind(2, 64 * 48 * 3 * 2);
+
+    vector<InputImageP> images;
+    vector<Mat> expected;
+
+    for(int i = 0; i < 8; i++) {
+        auto image = CreateImage(i, 64, 48);
+        expected.push_back(image->image.data.clone());
+
+        store.SaveRectifiedImage(image);
+        AssertNEQM(image->image.source, string(""), "Source is set immediately");
+        image->image.Unload();
+        images.push_back(image);
+    }
+
+    store.SaveStitcherInput({ images }, { });
+
+    for(size_t i = 0; i < images.size(); i++) {
+        images[i]->image.Load();
+        Mat diff;
+        absdiff(images[i]->image.data, expected[i], diff);
+        AssertEQM(countNonZero(diff.reshape(1)), 0, "Image is written");
+    }
+
+    DeleteDirectories(base);
+
+    cout << "[\u2713] WriteBehindQueue module." << endl;
+}